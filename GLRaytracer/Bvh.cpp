@@ -0,0 +1,242 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+const GLuint Bvh::SHADOW_RIGHT_FIRST = 0x80000000u;
+const GLuint Bvh::MAX_LEAF_SIZE = 4;
+const unsigned int Bvh::MAX_DEPTH = BVH_STACK_SIZE - 1;
+const unsigned int Bvh::SAH_BINS = 12;
+
+// popping an interior node at depth d leaves at most d siblings on the stack, then its two children
+static_assert(Bvh::MAX_DEPTH + 1 <= BVH_STACK_SIZE, "a MAX_DEPTH tree must fit the traversal stacks");
+
+namespace
+{
+// should match the bindings in scene.glsl
+const GLuint NODE_BINDING = 16;
+const GLuint PRIMITIVE_BINDING = 17;
+
+// relative cost of a ray-box test against a primitive test
+const float TRAVERSAL_COST = 1.0f;
+}
+
+/**
+ * @brief Bvh::Bvh
+ * @param primitives
+ */
+Bvh::Bvh(std::vector<Primitive> primitives)
+: mBuffers{0, 0}
+{
+    Build(primitives, mNodes, mPrimitiveRefs);
+    upload();
+}
+
+/**
+ * @brief Bvh::~Bvh
+ */
+Bvh::~Bvh()
+{
+    glDeleteBuffers(2, mBuffers);
+}
+
+/**
+ * @brief Bvh::bind
+ */
+void Bvh::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, mBuffers[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PRIMITIVE_BINDING, mBuffers[1]);
+}
+
+/**
+ * @brief Bvh::getNodes
+ * @return root first
+ */
+const std::vector<BvhNodeData>& Bvh::getNodes() const
+{
+    return mNodes;
+}
+
+/**
+ * @brief Bvh::getPrimitiveRefs
+ * @return
+ */
+const std::vector<GLuint>& Bvh::getPrimitiveRefs() const
+{
+    return mPrimitiveRefs;
+}
+
+/**
+ * Build without touching GL, the output vectors keep their capacity so a
+ * tree rebuilt every frame does not allocate.
+ * @brief Bvh::Build
+ * @param primitives - reordered in place
+ * @param nodes - root first
+ * @param refs - Primitive::ref of the leaves' primitives
+ */
+void Bvh::Build(std::vector<Primitive>& primitives, std::vector<BvhNodeData>& nodes, std::vector<GLuint>& refs)
+{
+    nodes.clear();
+    nodes.reserve(primitives.size() * 2 + 1);
+
+    // an empty tree is a leaf with inverted bounds, rays never enter it
+    const float inf = std::numeric_limits<float>::max();
+    nodes.push_back({glm::vec3(inf), 0, glm::vec3(-inf), 0});
+
+    if (!primitives.empty())
+        Subdivide(nodes, 0, primitives, 0, static_cast<GLuint>(primitives.size()), 0);
+
+    refs.clear();
+    refs.reserve(primitives.size());
+    for (const auto& primitive : primitives)
+        refs.push_back(primitive.ref);
+}
+
+/**
+ * Fit the node to primitives [first, first + count), then split it along the
+ * centroid bin boundary with the lowest SAH cost or keep it as a leaf.
+ * Nodes at MAX_DEPTH always stay leaves.
+ * @brief Bvh::Subdivide
+ * @param nodes
+ * @param nodeIndex
+ * @param primitives - reordered in place
+ * @param first
+ * @param count
+ * @param depth - 0 at the root
+ */
+void Bvh::Subdivide(std::vector<BvhNodeData>& nodes, GLuint nodeIndex,
+    std::vector<Primitive>& primitives, GLuint first, GLuint count, unsigned int depth)
+{
+    glm::vec3 boundsMin = primitives.at(first).boundsMin;
+    glm::vec3 boundsMax = primitives.at(first).boundsMax;
+    glm::vec3 centroidMin = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 centroidMax = centroidMin;
+    for (GLuint index = first; index != first + count; ++index)
+    {
+        const Primitive& primitive = primitives.at(index);
+        glm::vec3 centroid = (primitive.boundsMin + primitive.boundsMax) * 0.5f;
+        boundsMin = glm::min(boundsMin, primitive.boundsMin);
+        boundsMax = glm::max(boundsMax, primitive.boundsMax);
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+
+    nodes.at(nodeIndex) = {boundsMin, first, boundsMax, count};
+    if (count <= MAX_LEAF_SIZE || depth == MAX_DEPTH)
+        return;
+
+    struct Bin
+    {
+        glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        GLuint count = 0;
+    };
+
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    unsigned int bestSplit = 0;
+    for (int axis = 0; axis != 3; ++axis)
+    {
+        const float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        std::vector<Bin> bins(SAH_BINS);
+        const float scale = static_cast<float>(SAH_BINS) / extent;
+        for (GLuint index = first; index != first + count; ++index)
+        {
+            const Primitive& primitive = primitives.at(index);
+            float centroid = (primitive.boundsMin[axis] + primitive.boundsMax[axis]) * 0.5f;
+            unsigned int bin = std::min(static_cast<unsigned int>((centroid - centroidMin[axis]) * scale), SAH_BINS - 1);
+            bins.at(bin).boundsMin = glm::min(bins.at(bin).boundsMin, primitive.boundsMin);
+            bins.at(bin).boundsMax = glm::max(bins.at(bin).boundsMax, primitive.boundsMax);
+            bins.at(bin).count++;
+        }
+
+        // sweep from the right to know the cost of every right side up front
+        std::vector<float> rightCost(SAH_BINS, 0.0f);
+        Bin right;
+        for (unsigned int split = SAH_BINS - 1; split != 0; --split)
+        {
+            right.boundsMin = glm::min(right.boundsMin, bins.at(split).boundsMin);
+            right.boundsMax = glm::max(right.boundsMax, bins.at(split).boundsMax);
+            right.count += bins.at(split).count;
+            rightCost.at(split) = right.count ? right.count * getSurfaceArea(right.boundsMin, right.boundsMax) : 0.0f;
+        }
+
+        Bin left;
+        for (unsigned int split = 1; split != SAH_BINS; ++split)
+        {
+            left.boundsMin = glm::min(left.boundsMin, bins.at(split - 1).boundsMin);
+            left.boundsMax = glm::max(left.boundsMax, bins.at(split - 1).boundsMax);
+            left.count += bins.at(split - 1).count;
+            float leftCost = left.count ? left.count * getSurfaceArea(left.boundsMin, left.boundsMax) : 0.0f;
+            float cost = leftCost + rightCost.at(split);
+            if (left.count != 0 && left.count != count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    // every centroid in one spot, or splitting costs more than testing them all
+    const float leafCost = static_cast<float>(count) * getSurfaceArea(boundsMin, boundsMax);
+    if (bestAxis == -1 || TRAVERSAL_COST * getSurfaceArea(boundsMin, boundsMax) + bestCost >= leafCost)
+        return;
+
+    const float scale = static_cast<float>(SAH_BINS) / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+    auto middle = std::partition(primitives.begin() + first, primitives.begin() + first + count,
+        [&](const Primitive& primitive) {
+            float centroid = (primitive.boundsMin[bestAxis] + primitive.boundsMax[bestAxis]) * 0.5f;
+            return std::min(static_cast<unsigned int>((centroid - centroidMin[bestAxis]) * scale), SAH_BINS - 1) < bestSplit;
+        });
+    const GLuint leftCount = static_cast<GLuint>(middle - (primitives.begin() + first));
+
+    const GLuint leftIndex = static_cast<GLuint>(nodes.size());
+    nodes.emplace_back();
+    nodes.emplace_back();
+    Subdivide(nodes, leftIndex, primitives, first, leftCount, depth + 1);
+    Subdivide(nodes, leftIndex + 1, primitives, first + leftCount, count - leftCount, depth + 1);
+
+    const BvhNodeData& leftNode = nodes.at(leftIndex);
+    const BvhNodeData& rightNode = nodes.at(leftIndex + 1);
+    const bool rightFirst = getSurfaceArea(rightNode.boundsMin, rightNode.boundsMax)
+        > getSurfaceArea(leftNode.boundsMin, leftNode.boundsMax);
+    nodes.at(nodeIndex).leftFirst = leftIndex;
+    nodes.at(nodeIndex).count = rightFirst ? SHADOW_RIGHT_FIRST : 0u;
+}
+
+/**
+ * @brief Bvh::upload
+ */
+void Bvh::upload()
+{
+    const GLuint noRef = 0;
+
+    glGenBuffers(2, mBuffers);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[0]);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, mNodes.size() * sizeof(BvhNodeData), mNodes.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[1]);
+    if (mPrimitiveRefs.empty())
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &noRef, 0);
+    else
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, mPrimitiveRefs.size() * sizeof(GLuint), mPrimitiveRefs.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/**
+ * @brief Bvh::getSurfaceArea
+ * @param boundsMin
+ * @param boundsMax
+ * @return
+ */
+float Bvh::getSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
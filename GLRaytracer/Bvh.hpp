@@ -0,0 +1,65 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "layout.glsl"
+
+// interior: index of the left child, the right one follows it. leaf: first primitive reference
+// and the primitive count, 0 for interior nodes, the high bit is Bvh::SHADOW_RIGHT_FIRST
+typedef GpuLayout::BvhNode BvhNodeData;
+
+/**
+ * Bounding volume hierarchy built with a binned surface area heuristic,
+ * leaves reference primitives through an index list. Used as the bottom
+ * level over mesh triangles (uploaded once) and, through Build, for the
+ * top level over instances (see Tlas).
+ * @brief The Bvh class
+ */
+class Bvh final
+{
+public:
+    typedef std::unique_ptr<Bvh> Ptr;
+    // shadow rays visit the larger child first, it is the likelier occluder
+    static const GLuint SHADOW_RIGHT_FIRST;
+    static const GLuint MAX_LEAF_SIZE;
+    // deeper nodes become leaves, the traversal stacks hold BVH_STACK_SIZE nodes
+    static const unsigned int MAX_DEPTH;
+    static const unsigned int SAH_BINS;
+
+    struct Primitive
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // triangle or instance index
+        GLuint ref;
+    };
+public:
+    explicit Bvh(std::vector<Primitive> primitives);
+    ~Bvh();
+
+    void bind() const;
+
+    const std::vector<BvhNodeData>& getNodes() const;
+    const std::vector<GLuint>& getPrimitiveRefs() const;
+
+    static void Build(std::vector<Primitive>& primitives, std::vector<BvhNodeData>& nodes, std::vector<GLuint>& refs);
+
+private:
+    std::vector<BvhNodeData> mNodes;
+    std::vector<GLuint> mPrimitiveRefs;
+    GLuint mBuffers[2];
+private:
+    Bvh(const Bvh& other);
+    Bvh& operator=(const Bvh& other);
+    void upload();
+    static void Subdivide(std::vector<BvhNodeData>& nodes, GLuint nodeIndex,
+        std::vector<Primitive>& primitives, GLuint first, GLuint count, unsigned int depth);
+    static float getSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+#endif // BVH_HPP
@@ -139,7 +139,8 @@ glm::mat4 Camera::getInfPerspective(const float aspectRatio) const
  * @param ar - aspect ratio
  * @param x - NDC x coordinate (-1 to 1)
  * @param y - NDC y coordinate (-1 to 1)
- * @return normalized ray direction from camera through the frustum corner
+ * @return ray direction from camera to the frustum corner on the far plane,
+ *  left un-normalized so interpolating between corners stays on the far plane
  */
 glm::vec3 Camera::getFrustumEyeRay(float ar, int x, int y) const
 {
@@ -150,7 +151,7 @@ glm::vec3 Camera::getFrustumEyeRay(float ar, int x, int y) const
     eyeVec /= eyeVec.w;
 
     // Return ray direction from camera position to the frustum corner point
-    return glm::normalize(glm::vec3(eyeVec) - mPosition);
+    return glm::vec3(eyeVec) - mPosition;
 }
 
 /**
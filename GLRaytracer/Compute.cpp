@@ -4,16 +4,44 @@
 
 #include <glad/glad.h>
 
-#define TOTAL_SPHERES 20
-#define TOTAL_LIGHTS 5
+#include "ObjLoader.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 const glm::vec3 Compute::CLEAR_COLOR = glm::vec3(0.f);
+const unsigned int Compute::LOCAL_GROUP_SIZE = 20;
+const unsigned int Compute::TEMPORAL_REFRESH_PERIOD = 8;
+// fractions of the window diagonal, every pixel is traced inside the inner radius
+const float Compute::FOVEA_INNER_RADIUS = 0.15f;
+const float Compute::FOVEA_OUTER_RADIUS = 0.35f;
+const GLuint Compute::TRACE_PASS_PRIMARY = 0;
+const GLuint Compute::TRACE_PASS_ADAPTIVE = 1;
+const GLuint Compute::TRACE_PASS_PERSISTENT = 2;
+const GLuint Compute::PERSISTENT_GROUPS_PER_CORE = 4;
+const GLuint Compute::PERSISTENT_FALLBACK_GROUPS = 128;
+const unsigned int Compute::ORBITING_MESH_INSTANCES = 6;
+// one layer each, a missing file gets the procedural stand-in of its layer
+const std::vector<std::string> Compute::TEXTURE_FILES = {
+    "./textures/tiles.png",
+    "./textures/marble.png",
+    "./textures/wood.png",
+    "./textures/grid.png"
+};
 std::unordered_map<std::uint8_t, bool> Compute::mKepMap;
 
 
 Compute::Compute()
     : mCamera(glm::vec3(0.0f, 50.0f, 200.0f), -90.0f, -10.0f, 65.0f, 0.1f, 500.0f)
       , mPlayer(mCamera)
+      , mPrevViewProj(1.0f)
+      , mPrevEye(mCamera.getPosition())
+      , mFocus(static_cast<float>(SDLHelper::GLFW_WINDOW_X) * 0.5f, static_cast<float>(SDLHelper::GLFW_WINDOW_Y) * 0.5f)
+      , mFrameIndex(0)
+      , mRenderFlags(0)
+      , mPrevRenderFlags(0)
+      , mAccumulatedFrames(0)
+      , mSceneTime(0.0f)
 {
     // Camera positioned above and in front of sphere circle
     // Looking towards center with slight downward pitch
@@ -32,6 +60,10 @@ void Compute::run()
 
     printOpenGlInfo();
 
+    // edited shaders are rebuilt by the driver's compiler threads while the old programs keep rendering
+    if (Shader::EnableParallelCompile())
+        SDL_Log("Parallel shader compile enabled");
+
     // Debug camera setup
     SDL_Log("Camera initialized at position: (%.2f, %.2f, %.2f)",
             mCamera.getPosition().x, mCamera.getPosition().y, mCamera.getPosition().z);
@@ -41,45 +73,95 @@ void Compute::run()
 
     glEnable(GL_MULTISAMPLE);
 
-    Shader tracerShader;
-    tracerShader.compileAndAttachShader(ShaderTypes::VERTEX_SHADER, "./shaders/raytracer.vert.glsl");
-    tracerShader.compileAndAttachShader(ShaderTypes::FRAGMENT_SHADER, "./shaders/raytracer.frag.glsl");
-    tracerShader.linkProgram();
-    tracerShader.bind();
+    RenderPrograms programs;
+    programs.raytracer.compileAndAttachShader(ShaderTypes::VERTEX_SHADER, SHADER_SOURCE_DIR "/raytracer.vert.glsl");
+    programs.raytracer.compileAndAttachShader(ShaderTypes::FRAGMENT_SHADER, SHADER_SOURCE_DIR "/raytracer.frag.glsl");
+    programs.raytracer.linkProgram();
+    programs.raytracer.bind();
+
+    programs.compute.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/raytracer.cs.glsl");
+    programs.compute.linkProgram();
+    programs.pass = programs.compute.getUniform("uPass");
+    programs.fovea = programs.compute.getUniform("uFovea");
+
+    programs.reconstruct.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/reconstruct.cs.glsl");
+    programs.reconstruct.linkProgram();
+    programs.frameIndex = programs.reconstruct.getUniform("uFrameIndex");
 
-    Shader computeShader;
-    computeShader.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, "./shaders/raytracer.cs.glsl");
-    computeShader.linkProgram();
-    computeShader.bind();
+    programs.upsample.addDefine("RECONSTRUCT_FOVEATED");
+    programs.upsample.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/reconstruct.cs.glsl");
+    programs.upsample.linkProgram();
+    programs.upsampleFrameIndex = programs.upsample.getUniform("uFrameIndex");
+    programs.upsampleFovea = programs.upsample.getUniform("uFovea");
+
+    programs.variance.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/variance.cs.glsl");
+    programs.variance.linkProgram();
+
+    programs.sphereBins.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/spherebin.cs.glsl");
+    programs.sphereBins.linkProgram();
+
+    ShaderWatcher shaderWatcher(SHADER_SOURCE_DIR);
 
     std::vector<Light> lights;
+    std::vector<PointLightData> pointLights;
     std::vector<Sphere> spheres;
+    std::vector<Material> sphereMaterials;
     Plane plane;
 
     GLuint vao;
-    GLuint screenTex;
-    GLuint shapeSSBO;
+    RenderTargets targets;
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
-    glGenTextures(1, &screenTex);
-    glBindTexture(GL_TEXTURE_2D, screenTex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F,
-                   static_cast<GLsizei>(SDLHelper::GLFW_WINDOW_X),
-                   static_cast<GLsizei>(SDLHelper::GLFW_WINDOW_Y));
-    glBindImageTexture(0, screenTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    // color and G-buffer (hit distance, object key) are ping-ponged for temporal reuse
+    for (unsigned int index = 0; index != 2; ++index)
+    {
+        targets.color[index] = GLUtils::CreateImageTexture(GL_RGBA32F,
+            SDLHelper::GLFW_WINDOW_X, SDLHelper::GLFW_WINDOW_Y);
+        targets.gBuffer[index] = GLUtils::CreateImageTexture(GL_RGBA32F,
+            SDLHelper::GLFW_WINDOW_X, SDLHelper::GLFW_WINDOW_Y);
+    }
+
+    // indirect dispatch arguments followed by the packed coordinates of the tiles to supersample
+    const GLuint totalTiles = getWorkGroups(SDLHelper::GLFW_WINDOW_X) * getWorkGroups(SDLHelper::GLFW_WINDOW_Y);
+    glGenBuffers(1, &targets.tileWorkList);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, targets.tileWorkList);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + totalTiles) * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, targets.tileWorkList);
+
+    // next tile index handed out to the persistent work groups
+    glGenBuffers(1, &targets.tileCounter);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, targets.tileCounter);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, targets.tileCounter);
+
+    // per screen tile sphere count followed by the sphere indices, see spherebin.cs.glsl
+    glGenBuffers(1, &targets.tileSpheres);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, targets.tileSpheres);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, totalTiles * (TOTAL_SPHERES + 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 27, targets.tileSpheres);
 
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    glGenBuffers(1, &shapeSSBO);
+    // decodes in the background, the materials only need the layer indices
+    mTextures = std::make_unique<TextureArray>(TEXTURE_FILES);
+    mTextures->bind();
+
+    initCompute(spheres, sphereMaterials, plane, lights, pointLights);
+
+    mMaterials = std::make_unique<MaterialTable>(sphereMaterials);
+    mMaterials->bind();
 
-    initCompute(computeShader, shapeSSBO, spheres, plane, lights);
+    mLightGrid = std::make_unique<LightGrid>(pointLights);
+    mLightGrid->bind();
+
+    initScene();
+
+    // per-frame camera, light, sphere and instance data, written while the GPU traces the previous frames
+    PersistentBuffer::Ptr frameBuffer = std::make_unique<PersistentBuffer>(
+        getTlasBlockOffset() + static_cast<GLsizeiptr>(sizeof(TlasBlock)));
 
     constexpr float timePerFrame = 1.0f / 60.0f;
     float accumulator = 0.0f;
@@ -90,11 +172,16 @@ void Compute::run()
     {
         sdlHandler.pollEvents();
 
+        reloadShaders(programs, shaderWatcher);
+
         static double lastTime = SDLHelper::getTime();
         double currentTime = SDLHelper::getTime();
         auto deltaTime = static_cast<float>(currentTime - lastTime);
         lastTime = currentTime;
         accumulator += deltaTime;
+        // a moving scene would smear into the accumulated stochastic lighting
+        if (!isAccumulating())
+            mSceneTime += deltaTime;
 
         while (accumulator >= timePerFrame)
         {
@@ -107,7 +194,7 @@ void Compute::run()
 
         float ar = static_cast<float>(SDLHelper::GLFW_WINDOW_X) / static_cast<float>(SDLHelper::GLFW_WINDOW_Y);
 
-        render(computeShader, tracerShader, spheres, ar, vao, screenTex);
+        render(programs, *frameBuffer, spheres, plane, lights, ar, vao, targets);
 
         sdlHandler.swapBuffers();
 
@@ -123,19 +210,31 @@ void Compute::run()
         }
     }
 
+    mCpuTracer.reset();
+    mLightGrid.reset();
+    mMaterials.reset();
+    mTextures.reset();
+    mTlas.reset();
+    mWideBlas.reset();
+    mBlas.reset();
+    mMesh.reset();
+    programs.wavefront.reset();
+    programs.lbvh.reset();
+    programs.denoiser.reset();
+    frameBuffer.reset();
     glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &shapeSSBO);
-    glDeleteTextures(1, &screenTex);
+    glDeleteTextures(2, targets.color);
+    glDeleteTextures(2, targets.gBuffer);
+    glDeleteBuffers(1, &targets.tileWorkList);
+    glDeleteBuffers(1, &targets.tileCounter);
+    glDeleteBuffers(1, &targets.tileSpheres);
 
     sdlHandler.cleanUp();
 }
 
-void Compute::initCompute(Shader& compute, GLuint shapeSSBO,
-                          std::vector<Sphere>& spheres, Plane& plane,
-                          std::vector<Light>& lights)
+void Compute::initCompute(std::vector<Sphere>& spheres, std::vector<Material>& sphereMaterials, Plane& plane,
+                          std::vector<Light>& lights, std::vector<PointLightData>& pointLights)
 {
-    compute.bind();
-
     std::vector<glm::vec3> lightPositions = {
         glm::vec3(35.0f, 20.0f, -35.0f),
         glm::vec3(0.0f, 20.0f, 0.0f),
@@ -156,20 +255,23 @@ void Compute::initCompute(Shader& compute, GLuint shapeSSBO,
         glm::vec3 position = lightPositions.at(index);
 
         lights.emplace_back(ambient, diffuse, specular, glm::vec4(position, 0.0));
-
-        compute.setUniform("uLights[" + Utils::toString(index) + "].position", glm::vec4(position, 0.0));
-        compute.setUniform("uLights[" + Utils::toString(index) + "].ambient", ambient);
-        compute.setUniform("uLights[" + Utils::toString(index) + "].diffuse", diffuse);
-        compute.setUniform("uLights[" + Utils::toString(index) + "].specular", specular);
     }
 
     float imgCircleRadius = 125.0f;
     float offset = 15.25f;
 
-    // Bind SSBO for sphere data - MUST be populated for shader to work
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, shapeSSBO);
-    // Allocate buffer space (will be filled after sphere creation)
-    glBufferData(GL_SHADER_STORAGE_BUFFER, TOTAL_SPHERES * sizeof(Sphere), nullptr, GL_DYNAMIC_DRAW);
+    // point lights, scattered between the spheres just above the plane
+    for (unsigned int index = 0; index != TOTAL_POINT_LIGHTS; ++index)
+    {
+        glm::vec3 position(Utils::getRandomFloat(-imgCircleRadius - offset, imgCircleRadius + offset),
+                           Utils::getRandomFloat(2.0f, 30.0f),
+                           Utils::getRandomFloat(-imgCircleRadius - offset, imgCircleRadius + offset));
+        glm::vec3 color(Utils::getRandomFloat(0.1f, 1.0f),
+                        Utils::getRandomFloat(0.1f, 1.0f), Utils::getRandomFloat(0.1f, 1.0f));
+        float radius = Utils::getRandomFloat(15.0f, 40.0f);
+
+        pointLights.push_back({glm::vec4(position, radius), glm::vec4(color, 0.0f)});
+    }
 
     // spheres
     for (unsigned int index = 0; index != TOTAL_SPHERES; ++index)
@@ -184,9 +286,6 @@ void Compute::initCompute(Shader& compute, GLuint shapeSSBO,
         float shiny = Utils::getRandomFloat(10.0f, 300.0f);
         float refl = Utils::getRandomFloat(0.05f, 1.0f);
 
-        Material material(ambient, diffuse, specular, Utils::getRandomFloat(10.0f, 300.0f),
-                          Utils::getRandomFloat(0.05f, 1.0f), Utils::getRandomFloat(0.05f, 1.0f));
-
         float angle = static_cast<float>(index) / static_cast<float>(TOTAL_SPHERES) * 360.0f;
         float angleRad = glm::radians(angle);
         float displacement = Utils::getRandomFloat(-offset, offset);
@@ -200,35 +299,25 @@ void Compute::initCompute(Shader& compute, GLuint shapeSSBO,
         glm::vec3 center = glm::vec3(xpos, y, z);
 
         float radius = Utils::getRandomFloat(5.0f, 12.0f);
-        spheres.emplace_back(center, radius, ambient, diffuse, specular, shiny, refl);
+        spheres.push_back({center, radius});
+        sphereMaterials.emplace_back(ambient, diffuse, specular, shiny, refl, 0.0f);
 
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].material.ambient", material.getAmbient());
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].material.diffuse", material.getDiffuse());
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].material.specular", material.getSpecular());
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].material.shininess", material.getShininess());
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].material.reflective", material.getReflectivity());
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].center", center);
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].radius", radius);
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].radius2", radius * radius);
+        // every fourth sphere is textured, cycling through the layers
+        if (index % 4 == 0)
+            sphereMaterials.back().setTextureLayer(static_cast<int>((index / 4) % TEXTURE_FILES.size()));
     }
 
-    // NOW upload the complete spheres vector to SSBO - CRITICAL for rendering!
-    glBufferData(GL_SHADER_STORAGE_BUFFER, spheres.size() * sizeof(Sphere), spheres.data(), GL_STATIC_DRAW);
-
 #if defined(DEBUG_COMPUTE)
-    // Verify SSBO data was uploaded correctly
+    // Sphere data is streamed through the persistent frame buffer, dump the source values
     std::ofstream out;
     out.open("./sphere_data.txt");
-    out << "Sphere SSBO Data Verification:\n";
-    Sphere* ptr = (Sphere*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, spheres.size() * sizeof(Sphere),
-                                            GL_MAP_READ_BIT);
+    out << "Sphere Data Verification:\n";
     for (unsigned int i = 0; i != spheres.size(); ++i)
     {
-        out << "Sphere[" << i << "], center(" << ptr[i].center.x << ", " << ptr[i].center.y << ", " << ptr[i].center.z
+        out << "Sphere[" << i << "], center(" << spheres[i].center.x << ", " << spheres[i].center.y << ", " << spheres[i].center.z
             << ")"
-            << ", radius=" << ptr[i].radius << "\n";
+            << ", radius=" << spheres[i].radius << "\n";
     }
-    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
     out.close();
     std::cout << "Sphere data written to sphere_data.txt for debugging\n";
 #endif // defined
@@ -238,19 +327,104 @@ void Compute::initCompute(Shader& compute, GLuint shapeSSBO,
     glm::vec3 diffuse(1.0f, 0.0f, 0.0f);
     glm::vec3 specular(1.0f);
     Material planarMaterial(ambient, diffuse, specular, 250.0f, 0.0f, 0.0f);
+    planarMaterial.setTextureLayer(0);
     plane.material = planarMaterial;
     plane.normal = glm::vec3(0, 1, 0);
     plane.point = glm::vec3(0, -6, 0);
-
-    //shader->setUniform("uPlane.material.ambient", planematerial.getAmbient());
-    compute.setUniform("uPlane.material.diffuse", plane.material.getDiffuse());
-    compute.setUniform("uPlane.material.specular", plane.material.getSpecular());
-    compute.setUniform("uPlane.material.shininess", plane.material.getShininess());
-    compute.setUniform("uPlane.material.reflective", plane.material.getReflectivity());
-    compute.setUniform("uPlane.point", plane.point);
-    compute.setUniform("uPlane.normal", plane.normal);
 } // initCompute
 
+/**
+ * Load the mesh and build its BLAS once, every mesh instance shares both.
+ * The spheres become instances as well, the TLAS over all of them is
+ * rebuilt per frame in writeFrameData.
+ * @brief Compute::initScene
+ */
+void Compute::initScene()
+{
+    std::vector<glm::vec4> vertices;
+    std::vector<GLuint> indices;
+    if (!ObjLoader::Load("./models/torus.obj", vertices, indices))
+    {
+        SDL_Log("Mesh: torus.obj failed to load, tracing spheres only\n");
+        vertices.clear();
+        indices.clear();
+    }
+
+    mMesh = std::make_unique<Mesh>(vertices, indices);
+    mMesh->material = Material(glm::vec3(0.25f, 0.2f, 0.07f), glm::vec3(0.75f, 0.6f, 0.23f),
+        glm::vec3(0.63f, 0.56f, 0.37f), 51.0f, 0.3f, 0.0f);
+    mMesh->bind();
+
+    std::vector<Bvh::Primitive> primitives;
+    primitives.reserve(mMesh->getTriangleCount());
+    for (GLuint triangle = 0; triangle != mMesh->getTriangleCount(); ++triangle)
+    {
+        Bvh::Primitive primitive;
+        mMesh->getTriangleBounds(triangle, primitive.boundsMin, primitive.boundsMax);
+        primitive.ref = triangle;
+        primitives.push_back(primitive);
+    }
+
+    mBlas = std::make_unique<Bvh>(std::move(primitives));
+    mBlas->bind();
+    mWideBlas = std::make_unique<WideBvh>(*mBlas);
+    mWideBlas->bind();
+    mTlas = std::make_unique<Tlas>(*mBlas);
+
+    // the torus in the middle of the ring and smaller copies orbiting it, all sharing BLAS root 0
+    if (mMesh->getTriangleCount() != 0)
+    {
+        for (unsigned int index = 0; index != 1 + ORBITING_MESH_INSTANCES; ++index)
+            mInstances.push_back({glm::mat4(1.0f), Tlas::INSTANCE_MESH, 0});
+    }
+
+    SDL_Log("Mesh: %u triangles, BLAS: %u nodes, wide BLAS: %u nodes, %u mesh instances\n", mMesh->getTriangleCount(),
+        static_cast<unsigned int>(mBlas->getNodes().size()), static_cast<unsigned int>(mWideBlas->getNodes().size()),
+        static_cast<unsigned int>(mInstances.size()));
+} // initScene
+
+/**
+ * Only the mesh instance transforms animate, the spheres move through SphereBlock.
+ * @brief Compute::updateInstances
+ * @param time - seconds
+ * @param sphereTree - one instance over the Lbvh instead of one instance per sphere
+ */
+void Compute::updateInstances(float time, bool sphereTree)
+{
+    mInstances.erase(std::remove_if(mInstances.begin(), mInstances.end(),
+        [](const Tlas::Instance& instance) { return instance.kind != Tlas::INSTANCE_MESH; }), mInstances.end());
+    if (sphereTree)
+    {
+        mInstances.insert(mInstances.begin(), {glm::mat4(1.0f), Tlas::INSTANCE_SPHERE_TREE, 0});
+    }
+    else
+    {
+        for (GLuint index = 0; index != TOTAL_SPHERES; ++index)
+            mInstances.insert(mInstances.begin() + index, {glm::mat4(1.0f), Tlas::INSTANCE_SPHERE, index});
+    }
+
+    unsigned int orbit = 0;
+    for (auto& instance : mInstances)
+    {
+        if (instance.kind != Tlas::INSTANCE_MESH)
+            continue;
+
+        if (orbit == 0)
+        {
+            instance.objectToWorld = glm::translate(glm::vec3(0.0f, 25.0f, 0.0f))
+                * glm::rotate(time * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::vec3(30.0f));
+        }
+        else
+        {
+            float angle = glm::two_pi<float>() * static_cast<float>(orbit) / static_cast<float>(ORBITING_MESH_INSTANCES) + time * 0.3f;
+            glm::vec3 position(glm::cos(angle) * 70.0f, 15.0f + glm::sin(time + static_cast<float>(orbit)) * 5.0f, glm::sin(angle) * 70.0f);
+            instance.objectToWorld = glm::translate(position)
+                * glm::rotate(time * (1.0f + static_cast<float>(orbit) * 0.2f), glm::vec3(1.0f, 0.0f, 0.0f)) * glm::scale(glm::vec3(10.0f));
+        }
+        orbit++;
+    }
+}
+
 void Compute::input(SDLHelper& sdlHandler)
 {
     float mouseWheelDy = 0;
@@ -261,6 +435,114 @@ void Compute::input(SDLHelper& sdlHandler)
 
     // handle realtime input
     mPlayer.input(sdlHandler, mouseWheelDy, coords);
+
+    // image rows count upwards, mouse look keeps the cursor and so the focus centered
+    mFocus = glm::vec2(coords.x, static_cast<float>(SDLHelper::GLFW_WINDOW_Y) - 1.0f - coords.y);
+
+    // render mode toggles
+    if (keyPressed(sdlHandler, SDL_SCANCODE_T))
+    {
+        mRenderFlags ^= RenderFlags::TEMPORAL;
+        SDL_Log("Temporal reprojection: %s\n", (mRenderFlags & RenderFlags::TEMPORAL) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_C))
+    {
+        mRenderFlags ^= RenderFlags::CHECKERBOARD;
+        SDL_Log("Checkerboard tracing: %s\n", (mRenderFlags & RenderFlags::CHECKERBOARD) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_V))
+    {
+        mRenderFlags ^= RenderFlags::ADAPTIVE;
+        SDL_Log("Adaptive sampling: %s\n", (mRenderFlags & RenderFlags::ADAPTIVE) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_F))
+    {
+        mRenderFlags ^= RenderFlags::WAVEFRONT;
+        SDL_Log("Wavefront tracing: %s\n", (mRenderFlags & RenderFlags::WAVEFRONT) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_P))
+    {
+        mRenderFlags ^= RenderFlags::PERSISTENT;
+        SDL_Log("Persistent threads: %s\n", (mRenderFlags & RenderFlags::PERSISTENT) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_R))
+    {
+        mRenderFlags ^= RenderFlags::CPU;
+        SDL_Log("CPU reference tracer: %s\n", (mRenderFlags & RenderFlags::CPU) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_O))
+    {
+        mRenderFlags ^= RenderFlags::RAY_SORT;
+        SDL_Log("Secondary ray sorting: %s\n", (mRenderFlags & RenderFlags::RAY_SORT) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_L))
+    {
+        mRenderFlags ^= RenderFlags::POINT_LIGHTS;
+        SDL_Log("Point lights: %s\n", (mRenderFlags & RenderFlags::POINT_LIGHTS) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_K))
+    {
+        mRenderFlags ^= RenderFlags::STOCHASTIC_LIGHTS;
+        SDL_Log("Stochastic light sampling: %s\n", (mRenderFlags & RenderFlags::STOCHASTIC_LIGHTS) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_B))
+    {
+        mRenderFlags ^= RenderFlags::GPU_BVH;
+        SDL_Log("GPU sphere BVH: %s\n", (mRenderFlags & RenderFlags::GPU_BVH) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_Q))
+    {
+        // the traversal stacks would overflow, stay on the binary BLAS
+        if (mWideBlas->getDepth() > WideBvh::MAX_DEPTH)
+            SDL_Log("Quantized wide BVH: %u levels deep, the limit is %u\n", mWideBlas->getDepth(), WideBvh::MAX_DEPTH);
+        else
+            mRenderFlags ^= RenderFlags::WIDE_BVH;
+        SDL_Log("Quantized wide BVH: %s\n", (mRenderFlags & RenderFlags::WIDE_BVH) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_H))
+    {
+        mRenderFlags ^= RenderFlags::ANALYTIC_SHADOWS;
+        SDL_Log("Analytic sphere shadows: %s\n", (mRenderFlags & RenderFlags::ANALYTIC_SHADOWS) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_N))
+    {
+        mRenderFlags ^= RenderFlags::DENOISE;
+        SDL_Log("Denoiser: %s\n", (mRenderFlags & RenderFlags::DENOISE) ? "on" : "off");
+    }
+
+    if (keyPressed(sdlHandler, SDL_SCANCODE_G))
+    {
+        mRenderFlags ^= RenderFlags::FOVEATED;
+        SDL_Log("Foveated tracing: %s\n", (mRenderFlags & RenderFlags::FOVEATED) ? "on" : "off");
+    }
+}
+
+/**
+ * Edge-triggered key check, true only on the update the key goes down.
+ * @brief Compute::keyPressed
+ * @param sdlHandler
+ * @param key
+ * @return
+ */
+bool Compute::keyPressed(const SDLHelper& sdlHandler, SDL_Scancode key)
+{
+    bool down = sdlHandler.getKeys()[key];
+    bool& wasDown = mKepMap[static_cast<std::uint8_t>(key)];
+    bool pressed = down && !wasDown;
+    wasDown = down;
+    return pressed;
 }
 
 void Compute::update(const float dt)
@@ -269,55 +551,432 @@ void Compute::update(const float dt)
 }
 
 /**
- * @type GL_TRIANGLE_STRIP
+ * Fill one slot of the persistent frame buffer, the layout matches FrameBlock
+ * followed by the SphereBuffer (SphereBlock) and TlasBuffer (TlasBlock) SSBOs
+ * in raytracer.cs.glsl.
+ * @brief Compute::writeFrameData
+ * @param slot
+ * @param spheres
+ * @param plane
+ * @param lights
+ * @param ar
  */
-void Compute::render(Shader& compute, Shader& raytracer, const std::vector<Sphere>& spheres, float ar,
-                     GLuint vao, GLuint tex, GLenum type)
+void Compute::writeFrameData(void* slot, const std::vector<Sphere>& spheres,
+                             const Plane& plane, const std::vector<Light>& lights, float ar)
 {
-    glClearColor(CLEAR_COLOR.x, CLEAR_COLOR.y, CLEAR_COLOR.z, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    FrameData frame{};
+
+    frame.time = mSceneTime;
+    frame.prevViewProj = mPrevViewProj;
+    frame.prevEye = glm::vec4(mPrevEye, 0.0f);
+    frame.settings = glm::uvec4(mRenderFlags, mFrameIndex, TEMPORAL_REFRESH_PERIOD, mAccumulatedFrames);
+    frame.camera.eye = mCamera.getPosition();
+    frame.camera.far = mCamera.getFar();
+    // aspect ratio is hardcoded which is not good
+    frame.camera.ray00 = mCamera.getFrustumEyeRay(ar, -1, -1);
+    frame.camera.ray01 = mCamera.getFrustumEyeRay(ar, -1, 1);
+    frame.camera.ray10 = mCamera.getFrustumEyeRay(ar, 1, -1);
+    frame.camera.ray11 = mCamera.getFrustumEyeRay(ar, 1, 1);
 
-    compute.bind();
+    frame.plane.material = MaterialTable::ToMaterialData(plane.material);
+    frame.plane.point = plane.point;
+    frame.plane.normal = plane.normal;
 
-    double time = SDLHelper::getTime();
-    compute.setUniform("uTime", time);
-    compute.setUniform("uCamera.eye", mCamera.getPosition());
-    compute.setUniform("uCamera.far", mCamera.getFar());
-    // aspect ratio is hardcoded which is not good
-    compute.setUniform("uCamera.ray00", mCamera.getFrustumEyeRay(ar, -1, -1));
-    compute.setUniform("uCamera.ray01", mCamera.getFrustumEyeRay(ar, -1, 1));
-    compute.setUniform("uCamera.ray10", mCamera.getFrustumEyeRay(ar, 1, -1));
-    compute.setUniform("uCamera.ray11", mCamera.getFrustumEyeRay(ar, 1, 1));
+    frame.meshMaterial = MaterialTable::ToMaterialData(mMesh->material);
 
-    // Get current time for sphere animation (removed 'static' to update every frame)
-    auto elapsed = static_cast<float>(SDLHelper::getTime());
-    for (unsigned int index = 0; index != TOTAL_SPHERES; ++index)
+    for (unsigned int index = 0; index != TOTAL_LIGHTS; ++index)
     {
-        glm::mat4 transform;
-        if (index % 2 == 0)
-            transform = glm::translate(glm::vec3(glm::cos(elapsed) * 10.0f, glm::sin(elapsed) * 10.0f, 0.0f));
-        else
-            transform = glm::translate(glm::vec3(0.0f, glm::cos(elapsed) * 20.0f, glm::sin(elapsed) * 20.0f));
+        frame.lights[index].position = lights.at(index).getPosition();
+        frame.lights[index].ambient = lights.at(index).getAmbient();
+        frame.lights[index].diffuse = lights.at(index).getDiffuse();
+        frame.lights[index].specular = lights.at(index).getSpecular();
+    }
+
+    std::memcpy(slot, &frame, sizeof(FrameData));
 
-        // Get original center as vec3 and transform it
-        glm::vec3 originalCenter = glm::vec3(spheres.at(index).center);
-        glm::vec3 transformedCenter = glm::vec3(transform * glm::vec4(originalCenter, 1.0f));
-        compute.setUniform("uSpheres[" + Utils::toString(index) + "].center", transformedCenter);
+    // Animate the spheres on the host, the mapped SSBO range is write only (and uncached) so the
+    // TLAS build must not read it back
+    SphereBlock sphereBlock;
+    for (unsigned int index = 0; index != TOTAL_SPHERES; ++index)
+    {
+        Sphere animated = spheres.at(index);
+        animated.center += getSphereOffset(index, frame.time);
+        std::memcpy(&sphereBlock.spheres[index], &animated, sizeof(Sphere));
     }
+    std::memcpy(static_cast<char*>(slot) + getSphereBlockOffset(), &sphereBlock, sizeof(SphereBlock));
 
-    glBindImageTexture(0, tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    // instances moved, the BLAS stays untouched; the CPU tracer has no access to the GPU sphere tree
+    updateInstances(frame.time, (mRenderFlags & RenderFlags::GPU_BVH) && !(mRenderFlags & RenderFlags::CPU));
+    mTlas->build(mInstances, sphereBlock, *reinterpret_cast<TlasBlock*>(static_cast<char*>(slot) + getTlasBlockOffset()));
+}
 
-    glDispatchCompute(1080 / 20, 720 / 20, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+/**
+ * Only the megakernel averages the stochastic light samples over frames,
+ * the wavefront and CPU paths trace every frame from scratch.
+ * @brief Compute::isAccumulating
+ * @return true while frames are blended into uPrevFramebuffer's running mean
+ */
+bool Compute::isAccumulating() const
+{
+    return (mRenderFlags & RenderFlags::STOCHASTIC_LIGHTS)
+        && !(mRenderFlags & (RenderFlags::WAVEFRONT | RenderFlags::CPU));
+}
 
-    raytracer.bind();
+/**
+ * @type GL_TRIANGLE_STRIP
+ */
+void Compute::render(RenderPrograms& programs, PersistentBuffer& frameBuffer,
+                     const std::vector<Sphere>& spheres, const Plane& plane,
+                     const std::vector<Light>& lights, float ar,
+                     GLuint vao, const RenderTargets& targets, GLenum type)
+{
+    glClearColor(CLEAR_COLOR.x, CLEAR_COLOR.y, CLEAR_COLOR.z, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // restart the progressive accumulation whenever the view, the render mode or a texture changes
+    const glm::mat4 viewProj = mCamera.getPerspective(ar) * mCamera.getLookAt();
+    const bool texturesChanged = mTextures->update();
+    if (viewProj == mPrevViewProj && mRenderFlags == mPrevRenderFlags && !texturesChanged)
+        mAccumulatedFrames++;
+    else
+        mAccumulatedFrames = 0;
+
+    const unsigned int current = mFrameIndex % 2;
+    GLuint display = targets.color[current];
+    if (mRenderFlags & RenderFlags::CPU)
+        traceCpu(spheres, plane, lights, ar, targets, current);
+    else
+        display = traceGpu(programs, frameBuffer, spheres, plane, lights, ar, targets, current);
+
+    // next frame reprojects against this camera
+    mPrevViewProj = viewProj;
+    mPrevEye = mCamera.getPosition();
+    mPrevRenderFlags = mRenderFlags;
+    mFrameIndex++;
+
+    programs.raytracer.bind();
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    glBindTexture(GL_TEXTURE_2D, display);
     glBindVertexArray(vao);
     glDrawArrays(type, 0, 4);
 } // render
 
+/**
+ * Trace the frame with the compute shaders, the result ends up in color[current].
+ * @brief Compute::traceGpu
+ * @param programs
+ * @param frameBuffer
+ * @param spheres
+ * @param plane
+ * @param lights
+ * @param ar
+ * @param targets
+ * @param current - ping-pong index written this frame
+ * @return the texture to show, color[current] or its denoised copy
+ */
+GLuint Compute::traceGpu(RenderPrograms& programs, PersistentBuffer& frameBuffer,
+                       const std::vector<Sphere>& spheres, const Plane& plane,
+                       const std::vector<Light>& lights, float ar,
+                       const RenderTargets& targets, unsigned int current)
+{
+    // only blocks when all slots are still in flight
+    writeFrameData(frameBuffer.map(), spheres, plane, lights, ar);
+
+    frameBuffer.bindRange(GL_UNIFORM_BUFFER, 2, 0, sizeof(FrameData));
+    frameBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 1, getSphereBlockOffset(), sizeof(SphereBlock));
+    frameBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 18, getTlasBlockOffset(), sizeof(TlasBlock));
+
+    // rebuild the sphere tree from this frame's SphereBuffer, it stays bound for the tracers
+    if (mRenderFlags & RenderFlags::GPU_BVH)
+    {
+        if (!programs.lbvh)
+            programs.lbvh = std::make_unique<Lbvh>(TOTAL_SPHERES);
+        programs.lbvh->build(TOTAL_SPHERES);
+    }
+
+    const unsigned int previous = 1 - current;
+    glBindImageTexture(0, targets.color[current], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(1, targets.color[previous], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(2, targets.gBuffer[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(3, targets.gBuffer[previous], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+
+    // sphere candidates per screen tile, the megakernel's primary rays only test those
+    if (!(mRenderFlags & RenderFlags::WAVEFRONT))
+    {
+        programs.sphereBins.bind();
+        glDispatchCompute(getWorkGroups(SDLHelper::GLFW_WINDOW_X), getWorkGroups(SDLHelper::GLFW_WINDOW_Y), 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // the wavefront kernels bind their own programs
+        programs.compute.bind();
+    }
+    programs.compute.setUniform(programs.pass, TRACE_PASS_PRIMARY);
+
+    const bool checkerboard = (mRenderFlags & RenderFlags::CHECKERBOARD) != 0;
+
+    // checkerboard and wavefront trace their own pixel sets, the focus only applies to the full megakernel trace
+    const bool foveated = (mRenderFlags & RenderFlags::FOVEATED) && !checkerboard && !(mRenderFlags & RenderFlags::WAVEFRONT);
+    if (foveated)
+    {
+        const float diagonal = glm::length(glm::vec2(SDLHelper::GLFW_WINDOW_X, SDLHelper::GLFW_WINDOW_Y));
+        const glm::vec4 fovea(mFocus.x, mFocus.y, FOVEA_INNER_RADIUS * diagonal, FOVEA_OUTER_RADIUS * diagonal);
+        programs.compute.setUniform(programs.fovea, fovea);
+        programs.upsample.setUniform(programs.upsampleFovea, fovea);
+        programs.upsample.setUniform(programs.upsampleFrameIndex, static_cast<GLuint>(mFrameIndex));
+    }
+
+    if (mRenderFlags & RenderFlags::WAVEFRONT)
+    {
+        // replaces the primary megakernel dispatch, temporal and checkerboard do not apply
+        if (!programs.wavefront)
+            programs.wavefront = std::make_unique<Wavefront>(SDLHelper::GLFW_WINDOW_X, SDLHelper::GLFW_WINDOW_Y);
+        programs.wavefront->trace((mRenderFlags & RenderFlags::RAY_SORT) != 0);
+    }
+    else if (checkerboard)
+    {
+        // trace one pixel of each horizontal pair, then fill in the rest
+        if (mRenderFlags & RenderFlags::PERSISTENT)
+            dispatchPersistent(programs, targets, getWorkGroups((SDLHelper::GLFW_WINDOW_X + 1) / 2) * getWorkGroups(SDLHelper::GLFW_WINDOW_Y));
+        else
+            glDispatchCompute(getWorkGroups((SDLHelper::GLFW_WINDOW_X + 1) / 2), getWorkGroups(SDLHelper::GLFW_WINDOW_Y), 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        programs.reconstruct.setUniform(programs.frameIndex, static_cast<GLuint>(mFrameIndex));
+        programs.reconstruct.bind();
+        glDispatchCompute(getWorkGroups(SDLHelper::GLFW_WINDOW_X), getWorkGroups(SDLHelper::GLFW_WINDOW_Y), 1);
+    }
+    else if (mRenderFlags & RenderFlags::PERSISTENT)
+    {
+        dispatchPersistent(programs, targets, getWorkGroups(SDLHelper::GLFW_WINDOW_X) * getWorkGroups(SDLHelper::GLFW_WINDOW_Y));
+    }
+    else
+    {
+        glDispatchCompute(getWorkGroups(SDLHelper::GLFW_WINDOW_X), getWorkGroups(SDLHelper::GLFW_WINDOW_Y), 1);
+    }
+
+    if (foveated)
+    {
+        // fill the peripheral pixels that were not traced this frame
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        programs.upsample.bind();
+        glDispatchCompute(getWorkGroups(SDLHelper::GLFW_WINDOW_X), getWorkGroups(SDLHelper::GLFW_WINDOW_Y), 1);
+    }
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // once frames accumulate they supersample every pixel, the extra samples would replace the running mean
+    if ((mRenderFlags & RenderFlags::ADAPTIVE) && !(isAccumulating() && mAccumulatedFrames != 0))
+    {
+        // reset the indirect arguments to (0, 1, 1), the variance pass appends tiles
+        const GLuint resetArgs[4] = {0, 1, 1, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, targets.tileWorkList);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(resetArgs), resetArgs);
+
+        programs.compute.setUniform(programs.pass, TRACE_PASS_ADAPTIVE);
+        programs.variance.bind();
+        glDispatchCompute(getWorkGroups(SDLHelper::GLFW_WINDOW_X), getWorkGroups(SDLHelper::GLFW_WINDOW_Y), 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        // one work group per high variance tile
+        programs.compute.bind();
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, targets.tileWorkList);
+        glDispatchComputeIndirect(0);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    // color[current] stays unfiltered, temporal reuse and the accumulation keep reading the traced frames
+    GLuint display = targets.color[current];
+    if (mRenderFlags & RenderFlags::DENOISE)
+    {
+        if (!programs.denoiser)
+            programs.denoiser = std::make_unique<Denoiser>(SDLHelper::GLFW_WINDOW_X, SDLHelper::GLFW_WINDOW_Y);
+        display = programs.denoiser->denoise(targets.color[current], targets.gBuffer[current],
+            targets.gBuffer[previous], !(mPrevRenderFlags & RenderFlags::DENOISE));
+    }
+
+    // the slot may be rewritten once the dispatch reading it has completed
+    frameBuffer.fence();
+    return display;
+}
+
+/**
+ * CPU reference path, the frame data is written to host memory instead of the ring buffer.
+ * @brief Compute::traceCpu
+ * @param spheres
+ * @param plane
+ * @param lights
+ * @param ar
+ * @param targets
+ * @param current - ping-pong index written this frame
+ */
+void Compute::traceCpu(const std::vector<Sphere>& spheres, const Plane& plane,
+                       const std::vector<Light>& lights, float ar,
+                       const RenderTargets& targets, unsigned int current)
+{
+    if (!mCpuTracer)
+        mCpuTracer = std::make_unique<CpuTracer>(SDLHelper::GLFW_WINDOW_X, SDLHelper::GLFW_WINDOW_Y);
+
+    mCpuFrameData.resize(static_cast<std::size_t>(getTlasBlockOffset()) + sizeof(TlasBlock));
+    writeFrameData(mCpuFrameData.data(), spheres, plane, lights, ar);
+
+    FrameData frame;
+    std::memcpy(&frame, mCpuFrameData.data(), sizeof(FrameData));
+    mCpuTracer->trace(frame, *reinterpret_cast<const SphereBlock*>(mCpuFrameData.data() + getSphereBlockOffset()),
+        *reinterpret_cast<const TlasBlock*>(mCpuFrameData.data() + getTlasBlockOffset()),
+        *mLightGrid, *mMaterials, *mMesh, *mBlas, *mWideBlas, targets.color[current]);
+
+    // no primary hits from this path, keep temporal reprojection from trusting the G-buffer
+    glClearTexImage(targets.gBuffer[current], 0, GL_RGBA, GL_FLOAT, nullptr);
+}
+
+/**
+ * @brief Compute::getWorkGroups
+ * @param pixels
+ * @return number of LOCAL_GROUP_SIZE work groups covering pixels
+ */
+GLuint Compute::getWorkGroups(unsigned int pixels)
+{
+    return static_cast<GLuint>((pixels + LOCAL_GROUP_SIZE - 1) / LOCAL_GROUP_SIZE);
+}
+
+/**
+ * Launch only as many tile sized work groups as the GPU keeps resident,
+ * each one keeps pulling tiles from the shared counter until none are left.
+ * @brief Compute::dispatchPersistent
+ * @param programs - the compute program must be bound
+ * @param targets
+ * @param totalTiles - tiles in the traced area
+ */
+void Compute::dispatchPersistent(RenderPrograms& programs, const RenderTargets& targets, GLuint totalTiles) const
+{
+    const GLuint resetCounter = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, targets.tileCounter);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(resetCounter), &resetCounter);
+
+    programs.compute.setUniform(programs.pass, TRACE_PASS_PERSISTENT);
+    glDispatchCompute(std::min(getPersistentWorkGroups(), totalTiles), 1, 1);
+    programs.compute.setUniform(programs.pass, TRACE_PASS_PRIMARY);
+}
+
+/**
+ * Starts a rebuild of every program reading a changed file and swaps the
+ * rebuilt programs in together once all of them have finished compiling,
+ * so programs sharing layout.glsl never run against mismatched layouts.
+ * If any of them fails the previous programs stay, the log says why.
+ * @brief Compute::reloadShaders
+ * @param programs
+ * @param watcher
+ */
+void Compute::reloadShaders(RenderPrograms& programs, ShaderWatcher& watcher) const
+{
+    std::vector<Shader*> shaders = {&programs.raytracer, &programs.compute,
+        &programs.reconstruct, &programs.upsample, &programs.variance, &programs.sphereBins};
+    if (programs.wavefront)
+    {
+        std::vector<Shader*> stages = programs.wavefront->getShaders();
+        shaders.insert(shaders.end(), stages.begin(), stages.end());
+    }
+    if (programs.lbvh)
+    {
+        std::vector<Shader*> stages = programs.lbvh->getShaders();
+        shaders.insert(shaders.end(), stages.begin(), stages.end());
+    }
+    if (programs.denoiser)
+    {
+        std::vector<Shader*> stages = programs.denoiser->getShaders();
+        shaders.insert(shaders.end(), stages.begin(), stages.end());
+    }
+
+    for (const std::string& filename : watcher.takeChanged())
+    {
+        for (Shader* shader : shaders)
+        {
+            if (shader->usesFile(filename))
+                shader->reload();
+        }
+    }
+
+    bool reloading = false;
+    for (Shader* shader : shaders)
+    {
+        if (!shader->isReloading())
+            continue;
+        // check again next frame, the compiler threads are still busy
+        if (!shader->isReloadComplete())
+            return;
+        reloading = true;
+    }
+    if (!reloading)
+        return;
+
+    bool linked = true;
+    for (Shader* shader : shaders)
+    {
+        if (shader->isReloading())
+            linked = shader->checkReload() && linked;
+    }
+    for (Shader* shader : shaders)
+        shader->finishReload(linked);
+
+    SDL_Log(linked ? "Shaders reloaded\n" : "Shader reload failed, keeping the previous programs\n");
+}
+
+/**
+ * GL has no portable query for the number of compute units, use the SM count
+ * where NVIDIA exposes it and a fixed number of groups everywhere else.
+ * @brief Compute::getPersistentWorkGroups
+ * @return
+ */
+GLuint Compute::getPersistentWorkGroups()
+{
+    // GL_SM_COUNT_NV from GL_NV_shader_thread_group, not part of the glad profile
+    static const GLenum SM_COUNT_NV = 0x933B;
+    static GLuint workGroups = 0;
+    if (workGroups == 0)
+    {
+        GLint cores = 0;
+        if (GLUtils::HasExtension("GL_NV_shader_thread_group"))
+            glGetIntegerv(SM_COUNT_NV, &cores);
+
+        workGroups = (cores > 0) ? static_cast<GLuint>(cores) * PERSISTENT_GROUPS_PER_CORE : PERSISTENT_FALLBACK_GROUPS;
+        SDL_Log("Persistent threads: %u work groups\n", workGroups);
+    }
+    return workGroups;
+}
+
+/**
+ * Even spheres circle in the xy plane, odd ones in the yz plane.
+ * @brief Compute::getSphereOffset
+ * @param index
+ * @param time - seconds
+ * @return translation of the sphere at time
+ */
+glm::vec3 Compute::getSphereOffset(unsigned int index, float time)
+{
+    if (index % 2 == 0)
+        return glm::vec3(glm::cos(time) * 10.0f, glm::sin(time) * 10.0f, 0.0f);
+    else
+        return glm::vec3(0.0f, glm::cos(time) * 20.0f, glm::sin(time) * 20.0f);
+}
+
+/**
+ * @brief Compute::getSphereBlockOffset
+ * @return offset of SphereBlock inside a frame buffer slot
+ */
+GLintptr Compute::getSphereBlockOffset()
+{
+    return PersistentBuffer::alignOffset(sizeof(FrameData));
+}
+
+/**
+ * @brief Compute::getTlasBlockOffset
+ * @return offset of TlasBlock inside a frame buffer slot
+ */
+GLintptr Compute::getTlasBlockOffset()
+{
+    return PersistentBuffer::alignOffset(getSphereBlockOffset() + static_cast<GLintptr>(sizeof(SphereBlock)));
+}
+
 void Compute::sdlEvents(SDLHelper& sdlHandler, float& mouseWheelDy, bool& running)
 {
     // Event handling can be expanded here if needed
@@ -16,6 +16,7 @@
 #include <glm/gtx/transform.hpp>
 
 #include "Shader.hpp"
+#include "ShaderWatcher.hpp"
 #include "Camera.hpp"
 #include "Player.hpp"
 #include "SDLHelper.hpp"
@@ -26,23 +27,119 @@
 #include "Material.hpp"
 #include "Sphere.hpp"
 #include "Plane.hpp"
+#include "FrameData.hpp"
+#include "PersistentBuffer.hpp"
+#include "Wavefront.hpp"
+#include "CpuTracer.hpp"
+#include "LightGrid.hpp"
+#include "MaterialTable.hpp"
+#include "Mesh.hpp"
+#include "Bvh.hpp"
+#include "Tlas.hpp"
+#include "Lbvh.hpp"
+#include "WideBvh.hpp"
+#include "Denoiser.hpp"
+#include "TextureArray.hpp"
 
 class Compute
 {
 private:
+    struct RenderPrograms
+    {
+        Shader raytracer;
+        Shader compute;
+        Shader reconstruct;
+        // reconstruct.cs.glsl built for the foveated trace
+        Shader upsample;
+        Shader variance;
+        Shader sphereBins;
+        // uPass and uFrameIndex, resolved once after linking
+        Shader::Uniform pass;
+        Shader::Uniform frameIndex;
+        // uFovea of compute, uFrameIndex and uFovea of upsample
+        Shader::Uniform fovea;
+        Shader::Uniform upsampleFrameIndex;
+        Shader::Uniform upsampleFovea;
+        // queue buffers are large, only created once the mode is enabled
+        Wavefront::Ptr wavefront;
+        Lbvh::Ptr lbvh;
+        Denoiser::Ptr denoiser;
+    };
+
+    // ping-pong images, index (frame % 2) is written this frame
+    struct RenderTargets
+    {
+        GLuint color[2];
+        GLuint gBuffer[2];
+        GLuint tileWorkList;
+        GLuint tileCounter;
+        GLuint tileSpheres;
+    };
+
     Camera mCamera;
     Player mPlayer;
+    glm::mat4 mPrevViewProj;
+    glm::vec3 mPrevEye;
+    // foveated mode's focus in image pixels, follows the cursor
+    glm::vec2 mFocus;
+    unsigned int mFrameIndex;
+    unsigned int mRenderFlags;
+    unsigned int mPrevRenderFlags;
+    unsigned int mAccumulatedFrames;
+    // drives the sphere and instance animation, held while the stochastic lighting accumulates
+    float mSceneTime;
+    CpuTracer::Ptr mCpuTracer;
+    LightGrid::Ptr mLightGrid;
+    MaterialTable::Ptr mMaterials;
+    TextureArray::Ptr mTextures;
+    Mesh::Ptr mMesh;
+    Bvh::Ptr mBlas;
+    WideBvh::Ptr mWideBlas;
+    Tlas::Ptr mTlas;
+    std::vector<Tlas::Instance> mInstances;
+    std::vector<char> mCpuFrameData;
     static const glm::vec3 CLEAR_COLOR;
+    static const unsigned int LOCAL_GROUP_SIZE;
+    static const unsigned int TEMPORAL_REFRESH_PERIOD;
+    static const float FOVEA_INNER_RADIUS;
+    static const float FOVEA_OUTER_RADIUS;
+    static const GLuint TRACE_PASS_PRIMARY;
+    static const GLuint TRACE_PASS_ADAPTIVE;
+    static const GLuint TRACE_PASS_PERSISTENT;
+    static const GLuint PERSISTENT_GROUPS_PER_CORE;
+    static const GLuint PERSISTENT_FALLBACK_GROUPS;
+    static const unsigned int ORBITING_MESH_INSTANCES;
+    static const std::vector<std::string> TEXTURE_FILES;
     static std::unordered_map<std::uint8_t, bool> mKepMap;
 
-    void initCompute(Shader& compute, GLuint shapeSSBO,
-        std::vector<Sphere>& spheres, Plane& plane,
-        std::vector<Light>& lights);
+    void initCompute(std::vector<Sphere>& spheres, std::vector<Material>& sphereMaterials, Plane& plane,
+        std::vector<Light>& lights, std::vector<PointLightData>& pointLights);
+    void initScene();
+    void updateInstances(float time, bool sphereTree);
     void input(SDLHelper& sdlHandler);
+    bool keyPressed(const SDLHelper& sdlHandler, SDL_Scancode key);
+    bool isAccumulating() const;
     void update(const float dt);
-    void render(Shader& compute, Shader& raytracer,
-        const std::vector<Sphere>& spheres, float ar,
-        GLuint vao, GLuint tex, GLenum type = GL_TRIANGLE_STRIP);
+    void writeFrameData(void* slot, const std::vector<Sphere>& spheres,
+        const Plane& plane, const std::vector<Light>& lights, float ar);
+    void render(RenderPrograms& programs, PersistentBuffer& frameBuffer,
+        const std::vector<Sphere>& spheres, const Plane& plane,
+        const std::vector<Light>& lights, float ar,
+        GLuint vao, const RenderTargets& targets, GLenum type = GL_TRIANGLE_STRIP);
+    GLuint traceGpu(RenderPrograms& programs, PersistentBuffer& frameBuffer,
+        const std::vector<Sphere>& spheres, const Plane& plane,
+        const std::vector<Light>& lights, float ar,
+        const RenderTargets& targets, unsigned int current);
+    void traceCpu(const std::vector<Sphere>& spheres, const Plane& plane,
+        const std::vector<Light>& lights, float ar,
+        const RenderTargets& targets, unsigned int current);
+    void dispatchPersistent(RenderPrograms& programs, const RenderTargets& targets, GLuint totalTiles) const;
+    void reloadShaders(RenderPrograms& programs, ShaderWatcher& watcher) const;
+    static GLuint getWorkGroups(unsigned int pixels);
+    static GLuint getPersistentWorkGroups();
+    static glm::vec3 getSphereOffset(unsigned int index, float time);
+    static GLintptr getSphereBlockOffset();
+    static GLintptr getTlasBlockOffset();
 
     void sdlEvents(SDLHelper& sdlHandler, float& mouseWheelDy, bool& running);
     void printFramesToConsole(SDLHelper& sdlHandler, unsigned int frameCounter, float timeSinceLastUpdate) const noexcept;
@@ -0,0 +1,770 @@
+#include "CpuTracer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_TRACER_SSE
+#include <emmintrin.h>
+#endif
+
+// should match the defines in raytracer.cs.glsl
+const unsigned int CpuTracer::TILE_SIZE = 20;
+
+namespace
+{
+const int SPHERE_ID = 0;
+const int PLANE_ID = 1;
+const int TRIANGLE_ID = 2;
+// triangle hits carry their instance in the upper bits of objArrayIndex
+const unsigned int MESH_INSTANCE_SHIFT = 22;
+const GLuint MESH_TRIANGLE_MASK = (1u << MESH_INSTANCE_SHIFT) - 1u;
+const float EPSILON = 0.001f;
+const float CHECKER_SQUARE_SIZE = 0.05f;
+// should match SHADOW_FACTOR in shading.glsl
+const float SHADOW_FACTOR = 0.1f;
+const unsigned int MAX_RAY_BOUNCES = 5;
+
+struct ShadeMaterial
+{
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    float shininess;
+};
+
+/**
+ * Slab test, same as intersectBounds in intersect.glsl.
+ * @return entry distance, or a value >= tMax on a miss
+ */
+float intersectBounds(const glm::vec3& origin, const glm::vec3& invDir,
+    const glm::vec3& boundsMin, const glm::vec3& boundsMax, float tMax)
+{
+    glm::vec3 t0 = (boundsMin - origin) * invDir;
+    glm::vec3 t1 = (boundsMax - origin) * invDir;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return (tEnter <= tExit) ? tEnter : tMax;
+}
+
+/**
+ * @return distance along the ray, negative on a miss
+ */
+float intersectSphere(const Sphere& sphere, const glm::vec3& origin, const glm::vec3& direction)
+{
+    glm::vec3 diff = origin - sphere.center;
+    float b = glm::dot(direction, diff);
+    float c = glm::dot(diff, diff) - sphere.radius * sphere.radius;
+    float discriminant = b * b - c;
+    if (discriminant < 0.0f)
+        return -1.0f;
+
+    // the far root when the origin is inside, shadow rays leave from the surface
+    float root = std::sqrt(discriminant);
+    return (-b - root > EPSILON) ? -b - root : -b + root;
+}
+
+#if defined(CPU_TRACER_SSE)
+// the four bytes of a quantized word as floats, child 0 in lane 0
+__m128 unpackQuantized(GLuint packed)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(packed));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+}
+
+// entry distances of one axis' slabs, dequantized as origin + q * scale
+void intersectSlabs(GLuint quantizedMin, GLuint quantizedMax, float origin, float scale,
+    float rayOrigin, float invDir, __m128& tNear, __m128& tFar)
+{
+    const __m128 base = _mm_set1_ps(origin);
+    const __m128 step = _mm_set1_ps(scale);
+    const __m128 start = _mm_set1_ps(rayOrigin);
+    const __m128 inv = _mm_set1_ps(invDir);
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(base, _mm_mul_ps(unpackQuantized(quantizedMin), step)), start), inv);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(base, _mm_mul_ps(unpackQuantized(quantizedMax), step)), start), inv);
+    tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+    tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+}
+#endif
+
+/**
+ * Slab test against the four quantized child boxes of a wide node at once.
+ * @param tEnter - entry distance per child
+ * @return bit c set when child c is entered before tMax
+ */
+unsigned int intersectWideChildren(const WideBvhNodeData& node, const glm::vec3& origin,
+    const glm::vec3& invDir, float tMax, float tEnter[4])
+{
+#if defined(CPU_TRACER_SSE)
+    __m128 tNear = _mm_setzero_ps();
+    __m128 tFar = _mm_set1_ps(tMax);
+    intersectSlabs(node.quantizedMinX, node.quantizedMaxX, node.origin.x, node.scale.x, origin.x, invDir.x, tNear, tFar);
+    intersectSlabs(node.quantizedMinY, node.quantizedMaxY, node.origin.y, node.scale.y, origin.y, invDir.y, tNear, tFar);
+    intersectSlabs(node.quantizedMinZ, node.quantizedMaxZ, node.origin.z, node.scale.z, origin.z, invDir.z, tNear, tFar);
+    _mm_storeu_ps(tEnter, tNear);
+    return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+#else
+    unsigned int hits = 0;
+    for (unsigned int child = 0; child != WideBvh::WIDTH; ++child)
+    {
+        const unsigned int shift = 8 * child;
+        glm::vec3 boundsMin = node.origin + glm::vec3(static_cast<float>((node.quantizedMinX >> shift) & 0xFFu),
+            static_cast<float>((node.quantizedMinY >> shift) & 0xFFu), static_cast<float>((node.quantizedMinZ >> shift) & 0xFFu)) * node.scale;
+        glm::vec3 boundsMax = node.origin + glm::vec3(static_cast<float>((node.quantizedMaxX >> shift) & 0xFFu),
+            static_cast<float>((node.quantizedMaxY >> shift) & 0xFFu), static_cast<float>((node.quantizedMaxZ >> shift) & 0xFFu)) * node.scale;
+        tEnter[child] = intersectBounds(origin, invDir, boundsMin, boundsMax, tMax);
+        if (tEnter[child] < tMax)
+            hits |= 1u << child;
+    }
+    return hits;
+#endif
+}
+
+glm::vec3 transformPoint(const glm::vec4 rows[3], const glm::vec3& point)
+{
+    glm::vec4 p(point, 1.0f);
+    return glm::vec3(glm::dot(rows[0], p), glm::dot(rows[1], p), glm::dot(rows[2], p));
+}
+
+glm::vec3 transformVector(const glm::vec4 rows[3], const glm::vec3& vector)
+{
+    return glm::vec3(glm::dot(glm::vec3(rows[0]), vector), glm::dot(glm::vec3(rows[1]), vector),
+        glm::dot(glm::vec3(rows[2]), vector));
+}
+}
+
+/**
+ * @brief CpuTracer::CpuTracer
+ * @param width
+ * @param height
+ */
+CpuTracer::CpuTracer(GLsizei width, GLsizei height)
+: mWidth(width)
+, mHeight(height)
+, mPixels(static_cast<std::size_t>(width) * static_cast<std::size_t>(height))
+{
+
+}
+
+/**
+ * @brief CpuTracer::trace
+ * @param frame - the same data the GPU reads from FrameBlock
+ * @param spheres - TOTAL_SPHERES animated spheres
+ * @param tlas - this frame's instances and the tree over them
+ * @param lightGrid - point lights, used when RenderFlags::POINT_LIGHTS is set
+ * @param materials - the sphere materials, looked up on the closest hit
+ * @param mesh
+ * @param blas - over the mesh triangles, in object space
+ * @param wideBlas - the same tree collapsed, used when RenderFlags::WIDE_BVH is set
+ * @param colorTexture - RGBA32F, mWidth x mHeight
+ */
+void CpuTracer::trace(const FrameData& frame, const SphereBlock& spheres, const TlasBlock& tlas,
+    const LightGrid& lightGrid, const MaterialTable& materials, const Mesh& mesh, const Bvh& blas,
+    const WideBvh& wideBlas, GLuint colorTexture)
+{
+    const Scene scene = {frame, spheres, tlas, lightGrid, materials, mesh, blas, wideBlas};
+    const unsigned int tilesX = (static_cast<unsigned int>(mWidth) + TILE_SIZE - 1) / TILE_SIZE;
+    const unsigned int tilesY = (static_cast<unsigned int>(mHeight) + TILE_SIZE - 1) / TILE_SIZE;
+
+    mScheduler.run(tilesX, tilesY, [&](unsigned int tileX, unsigned int tileY) {
+        const unsigned int endX = std::min((tileX + 1) * TILE_SIZE, static_cast<unsigned int>(mWidth));
+        const unsigned int endY = std::min((tileY + 1) * TILE_SIZE, static_cast<unsigned int>(mHeight));
+
+        for (unsigned int y = tileY * TILE_SIZE; y < endY; ++y)
+        {
+            for (unsigned int x = tileX * TILE_SIZE; x < endX; ++x)
+            {
+                glm::vec2 pixelPos = glm::vec2(static_cast<float>(x) / static_cast<float>(mWidth - 1),
+                    static_cast<float>(y) / static_cast<float>(mHeight - 1));
+                glm::vec3 cameraDir = glm::mix(
+                    glm::mix(glm::vec3(frame.camera.ray00), glm::vec3(frame.camera.ray01), pixelPos.y),
+                    glm::mix(glm::vec3(frame.camera.ray10), glm::vec3(frame.camera.ray11), pixelPos.y), pixelPos.x);
+
+                Ray ray = {frame.camera.eye, glm::normalize(cameraDir)};
+                mPixels.at(static_cast<std::size_t>(y) * mWidth + x) = glm::vec4(traceRay(scene, ray, x, y), 1.0f);
+            }
+        }
+    });
+
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, GL_RGBA, GL_FLOAT, mPixels.data());
+}
+
+/**
+ * Same bounce loop as traceRay in raytracer.cs.glsl.
+ * @brief CpuTracer::traceRay
+ * @param scene
+ * @param ray
+ * @param x - pixel, for the background gradient
+ * @param y
+ * @return
+ */
+glm::vec3 CpuTracer::traceRay(const Scene& scene, Ray ray, unsigned int x, unsigned int y) const
+{
+    const FrameData& frame = scene.frame;
+    glm::vec3 finalColor(0.0f);
+    float colorFrac = 0.999f;
+
+    for (unsigned int bounce = 0; bounce != MAX_RAY_BOUNCES; ++bounce)
+    {
+        int objArrayIndex = -1;
+        int objectID = -1;
+        float tClosest = findObjectIntersection(scene, ray, objectID, objArrayIndex, frame.camera.far);
+
+        if (objectID == -1)
+        {
+            // No intersection - render gradient background
+            finalColor += glm::vec3(static_cast<float>(x) / static_cast<float>(mWidth),
+                static_cast<float>(y) / static_cast<float>(mHeight), frame.time - std::floor(frame.time));
+            break;
+        }
+
+        glm::vec3 intPoint = ray.origin + ray.direction * tClosest;
+        glm::vec3 intNormal;
+        float reflValue;
+        ShadeMaterial material;
+        if (objectID == SPHERE_ID)
+        {
+            const MaterialData& sphereMaterial = scene.materials.getSphereMaterial(static_cast<unsigned int>(objArrayIndex));
+            material = {glm::vec3(sphereMaterial.diffuse), sphereMaterial.specular, sphereMaterial.shininess};
+            intNormal = glm::normalize(intPoint - scene.spheres.spheres[objArrayIndex].center);
+            reflValue = sphereMaterial.reflective;
+        }
+        else if (objectID == TRIANGLE_ID)
+        {
+            intNormal = getTriangleNormal(scene, static_cast<GLuint>(objArrayIndex));
+            reflValue = frame.meshMaterial.reflective;
+            material = {glm::vec3(frame.meshMaterial.diffuse), frame.meshMaterial.specular, frame.meshMaterial.shininess};
+        }
+        else
+        {
+            intNormal = frame.plane.normal;
+            reflValue = frame.plane.material.reflective;
+            material = {glm::vec3(frame.plane.material.diffuse), frame.plane.material.specular, frame.plane.material.shininess};
+
+            // checkerboard, black squares
+            int square = static_cast<int>(std::floor(intPoint.x * CHECKER_SQUARE_SIZE) + std::floor(intPoint.z * CHECKER_SQUARE_SIZE));
+            if (square % 2 != 0)
+            {
+                material.diffuse = glm::vec3(0.01f);
+                material.specular = glm::vec3(0.01f);
+            }
+        }
+
+        // make sure we didn't intersect from inside the active obj
+        if (glm::dot(ray.direction, intNormal) > 0.0f)
+            intNormal = -intNormal;
+
+        glm::vec3 localColor(0.0f);
+        for (unsigned int index = 0; index != TOTAL_LIGHTS; ++index)
+        {
+            const LightData& light = frame.lights[index];
+
+            // w=0 means directional, w=1 means point light
+            glm::vec3 lightDir = (light.position.w == 0.0f) ? glm::normalize(glm::vec3(light.position))
+                : glm::normalize(glm::vec3(light.position) - intPoint);
+            Ray lightRay = {intPoint + intNormal * EPSILON, lightDir};
+
+            float maxDist = (light.position.w == 0.0f) ? frame.camera.far : glm::length(glm::vec3(light.position) - intPoint);
+            float shadow = isOccluded(scene, lightRay, maxDist) ? SHADOW_FACTOR : 1.0f;
+
+            // phong, pow of a negative base is undefined in GLSL so it is clamped here
+            glm::vec3 reflectDir = glm::reflect(lightDir, intNormal);
+            glm::vec3 diffuse = glm::vec3(light.diffuse) * material.diffuse * std::max(glm::dot(lightDir, intNormal), 0.0f);
+            glm::vec3 specular = glm::vec3(light.specular) * material.specular
+                * std::pow(std::max(glm::dot(ray.direction, reflectDir), 0.0f), material.shininess);
+            localColor += shadow * (diffuse + specular) + glm::vec3(light.ambient) * 0.01f;
+        }
+
+        if (frame.settings.x & RenderFlags::POINT_LIGHTS)
+            localColor += shadePointLights(scene, intPoint, intNormal, ray.direction,
+                material.diffuse, material.specular, material.shininess);
+
+        finalColor += localColor * (1.0f - reflValue) * colorFrac;
+        colorFrac *= reflValue;
+
+        if (reflValue > 0.0f)
+            ray = {intPoint + intNormal * EPSILON, glm::normalize(glm::reflect(ray.direction, intNormal))};
+
+        if (colorFrac < 0.01f)
+            break;
+    }
+
+    return finalColor;
+}
+
+/**
+ * Same as shadePointLights in shading.glsl.
+ * @brief CpuTracer::shadePointLights
+ * @param scene
+ * @param intPoint
+ * @param intNormal
+ * @param viewDir
+ * @param diffuse
+ * @param specular
+ * @param shininess
+ * @return
+ */
+glm::vec3 CpuTracer::shadePointLights(const Scene& scene,
+    const glm::vec3& intPoint, const glm::vec3& intNormal, const glm::vec3& viewDir,
+    const glm::vec3& diffuse, const glm::vec3& specular, float shininess) const
+{
+    const LightGrid& lightGrid = scene.lightGrid;
+    glm::uvec2 cell;
+    if (!lightGrid.getCell(intPoint, cell))
+        return glm::vec3(0.0f);
+
+    glm::vec3 color(0.0f);
+    for (GLuint index = cell.x; index != cell.x + cell.y; ++index)
+    {
+        const PointLightData& light = lightGrid.getLights().at(lightGrid.getLightIndices().at(index));
+
+        glm::vec3 toLight = glm::vec3(light.position) - intPoint;
+        float dist = glm::length(toLight);
+        if (dist >= light.position.w)
+            continue;
+
+        glm::vec3 lightDir = toLight / dist;
+        float cosTheta = glm::dot(lightDir, intNormal);
+        if (cosTheta <= 0.0f)
+            continue;
+
+        if (isOccluded(scene, {intPoint + intNormal * EPSILON, lightDir}, dist))
+            continue;
+
+        float falloff = 1.0f - dist / light.position.w;
+        glm::vec3 reflectDir = glm::reflect(lightDir, intNormal);
+        glm::vec3 shaded = diffuse * cosTheta + specular * std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), shininess);
+        color += glm::vec3(light.color) * shaded * falloff * falloff;
+    }
+
+    return color;
+}
+
+/**
+ * Same as findObjectIntersection in intersect.glsl, the TLAS is walked
+ * nearest child first, mesh instances continue into their BLAS with the ray
+ * in object space. The plane is not part of either tree.
+ * @brief CpuTracer::findObjectIntersection
+ * @param scene
+ * @param ray
+ * @param objectID - SPHERE_ID, PLANE_ID, TRIANGLE_ID or unchanged on a miss
+ * @param objArrayIndex - sphere index, or instance << MESH_INSTANCE_SHIFT | triangle
+ * @param farPlane
+ * @return distance to the closest hit, farPlane on a miss
+ */
+float CpuTracer::findObjectIntersection(const Scene& scene, const Ray& ray,
+    int& objectID, int& objArrayIndex, float farPlane) const
+{
+    const FrameData& frame = scene.frame;
+    const TlasBlock& tlas = scene.tlas;
+    const glm::vec3 invDir = 1.0f / ray.direction;
+    float tClosest = farPlane;
+
+    GLuint stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    if (intersectBounds(ray.origin, invDir, tlas.nodes[0].boundsMin, tlas.nodes[0].boundsMax, tClosest) < tClosest)
+        stack[stackSize++] = 0;
+
+    while (stackSize != 0)
+    {
+        const BvhNodeData& node = tlas.nodes[stack[--stackSize]];
+        const GLuint count = node.count & ~Bvh::SHADOW_RIGHT_FIRST;
+        if (count != 0)
+        {
+            for (GLuint index = node.leftFirst; index != node.leftFirst + count; ++index)
+            {
+                const GLuint instanceIndex = tlas.instanceRefs[index];
+                const InstanceData& instance = tlas.instances[instanceIndex];
+                if (instance.info.x == Tlas::INSTANCE_SPHERE)
+                {
+                    float t = intersectSphere(scene.spheres.spheres[instance.info.y], ray.origin, ray.direction);
+                    if (t > EPSILON && t < tClosest)
+                    {
+                        tClosest = t;
+                        objectID = SPHERE_ID;
+                        objArrayIndex = static_cast<int>(instance.info.y);
+                    }
+                    continue;
+                }
+
+                int triangle = -1;
+                Ray objectRay = {transformPoint(instance.worldToObject, ray.origin),
+                    transformVector(instance.worldToObject, ray.direction)};
+                if (scene.frame.settings.x & RenderFlags::WIDE_BVH)
+                    intersectWideBlas(scene, objectRay, instance.info.y, tClosest, triangle);
+                else
+                    intersectBlas(scene, objectRay, instance.info.y, tClosest, triangle);
+                if (triangle != -1)
+                {
+                    objectID = TRIANGLE_ID;
+                    objArrayIndex = static_cast<int>((instanceIndex << MESH_INSTANCE_SHIFT) | static_cast<GLuint>(triangle));
+                }
+            }
+            continue;
+        }
+
+        const BvhNodeData& left = tlas.nodes[node.leftFirst];
+        const BvhNodeData& right = tlas.nodes[node.leftFirst + 1];
+        float tLeft = intersectBounds(ray.origin, invDir, left.boundsMin, left.boundsMax, tClosest);
+        float tRight = intersectBounds(ray.origin, invDir, right.boundsMin, right.boundsMax, tClosest);
+
+        // push the far child first so the near one is popped next
+        GLuint nearChild = node.leftFirst, farChild = node.leftFirst + 1;
+        if (tRight < tLeft)
+        {
+            std::swap(nearChild, farChild);
+            std::swap(tLeft, tRight);
+        }
+        if (tRight < tClosest)
+            stack[stackSize++] = farChild;
+        if (tLeft < tClosest)
+            stack[stackSize++] = nearChild;
+    }
+
+    // t = [norm dot ( point - ray.origin )] / [norm dot ray.dir]
+    float a = glm::dot(frame.plane.normal, ray.direction);
+    if (a != 0.0f)
+    {
+        float t0 = glm::dot(frame.plane.normal, glm::vec3(frame.plane.point) - ray.origin) / a;
+        if (t0 > EPSILON && t0 < tClosest)
+        {
+            tClosest = t0;
+            objectID = PLANE_ID;
+        }
+    }
+
+    return tClosest;
+}
+
+/**
+ * Same as isOccluded in intersect.glsl, plane first, then the TLAS and
+ * the BLAS of every mesh instance any-hit, larger child first.
+ * @brief CpuTracer::isOccluded
+ * @param scene
+ * @param ray
+ * @param maxDist - distance to the light
+ * @return true on the first hit between EPSILON and maxDist
+ */
+bool CpuTracer::isOccluded(const Scene& scene, const Ray& ray, float maxDist) const
+{
+    const FrameData& frame = scene.frame;
+    float a = glm::dot(frame.plane.normal, ray.direction);
+    if (a != 0.0f)
+    {
+        float tPlane = glm::dot(frame.plane.normal, glm::vec3(frame.plane.point) - ray.origin) / a;
+        if (tPlane > EPSILON && tPlane < maxDist)
+            return true;
+    }
+
+    const TlasBlock& tlas = scene.tlas;
+    const glm::vec3 invDir = 1.0f / ray.direction;
+
+    GLuint stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize != 0)
+    {
+        const BvhNodeData& node = tlas.nodes[stack[--stackSize]];
+        if (intersectBounds(ray.origin, invDir, node.boundsMin, node.boundsMax, maxDist) >= maxDist)
+            continue;
+
+        const GLuint count = node.count & ~Bvh::SHADOW_RIGHT_FIRST;
+        if (count != 0)
+        {
+            for (GLuint index = node.leftFirst; index != node.leftFirst + count; ++index)
+            {
+                const InstanceData& instance = tlas.instances[tlas.instanceRefs[index]];
+                if (instance.info.x == Tlas::INSTANCE_SPHERE)
+                {
+                    float t = intersectSphere(scene.spheres.spheres[instance.info.y], ray.origin, ray.direction);
+                    if (t > EPSILON && t < maxDist)
+                        return true;
+                    continue;
+                }
+
+                Ray objectRay = {transformPoint(instance.worldToObject, ray.origin),
+                    transformVector(instance.worldToObject, ray.direction)};
+                const bool occluded = (scene.frame.settings.x & RenderFlags::WIDE_BVH)
+                    ? isWideBlasOccluded(scene, objectRay, instance.info.y, maxDist)
+                    : isBlasOccluded(scene, objectRay, instance.info.y, maxDist);
+                if (occluded)
+                    return true;
+            }
+            continue;
+        }
+
+        const bool rightFirst = (node.count & Bvh::SHADOW_RIGHT_FIRST) != 0;
+        stack[stackSize++] = rightFirst ? node.leftFirst : node.leftFirst + 1;
+        stack[stackSize++] = rightFirst ? node.leftFirst + 1 : node.leftFirst;
+    }
+
+    return false;
+}
+
+/**
+ * The object space direction is not renormalized, so t stays a world space distance.
+ * @brief CpuTracer::intersectBlas
+ * @param scene
+ * @param objectRay
+ * @param root - BLAS root node
+ * @param tClosest - lowered on a closer hit
+ * @param triangle - set on a closer hit
+ */
+void CpuTracer::intersectBlas(const Scene& scene, const Ray& objectRay, GLuint root, float& tClosest, int& triangle) const
+{
+    const std::vector<BvhNodeData>& nodes = scene.blas.getNodes();
+    const std::vector<GLuint>& refs = scene.blas.getPrimitiveRefs();
+    const glm::vec3 invDir = 1.0f / objectRay.direction;
+
+    GLuint stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize != 0)
+    {
+        const BvhNodeData& node = nodes.at(stack[--stackSize]);
+        if (intersectBounds(objectRay.origin, invDir, node.boundsMin, node.boundsMax, tClosest) >= tClosest)
+            continue;
+
+        const GLuint count = node.count & ~Bvh::SHADOW_RIGHT_FIRST;
+        if (count != 0)
+        {
+            for (GLuint index = node.leftFirst; index != node.leftFirst + count; ++index)
+            {
+                float t = intersectTriangle(scene, objectRay, refs.at(index));
+                if (t > EPSILON && t < tClosest)
+                {
+                    tClosest = t;
+                    triangle = static_cast<int>(refs.at(index));
+                }
+            }
+            continue;
+        }
+
+        const BvhNodeData& left = nodes.at(node.leftFirst);
+        const BvhNodeData& right = nodes.at(node.leftFirst + 1);
+        float tLeft = intersectBounds(objectRay.origin, invDir, left.boundsMin, left.boundsMax, tClosest);
+        float tRight = intersectBounds(objectRay.origin, invDir, right.boundsMin, right.boundsMax, tClosest);
+        GLuint nearChild = node.leftFirst, farChild = node.leftFirst + 1;
+        if (tRight < tLeft)
+        {
+            std::swap(nearChild, farChild);
+            std::swap(tLeft, tRight);
+        }
+        if (tRight < tClosest)
+            stack[stackSize++] = farChild;
+        if (tLeft < tClosest)
+            stack[stackSize++] = nearChild;
+    }
+}
+
+/**
+ * @brief CpuTracer::isBlasOccluded
+ * @param scene
+ * @param objectRay
+ * @param root - BLAS root node
+ * @param maxDist
+ * @return true on any triangle between EPSILON and maxDist
+ */
+bool CpuTracer::isBlasOccluded(const Scene& scene, const Ray& objectRay, GLuint root, float maxDist) const
+{
+    const std::vector<BvhNodeData>& nodes = scene.blas.getNodes();
+    const std::vector<GLuint>& refs = scene.blas.getPrimitiveRefs();
+    const glm::vec3 invDir = 1.0f / objectRay.direction;
+
+    GLuint stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize != 0)
+    {
+        const BvhNodeData& node = nodes.at(stack[--stackSize]);
+        if (intersectBounds(objectRay.origin, invDir, node.boundsMin, node.boundsMax, maxDist) >= maxDist)
+            continue;
+
+        const GLuint count = node.count & ~Bvh::SHADOW_RIGHT_FIRST;
+        if (count != 0)
+        {
+            for (GLuint index = node.leftFirst; index != node.leftFirst + count; ++index)
+            {
+                float t = intersectTriangle(scene, objectRay, refs.at(index));
+                if (t > EPSILON && t < maxDist)
+                    return true;
+            }
+            continue;
+        }
+
+        const bool rightFirst = (node.count & Bvh::SHADOW_RIGHT_FIRST) != 0;
+        stack[stackSize++] = rightFirst ? node.leftFirst : node.leftFirst + 1;
+        stack[stackSize++] = rightFirst ? node.leftFirst + 1 : node.leftFirst;
+    }
+
+    return false;
+}
+
+/**
+ * Same as intersectBlas over the WideBvh, the hit interior children are
+ * pushed far to near, leaves are tested as soon as their box is entered.
+ * @brief CpuTracer::intersectWideBlas
+ * @param scene
+ * @param objectRay
+ * @param root - wide BLAS root node
+ * @param tClosest - lowered on a closer hit
+ * @param triangle - set on a closer hit
+ */
+void CpuTracer::intersectWideBlas(const Scene& scene, const Ray& objectRay, GLuint root, float& tClosest, int& triangle) const
+{
+    const std::vector<WideBvhNodeData>& nodes = scene.wideBlas.getNodes();
+    const std::vector<GLuint>& refs = scene.blas.getPrimitiveRefs();
+    const glm::vec3 invDir = 1.0f / objectRay.direction;
+
+    GLuint stack[WIDE_BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize != 0)
+    {
+        const WideBvhNodeData& node = nodes.at(stack[--stackSize]);
+        float tEnter[4];
+        unsigned int hits = intersectWideChildren(node, objectRay.origin, invDir, tClosest, tEnter);
+
+        GLuint hitChildren[4];
+        float hitT[4];
+        unsigned int hitCount = 0;
+        for (unsigned int child = 0; child != WideBvh::WIDTH; ++child)
+        {
+            if ((hits & (1u << child)) == 0 || tEnter[child] >= tClosest)
+                continue;
+
+            const GLuint encoded = node.children[child];
+            if (encoded & WideBvh::LEAF_BIT)
+            {
+                const GLuint first = encoded & WideBvh::LEAF_FIRST_MASK;
+                const GLuint count = (encoded & ~WideBvh::LEAF_BIT) >> WideBvh::LEAF_COUNT_SHIFT;
+                for (GLuint index = first; index != first + count; ++index)
+                {
+                    float t = intersectTriangle(scene, objectRay, refs.at(index));
+                    if (t > EPSILON && t < tClosest)
+                    {
+                        tClosest = t;
+                        triangle = static_cast<int>(refs.at(index));
+                    }
+                }
+                continue;
+            }
+
+            // insertion sort, farthest first
+            unsigned int slot = hitCount++;
+            while (slot != 0 && hitT[slot - 1] < tEnter[child])
+            {
+                hitT[slot] = hitT[slot - 1];
+                hitChildren[slot] = hitChildren[slot - 1];
+                --slot;
+            }
+            hitT[slot] = tEnter[child];
+            hitChildren[slot] = encoded;
+        }
+
+        for (unsigned int index = 0; index != hitCount; ++index)
+            stack[stackSize++] = hitChildren[index];
+    }
+}
+
+/**
+ * @brief CpuTracer::isWideBlasOccluded
+ * @param scene
+ * @param objectRay
+ * @param root - wide BLAS root node
+ * @param maxDist
+ * @return true on any triangle between EPSILON and maxDist
+ */
+bool CpuTracer::isWideBlasOccluded(const Scene& scene, const Ray& objectRay, GLuint root, float maxDist) const
+{
+    const std::vector<WideBvhNodeData>& nodes = scene.wideBlas.getNodes();
+    const std::vector<GLuint>& refs = scene.blas.getPrimitiveRefs();
+    const glm::vec3 invDir = 1.0f / objectRay.direction;
+
+    GLuint stack[WIDE_BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = root;
+    while (stackSize != 0)
+    {
+        const WideBvhNodeData& node = nodes.at(stack[--stackSize]);
+        float tEnter[4];
+        unsigned int hits = intersectWideChildren(node, objectRay.origin, invDir, maxDist, tEnter);
+        for (unsigned int child = 0; child != WideBvh::WIDTH; ++child)
+        {
+            if ((hits & (1u << child)) == 0)
+                continue;
+
+            const GLuint encoded = node.children[child];
+            if ((encoded & WideBvh::LEAF_BIT) == 0)
+            {
+                stack[stackSize++] = encoded;
+                continue;
+            }
+
+            const GLuint first = encoded & WideBvh::LEAF_FIRST_MASK;
+            const GLuint count = (encoded & ~WideBvh::LEAF_BIT) >> WideBvh::LEAF_COUNT_SHIFT;
+            for (GLuint index = first; index != first + count; ++index)
+            {
+                float t = intersectTriangle(scene, objectRay, refs.at(index));
+                if (t > EPSILON && t < maxDist)
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Moller-Trumbore, both windings.
+ * @brief CpuTracer::intersectTriangle
+ * @param scene
+ * @param ray - in object space
+ * @param triangle
+ * @return distance along the ray, negative on a miss
+ */
+float CpuTracer::intersectTriangle(const Scene& scene, const Ray& ray, GLuint triangle) const
+{
+    glm::vec3 v0 = scene.mesh.getVertex(triangle, 0);
+    glm::vec3 edge1 = scene.mesh.getVertex(triangle, 1) - v0;
+    glm::vec3 edge2 = scene.mesh.getVertex(triangle, 2) - v0;
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float det = glm::dot(edge1, p);
+    if (std::abs(det) < 1e-8f)
+        return -1.0f;
+
+    float invDet = 1.0f / det;
+    glm::vec3 s = ray.origin - v0;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return -1.0f;
+
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(ray.direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+
+    return glm::dot(edge2, q) * invDet;
+}
+
+/**
+ * Flat normal in world space, flipped towards the ray by the caller.
+ * @brief CpuTracer::getTriangleNormal
+ * @param scene
+ * @param packedTriangle - instance << MESH_INSTANCE_SHIFT | triangle
+ * @return
+ */
+glm::vec3 CpuTracer::getTriangleNormal(const Scene& scene, GLuint packedTriangle) const
+{
+    const GLuint triangle = packedTriangle & MESH_TRIANGLE_MASK;
+    const InstanceData& instance = scene.tlas.instances[packedTriangle >> MESH_INSTANCE_SHIFT];
+    glm::vec3 v0 = scene.mesh.getVertex(triangle, 0);
+    glm::vec3 normal = glm::cross(scene.mesh.getVertex(triangle, 1) - v0, scene.mesh.getVertex(triangle, 2) - v0);
+
+    // normals go through the inverse transpose, the transpose of worldToObject
+    return glm::normalize(glm::vec3(instance.worldToObject[0]) * normal.x
+        + glm::vec3(instance.worldToObject[1]) * normal.y + glm::vec3(instance.worldToObject[2]) * normal.z);
+}
@@ -0,0 +1,80 @@
+#ifndef CPUTRACER_HPP
+#define CPUTRACER_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "FrameData.hpp"
+#include "LightGrid.hpp"
+#include "MaterialTable.hpp"
+#include "Mesh.hpp"
+#include "Bvh.hpp"
+#include "WideBvh.hpp"
+#include "Tlas.hpp"
+#include "Sphere.hpp"
+#include "TileScheduler.hpp"
+
+/**
+ * CPU reference implementation of the raytracer.cs.glsl megakernel,
+ * tiles are rendered on a work-stealing TileScheduler and uploaded
+ * into the color image the GPU path would have written.
+ * @brief The CpuTracer class
+ */
+class CpuTracer final
+{
+public:
+    typedef std::unique_ptr<CpuTracer> Ptr;
+    static const unsigned int TILE_SIZE;
+public:
+    explicit CpuTracer(GLsizei width, GLsizei height);
+
+    void trace(const FrameData& frame, const SphereBlock& spheres, const TlasBlock& tlas,
+        const LightGrid& lightGrid, const MaterialTable& materials, const Mesh& mesh, const Bvh& blas,
+        const WideBvh& wideBlas, GLuint colorTexture);
+
+private:
+    struct Ray
+    {
+        glm::vec3 origin;
+        glm::vec3 direction;
+    };
+
+    // everything one frame reads, mirrors the buffers bound for raytracer.cs.glsl
+    struct Scene
+    {
+        const FrameData& frame;
+        const SphereBlock& spheres;
+        const TlasBlock& tlas;
+        const LightGrid& lightGrid;
+        const MaterialTable& materials;
+        const Mesh& mesh;
+        const Bvh& blas;
+        const WideBvh& wideBlas;
+    };
+
+    GLsizei mWidth;
+    GLsizei mHeight;
+    std::vector<glm::vec4> mPixels;
+    TileScheduler mScheduler;
+private:
+    CpuTracer(const CpuTracer& other);
+    CpuTracer& operator=(const CpuTracer& other);
+    glm::vec3 traceRay(const Scene& scene, Ray ray, unsigned int x, unsigned int y) const;
+    glm::vec3 shadePointLights(const Scene& scene,
+        const glm::vec3& intPoint, const glm::vec3& intNormal, const glm::vec3& viewDir,
+        const glm::vec3& diffuse, const glm::vec3& specular, float shininess) const;
+    float findObjectIntersection(const Scene& scene, const Ray& ray,
+        int& objectID, int& objArrayIndex, float farPlane) const;
+    bool isOccluded(const Scene& scene, const Ray& ray, float maxDist) const;
+    void intersectBlas(const Scene& scene, const Ray& objectRay, GLuint root, float& tClosest, int& triangle) const;
+    bool isBlasOccluded(const Scene& scene, const Ray& objectRay, GLuint root, float maxDist) const;
+    void intersectWideBlas(const Scene& scene, const Ray& objectRay, GLuint root, float& tClosest, int& triangle) const;
+    bool isWideBlasOccluded(const Scene& scene, const Ray& objectRay, GLuint root, float maxDist) const;
+    float intersectTriangle(const Scene& scene, const Ray& ray, GLuint triangle) const;
+    glm::vec3 getTriangleNormal(const Scene& scene, GLuint packedTriangle) const;
+};
+
+#endif // CPUTRACER_HPP
@@ -0,0 +1,123 @@
+#include "Denoiser.hpp"
+
+#include "GLUtils.hpp"
+
+// should match DENOISE_GROUP_SIZE in denoise.cs.glsl
+const GLuint Denoiser::GROUP_SIZE = 16;
+// steps 1, 2, 4 and 8, a 61 pixel wide footprint
+const GLuint Denoiser::ITERATIONS = 4;
+
+/**
+ * @brief Denoiser::Denoiser
+ * @param width
+ * @param height
+ */
+Denoiser::Denoiser(GLsizei width, GLsizei height)
+: mWidth(width)
+, mHeight(height)
+, mCurrent(0)
+{
+    compileStage(mTemporal, "DENOISE_TEMPORAL");
+    compileStage(mAtrous, "DENOISE_ATROUS");
+    mReset = mTemporal.getUniform("uReset");
+    mStep = mAtrous.getUniform("uStep");
+    mFeedback = mAtrous.getUniform("uFeedback");
+
+    for (unsigned int index = 0; index != 2; ++index)
+    {
+        mHistory[index] = GLUtils::CreateImageTexture(GL_RGBA32F, mWidth, mHeight);
+        mMoments[index] = GLUtils::CreateImageTexture(GL_RGBA32F, mWidth, mHeight);
+        mFiltered[index] = GLUtils::CreateImageTexture(GL_RGBA32F, mWidth, mHeight);
+    }
+}
+
+/**
+ * @brief Denoiser::~Denoiser
+ */
+Denoiser::~Denoiser()
+{
+    glDeleteTextures(2, mHistory);
+    glDeleteTextures(2, mMoments);
+    glDeleteTextures(2, mFiltered);
+}
+
+/**
+ * Expects the FrameBlock UBO of this frame to be bound, the image units
+ * are rebound here and have to be restored by the tracer.
+ * @brief Denoiser::denoise
+ * @param color - the traced frame, left untouched
+ * @param gBuffer - written by the trace of color
+ * @param prevGBuffer - the previous frame's
+ * @param reset - the history is stale, start over from this frame
+ * @return the filtered frame, valid until the next call
+ */
+GLuint Denoiser::denoise(GLuint color, GLuint gBuffer, GLuint prevGBuffer, bool reset)
+{
+    const unsigned int previous = 1 - mCurrent;
+
+    // temporal: frame, history and moments of the previous frame in, moments and the first filter input out
+    glBindImageTexture(0, color, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, mHistory[previous], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(2, gBuffer, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(3, prevGBuffer, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(4, mMoments[previous], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(5, mMoments[mCurrent], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(6, mFiltered[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    mTemporal.setUniform(mReset, static_cast<GLuint>(reset ? 1 : 0));
+    mTemporal.bind();
+    dispatch();
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // a-trous: mFiltered ping-pongs, the first iteration also writes the history
+    mAtrous.bind();
+    glBindImageTexture(3, mHistory[mCurrent], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    unsigned int in = 0;
+    for (GLuint iteration = 0; iteration != ITERATIONS; ++iteration)
+    {
+        glBindImageTexture(0, mFiltered[in], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(1, mFiltered[1 - in], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+        mAtrous.setUniform(mStep, static_cast<GLint>(1 << iteration));
+        mAtrous.setUniform(mFeedback, static_cast<GLuint>(iteration == 0 ? 1 : 0));
+        dispatch();
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        in = 1 - in;
+    }
+
+    mCurrent = previous;
+    return mFiltered[in];
+}
+
+/**
+ * @brief Denoiser::getShaders
+ * @return both stage programs, for the shader hot reload
+ */
+std::vector<Shader*> Denoiser::getShaders()
+{
+    return {&mTemporal, &mAtrous};
+}
+
+/**
+ * @brief Denoiser::compileStage
+ * @param shader
+ * @param stage - the #define selecting the pass in denoise.cs.glsl
+ */
+void Denoiser::compileStage(Shader& shader, const std::string& stage)
+{
+    shader.addDefine(stage);
+    shader.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/denoise.cs.glsl");
+    shader.linkProgram();
+}
+
+/**
+ * One invocation per pixel, the program must be bound.
+ * @brief Denoiser::dispatch
+ */
+void Denoiser::dispatch() const
+{
+    glDispatchCompute((static_cast<GLuint>(mWidth) + GROUP_SIZE - 1) / GROUP_SIZE,
+        (static_cast<GLuint>(mHeight) + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+}
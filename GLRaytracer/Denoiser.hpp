@@ -0,0 +1,55 @@
+#ifndef DENOISER_HPP
+#define DENOISER_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.hpp"
+
+/**
+ * Spatiotemporal variance-guided filter for the traced frame (Schied
+ * et al. 2017). A temporal pass reprojects the filtered history through
+ * the G-buffer and tracks the luminance variance, then a few a-trous
+ * wavelet iterations blur it while stopping at depth, normal, object
+ * and luminance edges. The first iteration feeds the next frame's
+ * history, so a one sample frame converges over a handful of frames
+ * without smearing across objects.
+ * @brief The Denoiser class
+ */
+class Denoiser final
+{
+public:
+    typedef std::unique_ptr<Denoiser> Ptr;
+    static const GLuint GROUP_SIZE;
+    static const GLuint ITERATIONS;
+public:
+    explicit Denoiser(GLsizei width, GLsizei height);
+    ~Denoiser();
+
+    GLuint denoise(GLuint color, GLuint gBuffer, GLuint prevGBuffer, bool reset);
+
+    std::vector<Shader*> getShaders();
+
+private:
+    GLsizei mWidth;
+    GLsizei mHeight;
+    Shader mTemporal;
+    Shader mAtrous;
+    Shader::Uniform mReset;
+    Shader::Uniform mStep;
+    Shader::Uniform mFeedback;
+    // ping-pong, index mCurrent is written this frame
+    GLuint mHistory[2];
+    GLuint mMoments[2];
+    GLuint mFiltered[2];
+    unsigned int mCurrent;
+private:
+    Denoiser(const Denoiser& other);
+    Denoiser& operator=(const Denoiser& other);
+    void compileStage(Shader& shader, const std::string& stage);
+    void dispatch() const;
+};
+
+#endif // DENOISER_HPP
@@ -0,0 +1,89 @@
+#ifndef FRAMEDATA_HPP
+#define FRAMEDATA_HPP
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "layout.glsl"
+#include "Sphere.hpp"
+#include "Bvh.hpp"
+
+#define TOTAL_SPHERES MAX_SPHERES
+#define TOTAL_LIGHTS MAX_LIGHTS
+// point lights live in LightGrid's SSBOs, not in FrameBlock
+#define TOTAL_POINT_LIGHTS 256
+#define TOTAL_INSTANCES MAX_INSTANCES
+
+// Bits of FrameData::settings.x, should match the RENDER_ defines in scene.glsl
+namespace RenderFlags
+{
+const unsigned int TEMPORAL = 1u << 0;
+const unsigned int CHECKERBOARD = 1u << 1;
+const unsigned int ADAPTIVE = 1u << 2;
+const unsigned int WAVEFRONT = 1u << 3;
+const unsigned int PERSISTENT = 1u << 4;
+// host side only, the frame is traced by CpuTracer
+const unsigned int CPU = 1u << 5;
+// sort secondary rays in the wavefront path
+const unsigned int RAY_SORT = 1u << 6;
+const unsigned int POINT_LIGHTS = 1u << 7;
+const unsigned int STOCHASTIC_LIGHTS = 1u << 8;
+// host side only, spheres go through the Lbvh built on the GPU instead of one instance each
+const unsigned int GPU_BVH = 1u << 9;
+// mesh BLAS traversal through the quantized four wide WideBvh
+const unsigned int WIDE_BVH = 1u << 10;
+// sphere shadows and occlusion from analytic cone - sphere overlap instead of shadow rays
+const unsigned int ANALYTIC_SHADOWS = 1u << 11;
+// host side only, the traced frame goes through the Denoiser before the blit
+const unsigned int DENOISE = 1u << 12;
+// fewer primary rays and bounces away from the focus, see shaders/fovea.glsl
+const unsigned int FOVEATED = 1u << 13;
+}
+
+// the structs are laid out once in shaders/layout.glsl
+typedef GpuLayout::Camera CameraData;
+typedef GpuLayout::Material MaterialData;
+typedef GpuLayout::Plane PlaneData;
+typedef GpuLayout::Light LightData;
+typedef GpuLayout::Instance InstanceData;
+
+// std140 mirror of the FrameBlock uniform block in frame.glsl
+struct FrameData
+{
+    CameraData camera;
+    PlaneData plane;
+    LightData lights[TOTAL_LIGHTS];
+    float time;
+    float padding[3];
+    glm::mat4 prevViewProj;
+    glm::vec4 prevEye;
+    // x = RenderFlags, y = frame index, z = temporal refresh period, w = frames accumulated
+    glm::uvec4 settings;
+    MaterialData meshMaterial;
+};
+
+// std430 SphereBuffer, written right after FrameData in each ring buffer slot,
+// geometry only, the materials are in MaterialTable
+struct SphereBlock
+{
+    Sphere spheres[TOTAL_SPHERES];
+};
+
+// std430 TlasBuffer, the top level tree rebuilt every frame after SphereBlock in the ring buffer slot
+struct TlasBlock
+{
+    BvhNodeData nodes[2 * TOTAL_INSTANCES];
+    InstanceData instances[TOTAL_INSTANCES];
+    // instance indices referenced by the leaves
+    GLuint instanceRefs[TOTAL_INSTANCES];
+};
+
+static_assert(offsetof(FrameData, plane) == 80 && offsetof(FrameData, lights) == 176
+    && offsetof(FrameData, time) == 496 && offsetof(FrameData, prevViewProj) == 512
+    && offsetof(FrameData, settings) == 592 && offsetof(FrameData, meshMaterial) == 608, "FrameData must match std140 FrameBlock");
+static_assert(sizeof(FrameData) == 672, "FrameData must match std140 FrameBlock");
+static_assert(sizeof(SphereBlock) == TOTAL_SPHERES * 16, "SphereBlock must match std430 SphereBuffer");
+static_assert(sizeof(TlasBlock) == TOTAL_INSTANCES * (2 * 32 + 64 + 4), "TlasBlock must match std430 TlasBuffer");
+
+#endif // FRAMEDATA_HPP
@@ -146,3 +146,43 @@ void GLUtils::GlDebugCallback(GLenum source, GLenum type, GLuint id,
     if (severity != GL_DEBUG_SEVERITY_LOW)
         printf(outStr.c_str());
 } // debugCallback()
+
+/**
+ * Immutable, nearest-filtered and zero-cleared texture for use with glBindImageTexture.
+ * @brief GLUtils::CreateImageTexture
+ * @param internalFormat
+ * @param width
+ * @param height
+ * @return
+ */
+GLuint GLUtils::CreateImageTexture(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+    glClearTexImage(tex, 0, GL_RGBA, GL_FLOAT, nullptr);
+    return tex;
+}
+
+/**
+ * @brief GLUtils::HasExtension
+ * @param name - for example "GL_NV_shader_thread_group"
+ * @return true if the current context advertises the extension
+ */
+bool GLUtils::HasExtension(const std::string& name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint index = 0; index != count; ++index)
+    {
+        const GLubyte* extension = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index));
+        if (extension && name == reinterpret_cast<const char*>(extension))
+            return true;
+    }
+    return false;
+}
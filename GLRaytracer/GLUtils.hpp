@@ -17,6 +17,8 @@ public:
     static bool CheckForOpenGLError(const std::string& file, int line);
     static void GlDebugCallback(GLenum source, GLenum type, GLuint id,
         GLenum severity, GLsizei length, const GLchar* msg, const void* param);
+    static GLuint CreateImageTexture(GLenum internalFormat, GLsizei width, GLsizei height);
+    static bool HasExtension(const std::string& name);
 };
 
 #endif // GLUTILS_HPP
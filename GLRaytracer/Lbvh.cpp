@@ -0,0 +1,186 @@
+#include "Lbvh.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "layout.glsl"
+
+// should match LBVH_GROUP_SIZE and RADIX_BITS in lbvh.cs.glsl
+const GLuint Lbvh::GROUP_SIZE = 256;
+const GLuint Lbvh::RADIX_BITS = 4;
+// 10 bits per axis
+const GLuint Lbvh::KEY_BITS = 30;
+
+namespace
+{
+// (boundsMin, leftFirst, boundsMax, count) as in BvhNodeData
+const GLsizeiptr NODE_SIZE = 8 * sizeof(GLuint);
+// order preserving min xyz, max xyz and padding in front of the visit counters
+const GLsizeiptr SCENE_BOUNDS_SIZE = 8 * sizeof(GLuint);
+
+// the split prefix grows along every path: at most KEY_BITS values for distinct codes, then
+// ceil(log2 count) more from the index tie-break of equal codes, and a chain has count - 1 levels
+constexpr GLuint getMaxDepth(GLuint count)
+{
+    GLuint indexBits = 0;
+    while ((1u << indexBits) < count)
+        ++indexBits;
+    return std::min(count - 1, Lbvh::KEY_BITS + indexBits);
+}
+
+// the tracers walk the tree with the binary BLAS stack, it holds depth + 1 nodes
+static_assert(getMaxDepth(MAX_SPHERES) + 1 <= BVH_STACK_SIZE, "the sphere LBVH must fit the traversal stacks");
+
+GLuint createBuffer(GLsizeiptr size)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+}
+
+/**
+ * @brief Lbvh::Lbvh
+ * @param capacity - most spheres a build may cover, sizes every buffer
+ */
+Lbvh::Lbvh(GLuint capacity)
+: mCapacity(std::max(capacity, 1u))
+, mNodes(0)
+, mRefs(0)
+, mScratch(0)
+, mLinks(0)
+, mDigitCounts(0)
+{
+    compileStage(mSceneBounds, "LBVH_SCENE_BOUNDS");
+    compileStage(mMorton, "LBVH_MORTON");
+    compileStage(mSortHistogram, "LBVH_SORT_HISTOGRAM");
+    compileStage(mSortScan, "LBVH_SORT_SCAN");
+    compileStage(mSortScatter, "LBVH_SORT_SCATTER");
+    compileStage(mHierarchy, "LBVH_HIERARCHY");
+    compileStage(mBounds, "LBVH_BOUNDS");
+
+    // n leaves and n - 1 internal nodes
+    const GLsizeiptr capacity64 = static_cast<GLsizeiptr>(mCapacity);
+    const GLsizeiptr groups = (capacity64 + GROUP_SIZE - 1) / GROUP_SIZE;
+    mNodes = createBuffer(NODE_SIZE * (2 * capacity64 - 1));
+    mRefs = createBuffer(sizeof(GLuint) * capacity64);
+    mPairs[0] = createBuffer(2 * sizeof(GLuint) * capacity64);
+    mPairs[1] = createBuffer(2 * sizeof(GLuint) * capacity64);
+    mScratch = createBuffer(SCENE_BOUNDS_SIZE + sizeof(GLuint) * capacity64);
+    mLinks = createBuffer(2 * sizeof(GLuint) * (2 * capacity64 - 1));
+    mDigitCounts = createBuffer(sizeof(GLuint) * (1 << RADIX_BITS) * groups);
+
+    if (getMaxDepth(mCapacity) + 1 > BVH_STACK_SIZE)
+        printf("LBVH: %u spheres may build a tree deeper than BVH_STACK_SIZE\n", mCapacity);
+}
+
+/**
+ * @brief Lbvh::~Lbvh
+ */
+Lbvh::~Lbvh()
+{
+    glDeleteBuffers(1, &mNodes);
+    glDeleteBuffers(1, &mRefs);
+    glDeleteBuffers(2, mPairs);
+    glDeleteBuffers(1, &mScratch);
+    glDeleteBuffers(1, &mLinks);
+    glDeleteBuffers(1, &mDigitCounts);
+}
+
+/**
+ * Expects this frame's SphereBuffer to be bound at 1. The tree is left
+ * bound at SphereTreeNodes (19) and SphereTreeRefs (20) for the tracers.
+ * @brief Lbvh::build
+ * @param count - spheres to cover, clamped to the capacity
+ */
+void Lbvh::build(GLuint count)
+{
+    count = std::min(count, mCapacity);
+    if (count == 0)
+        return;
+
+    const GLuint resetBounds[8] = {0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0, 0, 0, 0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mScratch);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(resetBounds), resetBounds);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODES, mNodes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, REFS, mRefs);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCRATCH, mScratch);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LINKS, mLinks);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DIGIT_COUNTS, mDigitCounts);
+
+    dispatch(mSceneBounds, count, count);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PAIRS_OUT, mPairs[0]);
+    dispatch(mMorton, count, count);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // least significant digit first, every pass ping-pongs the pairs
+    unsigned int in = 0;
+    for (GLuint shift = 0; shift < KEY_BITS; shift += RADIX_BITS)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PAIRS_IN, mPairs[in]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PAIRS_OUT, mPairs[1 - in]);
+
+        mSortHistogram.setUniform(mShift, shift);
+        dispatch(mSortHistogram, count, count);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        dispatch(mSortScan, count, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        mSortScatter.setUniform(mShift, shift);
+        dispatch(mSortScatter, count, count);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        in = 1 - in;
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PAIRS_IN, mPairs[in]);
+    dispatch(mHierarchy, count, std::max(count - 1, 1u));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    dispatch(mBounds, count, count);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/**
+ * @brief Lbvh::getShaders
+ * @return every stage program, for the shader hot reload
+ */
+std::vector<Shader*> Lbvh::getShaders()
+{
+    return {&mSceneBounds, &mMorton, &mSortHistogram, &mSortScan, &mSortScatter, &mHierarchy, &mBounds};
+}
+
+/**
+ * @brief Lbvh::compileStage
+ * @param shader
+ * @param stage - the #define selecting the kernel in lbvh.cs.glsl
+ */
+void Lbvh::compileStage(Shader& shader, const std::string& stage)
+{
+    shader.addDefine(stage);
+    shader.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/lbvh.cs.glsl");
+    shader.linkProgram();
+
+    mCount = shader.getUniform("uCount");
+    mShift = shader.getUniform("uShift");
+}
+
+/**
+ * @brief Lbvh::dispatch
+ * @param shader
+ * @param count - spheres in this build
+ * @param invocations - rounded up to whole GROUP_SIZE work groups
+ */
+void Lbvh::dispatch(Shader& shader, GLuint count, GLuint invocations) const
+{
+    shader.setUniform(mCount, count);
+    shader.bind();
+    glDispatchCompute((invocations + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+}
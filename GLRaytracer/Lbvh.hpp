@@ -0,0 +1,73 @@
+#ifndef LBVH_HPP
+#define LBVH_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.hpp"
+
+/**
+ * Linear BVH over the spheres, built on the GPU from the SphereBuffer
+ * every frame (Karras, "Maximizing Parallelism in the Construction of
+ * BVHs, Octrees, and k-d Trees"). Morton codes of the sphere centers are
+ * radix sorted, each internal node is emitted independently from the
+ * sorted codes and the bounds are fitted bottom-up, the last child to
+ * reach a node through an atomic counter fits it. Nothing is read back,
+ * the tree stays on the GPU in the Bvh node layout with one sphere per leaf.
+ * @brief The Lbvh class
+ */
+class Lbvh final
+{
+public:
+    typedef std::unique_ptr<Lbvh> Ptr;
+    static const GLuint GROUP_SIZE;
+    static const GLuint RADIX_BITS;
+    static const GLuint KEY_BITS;
+public:
+    explicit Lbvh(GLuint capacity);
+    ~Lbvh();
+
+    void build(GLuint count);
+
+    std::vector<Shader*> getShaders();
+
+private:
+    // buffer bindings in lbvh.cs.glsl, NODES and REFS are read by the tracers
+    enum Binding : GLuint
+    {
+        NODES = 19,
+        REFS = 20,
+        PAIRS_IN = 21,
+        PAIRS_OUT = 22,
+        SCRATCH = 23,
+        LINKS = 24,
+        DIGIT_COUNTS = 25
+    };
+
+    GLuint mCapacity;
+    Shader mSceneBounds;
+    Shader mMorton;
+    Shader mSortHistogram;
+    Shader mSortScan;
+    Shader mSortScatter;
+    Shader mHierarchy;
+    Shader mBounds;
+    // resolved in the same order in every stage, so one handle fits all of them
+    Shader::Uniform mCount;
+    Shader::Uniform mShift;
+    GLuint mNodes;
+    GLuint mRefs;
+    GLuint mPairs[2];
+    GLuint mScratch;
+    GLuint mLinks;
+    GLuint mDigitCounts;
+private:
+    Lbvh(const Lbvh& other);
+    Lbvh& operator=(const Lbvh& other);
+    void compileStage(Shader& shader, const std::string& stage);
+    void dispatch(Shader& shader, GLuint count, GLuint invocations) const;
+};
+
+#endif // LBVH_HPP
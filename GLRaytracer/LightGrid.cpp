@@ -0,0 +1,174 @@
+#include "LightGrid.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// x and z cover the sphere ring, the lights hang in a thin layer above the plane
+const glm::uvec3 LightGrid::GRID_DIMS = glm::uvec3(16, 4, 16);
+
+namespace
+{
+// should match the bindings in scene.glsl
+const GLuint POINT_LIGHT_BINDING = 11;
+const GLuint LIGHT_GRID_BINDING = 12;
+const GLuint LIGHT_INDEX_BINDING = 13;
+}
+
+/**
+ * @brief LightGrid::LightGrid
+ * @param lights
+ */
+LightGrid::LightGrid(const std::vector<PointLightData>& lights)
+: mLights(lights)
+, mHeader()
+, mBuffers{0, 0, 0}
+{
+    build();
+    upload();
+}
+
+/**
+ * @brief LightGrid::~LightGrid
+ */
+LightGrid::~LightGrid()
+{
+    glDeleteBuffers(3, mBuffers);
+}
+
+/**
+ * @brief LightGrid::bind
+ */
+void LightGrid::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_BINDING, mBuffers[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_GRID_BINDING, mBuffers[1]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, mBuffers[2]);
+}
+
+/**
+ * @brief LightGrid::getCell
+ * @param point
+ * @param cell - (first index into getLightIndices, light count)
+ * @return false if point lies outside of every light's influence
+ */
+bool LightGrid::getCell(const glm::vec3& point, glm::uvec2& cell) const
+{
+    glm::vec3 local = (point - glm::vec3(mHeader.gridMin)) / glm::vec3(mHeader.cellSize);
+    if (local.x < 0.0f || local.y < 0.0f || local.z < 0.0f)
+        return false;
+
+    glm::uvec3 coords = glm::uvec3(local);
+    if (coords.x >= GRID_DIMS.x || coords.y >= GRID_DIMS.y || coords.z >= GRID_DIMS.z)
+        return false;
+
+    cell = mCells.at((coords.z * GRID_DIMS.y + coords.y) * GRID_DIMS.x + coords.x);
+    return true;
+}
+
+/**
+ * @brief LightGrid::getLights
+ * @return
+ */
+const std::vector<PointLightData>& LightGrid::getLights() const
+{
+    return mLights;
+}
+
+/**
+ * @brief LightGrid::getLightIndices
+ * @return
+ */
+const std::vector<GLuint>& LightGrid::getLightIndices() const
+{
+    return mLightIndices;
+}
+
+/**
+ * Bounds are fitted to the influence spheres, every light is added to the
+ * cells its sphere overlaps (sphere-box test, not just the bounding box).
+ * @brief LightGrid::build
+ */
+void LightGrid::build()
+{
+    glm::vec3 gridMin(0.0f), gridMax(0.0f);
+    if (!mLights.empty())
+    {
+        gridMin = glm::vec3(mLights.front().position) - glm::vec3(mLights.front().position.w);
+        gridMax = glm::vec3(mLights.front().position) + glm::vec3(mLights.front().position.w);
+    }
+    for (const auto& light : mLights)
+    {
+        gridMin = glm::min(gridMin, glm::vec3(light.position) - glm::vec3(light.position.w));
+        gridMax = glm::max(gridMax, glm::vec3(light.position) + glm::vec3(light.position.w));
+    }
+
+    const glm::vec3 cellSize = glm::max((gridMax - gridMin) / glm::vec3(GRID_DIMS), glm::vec3(0.001f));
+    mHeader.gridMin = glm::vec4(gridMin, 0.0f);
+    mHeader.cellSize = glm::vec4(cellSize, 0.0f);
+    mHeader.dims = glm::uvec4(GRID_DIMS, 0u);
+
+    std::vector<std::vector<GLuint>> cellLights(GRID_DIMS.x * GRID_DIMS.y * GRID_DIMS.z);
+    for (GLuint index = 0; index != mLights.size(); ++index)
+    {
+        const glm::vec3 center = glm::vec3(mLights.at(index).position);
+        const float radius = mLights.at(index).position.w;
+
+        glm::uvec3 first = glm::uvec3(glm::max((center - glm::vec3(radius) - gridMin) / cellSize, glm::vec3(0.0f)));
+        glm::uvec3 last = glm::min(glm::uvec3((center + glm::vec3(radius) - gridMin) / cellSize), GRID_DIMS - glm::uvec3(1));
+
+        for (GLuint z = first.z; z <= last.z; ++z)
+        {
+            for (GLuint y = first.y; y <= last.y; ++y)
+            {
+                for (GLuint x = first.x; x <= last.x; ++x)
+                {
+                    glm::vec3 boxMin = gridMin + glm::vec3(x, y, z) * cellSize;
+                    glm::vec3 closest = glm::clamp(center, boxMin, boxMin + cellSize);
+                    glm::vec3 diff = closest - center;
+                    if (glm::dot(diff, diff) <= radius * radius)
+                        cellLights.at((z * GRID_DIMS.y + y) * GRID_DIMS.x + x).push_back(index);
+                }
+            }
+        }
+    }
+
+    mCells.clear();
+    mLightIndices.clear();
+    for (const auto& lights : cellLights)
+    {
+        mCells.emplace_back(static_cast<GLuint>(mLightIndices.size()), static_cast<GLuint>(lights.size()));
+        mLightIndices.insert(mLightIndices.end(), lights.begin(), lights.end());
+    }
+}
+
+/**
+ * @brief LightGrid::upload
+ */
+void LightGrid::upload()
+{
+    std::vector<char> gridData(sizeof(GridHeader) + mCells.size() * sizeof(glm::uvec2));
+    std::memcpy(gridData.data(), &mHeader, sizeof(GridHeader));
+    std::memcpy(gridData.data() + sizeof(GridHeader), mCells.data(), mCells.size() * sizeof(glm::uvec2));
+
+    // empty storage is not allowed, keep one element around
+    const PointLightData noLight{};
+    const GLuint noIndex = 0;
+
+    glGenBuffers(3, mBuffers);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[0]);
+    if (mLights.empty())
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(PointLightData), &noLight, 0);
+    else
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, mLights.size() * sizeof(PointLightData), mLights.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[1]);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(gridData.size()), gridData.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[2]);
+    if (mLightIndices.empty())
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &noIndex, 0);
+    else
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, mLightIndices.size() * sizeof(GLuint), mLightIndices.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,58 @@
+#ifndef LIGHTGRID_HPP
+#define LIGHTGRID_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "layout.glsl"
+
+// xyz = position, w = influence radius, the light contributes nothing beyond it
+typedef GpuLayout::PointLight PointLightData;
+
+/**
+ * Uniform grid over the influence spheres of the point lights. Each cell
+ * lists the lights that can reach it, so shading a hit only walks the
+ * lights of its cell instead of all of them. The lights are static, the
+ * grid is built once on the CPU and kept there for CpuTracer as well.
+ * @brief The LightGrid class
+ */
+class LightGrid final
+{
+public:
+    typedef std::unique_ptr<LightGrid> Ptr;
+    static const glm::uvec3 GRID_DIMS;
+public:
+    explicit LightGrid(const std::vector<PointLightData>& lights);
+    ~LightGrid();
+
+    void bind() const;
+
+    bool getCell(const glm::vec3& point, glm::uvec2& cell) const;
+    const std::vector<PointLightData>& getLights() const;
+    const std::vector<GLuint>& getLightIndices() const;
+
+private:
+    // std430 header of the LightGrid buffer, followed by one (offset, count) pair per cell
+    struct GridHeader
+    {
+        glm::vec4 gridMin;
+        glm::vec4 cellSize;
+        glm::uvec4 dims;
+    };
+
+    std::vector<PointLightData> mLights;
+    std::vector<glm::uvec2> mCells;
+    std::vector<GLuint> mLightIndices;
+    GridHeader mHeader;
+    GLuint mBuffers[3];
+private:
+    LightGrid(const LightGrid& other);
+    LightGrid& operator=(const LightGrid& other);
+    void build();
+    void upload();
+};
+
+#endif // LIGHTGRID_HPP
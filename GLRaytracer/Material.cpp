@@ -10,6 +10,7 @@ Material::Material()
 , mShininess(0)
 , mReflectivity(0)
 , mRefractivity(0)
+, mTextureLayer(-1)
 {
 
 }
@@ -29,6 +30,7 @@ Material::Material(const glm::vec3& ambient, const glm::vec3& diffuse, const glm
 , mShininess(shininess)
 , mReflectivity(0)
 , mRefractivity(0)
+, mTextureLayer(-1)
 {
 
 }
@@ -50,6 +52,7 @@ Material::Material(const glm::vec3& ambient, const glm::vec3& diffuse, const glm
 , mShininess(shininess)
 , mReflectivity(reflectValue)
 , mRefractivity(refractValue)
+, mTextureLayer(-1)
 {
 
 }
@@ -161,3 +164,21 @@ void Material::setRefractivity(float refractivity)
 {
     mRefractivity = refractivity;
 }
+
+/**
+ * @brief Material::getTextureLayer
+ * @return
+ */
+int Material::getTextureLayer() const
+{
+    return mTextureLayer;
+}
+
+/**
+ * @brief Material::setTextureLayer
+ * @param textureLayer - layer in the TextureArray, -1 for untextured
+ */
+void Material::setTextureLayer(int textureLayer)
+{
+    mTextureLayer = textureLayer;
+}
@@ -33,6 +33,9 @@ public:
 
     float getRefractivity() const;
     void setRefractivity(float refractivity);
+
+    int getTextureLayer() const;
+    void setTextureLayer(int textureLayer);
 private:
     glm::vec3 mAmbient;
     glm::vec3 mDiffuse;
@@ -40,6 +43,8 @@ private:
     float mShininess;
     float mReflectivity;
     float mRefractivity;
+    // layer in the TextureArray, -1 for untextured
+    int mTextureLayer;
 };
 
 #endif // MATERIAL_HPP
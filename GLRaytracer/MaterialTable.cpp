@@ -0,0 +1,122 @@
+#include "MaterialTable.hpp"
+
+#include <cstring>
+
+namespace
+{
+// should match the binding in scene.glsl
+const GLuint MATERIAL_BINDING = 28;
+
+static_assert((TOTAL_SPHERES * sizeof(GLuint)) % 16 == 0, "the materials must start 16 byte aligned in std430 MaterialBuffer");
+
+bool isSameMaterial(const MaterialData& a, const MaterialData& b)
+{
+    return a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular
+        && a.shininess == b.shininess && a.reflective == b.reflective && a.textureLayer == b.textureLayer;
+}
+}
+
+/**
+ * @brief MaterialTable::MaterialTable
+ * @param sphereMaterials - one per sphere, at most TOTAL_SPHERES
+ */
+MaterialTable::MaterialTable(const std::vector<Material>& sphereMaterials)
+: mSphereMaterials(TOTAL_SPHERES, 0)
+, mBuffer(0)
+{
+    for (unsigned int index = 0; index != sphereMaterials.size() && index != TOTAL_SPHERES; ++index)
+        mSphereMaterials.at(index) = addMaterial(ToMaterialData(sphereMaterials.at(index)));
+
+    // empty storage is not allowed, keep one material around
+    if (mMaterials.empty())
+        mMaterials.push_back(ToMaterialData(Material()));
+
+    upload();
+}
+
+/**
+ * @brief MaterialTable::~MaterialTable
+ */
+MaterialTable::~MaterialTable()
+{
+    glDeleteBuffers(1, &mBuffer);
+}
+
+/**
+ * @brief MaterialTable::bind
+ */
+void MaterialTable::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, mBuffer);
+}
+
+/**
+ * @brief MaterialTable::getSphereMaterial
+ * @param sphere - index into SphereBlock::spheres
+ * @return
+ */
+const MaterialData& MaterialTable::getSphereMaterial(unsigned int sphere) const
+{
+    return mMaterials.at(mSphereMaterials.at(sphere));
+}
+
+/**
+ * @brief MaterialTable::getMaterials
+ * @return
+ */
+const std::vector<MaterialData>& MaterialTable::getMaterials() const
+{
+    return mMaterials;
+}
+
+/**
+ * @brief MaterialTable::ToMaterialData
+ * @param material
+ * @return the std430 / std140 layout shared by the table and FrameBlock
+ */
+MaterialData MaterialTable::ToMaterialData(const Material& material)
+{
+    MaterialData data = {};
+    data.ambient = material.getAmbient();
+    data.diffuse = material.getDiffuse();
+    data.specular = material.getSpecular();
+    data.shininess = material.getShininess();
+    data.reflective = material.getReflectivity();
+    data.textureLayer = static_cast<float>(material.getTextureLayer());
+    return data;
+}
+
+/**
+ * Linear search, the table is expected to stay small.
+ * @brief MaterialTable::addMaterial
+ * @param material
+ * @return index of the equal material already in the table, or of the appended one
+ */
+GLuint MaterialTable::addMaterial(const MaterialData& material)
+{
+    for (GLuint index = 0; index != mMaterials.size(); ++index)
+    {
+        if (isSameMaterial(mMaterials.at(index), material))
+            return index;
+    }
+
+    mMaterials.push_back(material);
+    return static_cast<GLuint>(mMaterials.size() - 1);
+}
+
+/**
+ * std430 MaterialBuffer: the per sphere indices, then the materials
+ * @brief MaterialTable::upload
+ */
+void MaterialTable::upload()
+{
+    const std::size_t indexSize = mSphereMaterials.size() * sizeof(GLuint);
+    std::vector<char> data(indexSize + mMaterials.size() * sizeof(MaterialData));
+    std::memcpy(data.data(), mSphereMaterials.data(), indexSize);
+    std::memcpy(data.data() + indexSize, mMaterials.data(), mMaterials.size() * sizeof(MaterialData));
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(data.size()), data.data(), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
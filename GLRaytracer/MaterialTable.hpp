@@ -0,0 +1,46 @@
+#ifndef MATERIALTABLE_HPP
+#define MATERIALTABLE_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "FrameData.hpp"
+#include "Material.hpp"
+
+/**
+ * Deduplicated sphere materials and the material index of every sphere,
+ * kept out of the per-frame SphereBuffer so traversal only streams the
+ * 16 byte geometry. The materials are static, the table is uploaded once
+ * and kept on the CPU for CpuTracer as well.
+ * @brief The MaterialTable class
+ */
+class MaterialTable final
+{
+public:
+    typedef std::unique_ptr<MaterialTable> Ptr;
+public:
+    explicit MaterialTable(const std::vector<Material>& sphereMaterials);
+    ~MaterialTable();
+
+    void bind() const;
+
+    const MaterialData& getSphereMaterial(unsigned int sphere) const;
+    const std::vector<MaterialData>& getMaterials() const;
+
+    static MaterialData ToMaterialData(const Material& material);
+
+private:
+    std::vector<MaterialData> mMaterials;
+    // TOTAL_SPHERES entries, spheres without a material use entry 0
+    std::vector<GLuint> mSphereMaterials;
+    GLuint mBuffer;
+private:
+    MaterialTable(const MaterialTable& other);
+    MaterialTable& operator=(const MaterialTable& other);
+    GLuint addMaterial(const MaterialData& material);
+    void upload();
+};
+
+#endif // MATERIALTABLE_HPP
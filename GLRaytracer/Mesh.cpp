@@ -0,0 +1,91 @@
+#include "Mesh.hpp"
+
+namespace
+{
+// should match the bindings in scene.glsl
+const GLuint VERTEX_BINDING = 14;
+const GLuint INDEX_BINDING = 15;
+}
+
+/**
+ * @brief Mesh::Mesh
+ * @param vertices
+ * @param indices - three per triangle
+ */
+Mesh::Mesh(const std::vector<glm::vec4>& vertices, const std::vector<GLuint>& indices)
+: mVertices(vertices)
+, mIndices(indices)
+, mBuffers{0, 0}
+{
+    // empty storage is not allowed, a mesh without triangles still binds one element
+    const glm::vec4 noVertex(0.0f);
+    const GLuint noIndex = 0;
+
+    glGenBuffers(2, mBuffers);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[0]);
+    if (mVertices.empty())
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4), &noVertex, 0);
+    else
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, mVertices.size() * sizeof(glm::vec4), mVertices.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[1]);
+    if (mIndices.empty())
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &noIndex, 0);
+    else
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, mIndices.size() * sizeof(GLuint), mIndices.data(), 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/**
+ * @brief Mesh::~Mesh
+ */
+Mesh::~Mesh()
+{
+    glDeleteBuffers(2, mBuffers);
+}
+
+/**
+ * @brief Mesh::bind
+ */
+void Mesh::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_BINDING, mBuffers[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, mBuffers[1]);
+}
+
+/**
+ * @brief Mesh::getTriangleCount
+ * @return
+ */
+GLuint Mesh::getTriangleCount() const
+{
+    return static_cast<GLuint>(mIndices.size() / 3);
+}
+
+/**
+ * @brief Mesh::getVertex
+ * @param triangle
+ * @param corner - 0, 1 or 2
+ * @return
+ */
+glm::vec3 Mesh::getVertex(GLuint triangle, unsigned int corner) const
+{
+    return glm::vec3(mVertices.at(mIndices.at(triangle * 3 + corner)));
+}
+
+/**
+ * @brief Mesh::getTriangleBounds
+ * @param triangle
+ * @param boundsMin
+ * @param boundsMax
+ */
+void Mesh::getTriangleBounds(GLuint triangle, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    boundsMin = boundsMax = getVertex(triangle, 0);
+    for (unsigned int corner = 1; corner != 3; ++corner)
+    {
+        boundsMin = glm::min(boundsMin, getVertex(triangle, corner));
+        boundsMax = glm::max(boundsMax, getVertex(triangle, corner));
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Material.hpp"
+
+/**
+ * Indexed triangle mesh in object space, uploaded once into the MeshVertices /
+ * MeshIndices SSBOs of scene.glsl and placed by Tlas instances.
+ * One material for the whole mesh.
+ * @brief The Mesh class
+ */
+class Mesh final
+{
+public:
+    typedef std::unique_ptr<Mesh> Ptr;
+public:
+    Material material;
+public:
+    explicit Mesh(const std::vector<glm::vec4>& vertices, const std::vector<GLuint>& indices);
+    ~Mesh();
+
+    void bind() const;
+
+    GLuint getTriangleCount() const;
+    glm::vec3 getVertex(GLuint triangle, unsigned int corner) const;
+    void getTriangleBounds(GLuint triangle, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+private:
+    std::vector<glm::vec4> mVertices;
+    std::vector<GLuint> mIndices;
+    GLuint mBuffers[2];
+private:
+    Mesh(const Mesh& other);
+    Mesh& operator=(const Mesh& other);
+};
+
+#endif // MESH_HPP
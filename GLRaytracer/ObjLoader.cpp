@@ -0,0 +1,266 @@
+#include "ObjLoader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// below this a chunk is not worth a thread
+const std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+/**
+ * Read-only view of a whole file, mmap where available, otherwise read into memory.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename)
+    : mData(nullptr)
+    , mSize(0)
+    , mMapped(false)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void* data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+                mData = static_cast<const char*>(data);
+                mSize = static_cast<std::size_t>(info.st_size);
+                mMapped = true;
+            }
+        }
+        close(fd);
+#endif
+        if (mMapped)
+            return;
+
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);
+        if (!in)
+            return;
+        mBuffer.resize(static_cast<std::size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(mBuffer.data(), static_cast<std::streamsize>(mBuffer.size()));
+        mData = mBuffer.data();
+        mSize = mBuffer.size();
+    }
+
+    ~MappedFile()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mMapped)
+            munmap(const_cast<char*>(mData), mSize);
+#endif
+    }
+
+    const char* data() const { return mData; }
+    std::size_t size() const { return mSize; }
+
+private:
+    const char* mData;
+    std::size_t mSize;
+    bool mMapped;
+    std::vector<char> mBuffer;
+private:
+    MappedFile(const MappedFile& other);
+    MappedFile& operator=(const MappedFile& other);
+};
+
+struct ChunkResult
+{
+    GLuint vertexBase = 0;
+    GLuint vertexCount = 0;
+    std::vector<glm::vec4> vertices;
+    std::vector<GLuint> indices;
+    bool valid = true;
+};
+
+const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    return p;
+}
+
+const char* findLineEnd(const char* p, const char* end)
+{
+    const void* newline = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+    return newline ? static_cast<const char*>(newline) : end;
+}
+
+bool isRecord(const char* p, const char* lineEnd, char type)
+{
+    return (lineEnd - p) >= 2 && p[0] == type && (p[1] == ' ' || p[1] == '\t');
+}
+
+// first pass, the vertex count of every preceding chunk is needed to resolve relative indices
+void countVertices(const char* p, const char* end, ChunkResult& result)
+{
+    while (p < end)
+    {
+        const char* lineEnd = findLineEnd(p, end);
+        if (isRecord(p, lineEnd, 'v'))
+            result.vertexCount++;
+        p = lineEnd + 1;
+    }
+}
+
+void parseChunk(const char* p, const char* end, ChunkResult& result)
+{
+    result.vertices.reserve(result.vertexCount);
+    std::vector<GLuint> polygon;
+
+    while (p < end)
+    {
+        const char* lineEnd = findLineEnd(p, end);
+
+        if (isRecord(p, lineEnd, 'v'))
+        {
+            glm::vec4 vertex(0.0f, 0.0f, 0.0f, 1.0f);
+            const char* token = p + 2;
+            for (int axis = 0; axis != 3; ++axis)
+            {
+                token = skipSpaces(token, lineEnd);
+                auto parsed = std::from_chars(token, lineEnd, vertex[axis]);
+                if (parsed.ec != std::errc())
+                    result.valid = false;
+                token = parsed.ptr;
+            }
+            result.vertices.push_back(vertex);
+        }
+        else if (isRecord(p, lineEnd, 'f'))
+        {
+            polygon.clear();
+            const char* token = skipSpaces(p + 2, lineEnd);
+            while (token < lineEnd && *token != '\r')
+            {
+                long index = 0;
+                auto parsed = std::from_chars(token, lineEnd, index);
+                if (parsed.ec != std::errc() || index == 0)
+                {
+                    result.valid = false;
+                    break;
+                }
+
+                // 1-based, negative values count back from the latest vertex
+                const long current = static_cast<long>(result.vertexBase + result.vertices.size());
+                polygon.push_back(static_cast<GLuint>(index > 0 ? index - 1 : current + index));
+
+                // skip "/texcoord/normal"
+                token = parsed.ptr;
+                while (token < lineEnd && *token != ' ' && *token != '\t' && *token != '\r')
+                    ++token;
+                token = skipSpaces(token, lineEnd);
+            }
+
+            for (std::size_t corner = 2; corner < polygon.size(); ++corner)
+            {
+                result.indices.push_back(polygon.at(0));
+                result.indices.push_back(polygon.at(corner - 1));
+                result.indices.push_back(polygon.at(corner));
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+template <typename Function>
+void forEachChunk(std::vector<ChunkResult>& results, Function function)
+{
+    std::vector<std::thread> threads;
+    for (std::size_t index = 1; index < results.size(); ++index)
+        threads.emplace_back(function, index);
+    function(0);
+    for (auto& thread : threads)
+        thread.join();
+}
+} // namespace
+
+/**
+ * @brief ObjLoader::Load
+ * @param filename
+ * @param vertices - xyz position, w = 1
+ * @param indices - three per triangle
+ * @return false if the file can't be read or has malformed / out of range records
+ */
+bool ObjLoader::Load(const std::string& filename, std::vector<glm::vec4>& vertices, std::vector<GLuint>& indices)
+{
+    MappedFile file(filename);
+    if (file.data() == nullptr)
+    {
+        printf("ObjLoader: could not open %s\n", filename.c_str());
+        return false;
+    }
+
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    std::size_t chunkCount = std::max<std::size_t>(1, std::min<std::size_t>(
+        std::max(std::thread::hardware_concurrency(), 1u), file.size() / MIN_CHUNK_SIZE));
+
+    // chunk boundaries moved forward to the next line start
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds.front() = begin;
+    for (std::size_t index = 1; index < chunkCount; ++index)
+    {
+        const char* split = std::max(begin + (file.size() * index) / chunkCount, bounds.at(index - 1));
+        const char* lineEnd = findLineEnd(split, end);
+        bounds.at(index) = (lineEnd == end) ? end : lineEnd + 1;
+    }
+
+    std::vector<ChunkResult> results(chunkCount);
+    forEachChunk(results, [&](std::size_t index) {
+        countVertices(bounds.at(index), bounds.at(index + 1), results.at(index));
+    });
+
+    GLuint vertexCount = 0;
+    for (auto& result : results)
+    {
+        result.vertexBase = vertexCount;
+        vertexCount += result.vertexCount;
+    }
+
+    forEachChunk(results, [&](std::size_t index) {
+        parseChunk(bounds.at(index), bounds.at(index + 1), results.at(index));
+    });
+
+    vertices.clear();
+    indices.clear();
+    vertices.reserve(vertexCount);
+    for (const auto& result : results)
+    {
+        if (!result.valid)
+        {
+            printf("ObjLoader: malformed record in %s\n", filename.c_str());
+            return false;
+        }
+        vertices.insert(vertices.end(), result.vertices.begin(), result.vertices.end());
+        indices.insert(indices.end(), result.indices.begin(), result.indices.end());
+    }
+
+    if (std::any_of(indices.begin(), indices.end(), [vertexCount](GLuint index) { return index >= vertexCount; }))
+    {
+        printf("ObjLoader: face index out of range in %s\n", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef OBJLOADER_HPP
+#define OBJLOADER_HPP
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/**
+ * Wavefront OBJ loader for triangle geometry (v and f records, polygons are
+ * fan triangulated, normals / texture coordinates / groups are skipped).
+ * The file is memory mapped and parsed by several threads, each one working
+ * on a chunk of whole lines.
+ * This class is not intended to be initialized.
+ * @brief The ObjLoader class
+ */
+class ObjLoader
+{
+public:
+    static bool Load(const std::string& filename, std::vector<glm::vec4>& vertices, std::vector<GLuint>& indices);
+};
+
+#endif // OBJLOADER_HPP
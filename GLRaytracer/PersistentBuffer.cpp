@@ -0,0 +1,165 @@
+#include "PersistentBuffer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * @brief PersistentBuffer::PersistentBuffer
+ * @param slotSize - bytes per frame, rounded up to the UBO/SSBO offset alignment
+ * @param slotCount = DEFAULT_SLOT_COUNT
+ */
+PersistentBuffer::PersistentBuffer(GLsizeiptr slotSize, unsigned int slotCount)
+: mBuffer(0)
+, mSlotSize(static_cast<GLsizeiptr>(alignOffset(static_cast<GLintptr>(slotSize))))
+, mSlotCount(slotCount)
+, mCurrentSlot(0)
+, mMappedPtr(nullptr)
+, mFences(slotCount, nullptr)
+{
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr totalSize = mSlotSize * static_cast<GLsizeiptr>(mSlotCount);
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+    mMappedPtr = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (mMappedPtr == nullptr)
+    {
+        printf("PersistentBuffer: failed to map %ld bytes\n", static_cast<long>(totalSize));
+    }
+}
+
+/**
+ * @brief PersistentBuffer::~PersistentBuffer
+ */
+PersistentBuffer::~PersistentBuffer()
+{
+    for (GLsync& sync : mFences)
+    {
+        if (sync)
+            glDeleteSync(sync);
+        sync = nullptr;
+    }
+
+    if (mBuffer)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &mBuffer);
+    }
+}
+
+/**
+ * Blocks only if the GPU has not yet consumed the slot written
+ * slotCount frames ago.
+ * @brief PersistentBuffer::map
+ * @return write pointer to the current slot
+ */
+void* PersistentBuffer::map()
+{
+    waitForSlot(mCurrentSlot);
+    return mMappedPtr + mSlotSize * static_cast<GLsizeiptr>(mCurrentSlot);
+}
+
+/**
+ * @brief PersistentBuffer::bindRange
+ * @param target - GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+ * @param binding
+ * @param offset - offset inside the current slot, must be aligned with alignOffset
+ * @param size
+ */
+void PersistentBuffer::bindRange(GLenum target, GLuint binding, GLintptr offset, GLsizeiptr size) const
+{
+    GLintptr slotOffset = static_cast<GLintptr>(mSlotSize) * static_cast<GLintptr>(mCurrentSlot);
+    glBindBufferRange(target, binding, mBuffer, slotOffset + offset, size);
+}
+
+/**
+ * Call after the last command reading the current slot has been issued.
+ * @brief PersistentBuffer::fence
+ */
+void PersistentBuffer::fence()
+{
+    if (mFences.at(mCurrentSlot))
+        glDeleteSync(mFences.at(mCurrentSlot));
+
+    mFences.at(mCurrentSlot) = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mCurrentSlot = (mCurrentSlot + 1) % mSlotCount;
+}
+
+/**
+ * @brief PersistentBuffer::getBufferHandle
+ * @return
+ */
+GLuint PersistentBuffer::getBufferHandle() const
+{
+    return mBuffer;
+}
+
+/**
+ * @brief PersistentBuffer::getSlotSize
+ * @return
+ */
+GLsizeiptr PersistentBuffer::getSlotSize() const
+{
+    return mSlotSize;
+}
+
+/**
+ * @brief PersistentBuffer::getCurrentSlot
+ * @return
+ */
+unsigned int PersistentBuffer::getCurrentSlot() const
+{
+    return mCurrentSlot;
+}
+
+/**
+ * @brief PersistentBuffer::getOffsetAlignment
+ * @return the strictest of the UBO and SSBO offset alignments
+ */
+GLintptr PersistentBuffer::getOffsetAlignment()
+{
+    static GLint uboAlignment = 0, ssboAlignment = 0;
+    if (uboAlignment == 0)
+    {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlignment);
+    }
+    return static_cast<GLintptr>(std::max({uboAlignment, ssboAlignment, 16}));
+}
+
+/**
+ * @brief PersistentBuffer::alignOffset
+ * @param offset
+ * @return offset rounded up to getOffsetAlignment
+ */
+GLintptr PersistentBuffer::alignOffset(GLintptr offset)
+{
+    GLintptr alignment = getOffsetAlignment();
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+/**
+ * @brief PersistentBuffer::waitForSlot
+ * @param slot
+ */
+void PersistentBuffer::waitForSlot(unsigned int slot)
+{
+    GLsync& sync = mFences.at(slot);
+    if (!sync)
+        return;
+
+    // poll first, only flush and block if the GPU is still behind
+    GLenum result = glClientWaitSync(sync, 0, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
+    {
+        result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+
+    glDeleteSync(sync);
+    sync = nullptr;
+}
@@ -0,0 +1,48 @@
+#ifndef PERSISTENTBUFFER_HPP
+#define PERSISTENTBUFFER_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+/**
+ * A persistently mapped, coherent buffer split into N slots (frames in flight).
+ * The CPU writes slot N+1 while the GPU still reads slot N, each slot is
+ * guarded by a fence that is only waited on when the ring wraps around.
+ * @brief The PersistentBuffer class
+ */
+class PersistentBuffer final
+{
+public:
+    typedef std::unique_ptr<PersistentBuffer> Ptr;
+    static const unsigned int DEFAULT_SLOT_COUNT = 3;
+public:
+    explicit PersistentBuffer(GLsizeiptr slotSize, unsigned int slotCount = DEFAULT_SLOT_COUNT);
+    ~PersistentBuffer();
+
+    void* map();
+    void bindRange(GLenum target, GLuint binding, GLintptr offset, GLsizeiptr size) const;
+    void fence();
+
+    GLuint getBufferHandle() const;
+    GLsizeiptr getSlotSize() const;
+    unsigned int getCurrentSlot() const;
+
+    static GLintptr getOffsetAlignment();
+    static GLintptr alignOffset(GLintptr offset);
+
+private:
+    GLuint mBuffer;
+    GLsizeiptr mSlotSize;
+    unsigned int mSlotCount;
+    unsigned int mCurrentSlot;
+    char* mMappedPtr;
+    std::vector<GLsync> mFences;
+private:
+    PersistentBuffer(const PersistentBuffer& other);
+    PersistentBuffer& operator=(const PersistentBuffer& other);
+    void waitForSlot(unsigned int slot);
+};
+
+#endif // PERSISTENTBUFFER_HPP
@@ -2,6 +2,8 @@
 #include <glad/glad.h>
 #include <iostream>
 
+#include "Config.hpp"
+
 // Static member initialization
 Uint64 SDLHelper::s_start_time = 0;
 
@@ -37,8 +39,9 @@ bool SDLHelper::init() {
 #endif
 
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    // glBufferStorage (persistent mapping) needs 4.4, glad is generated for 4.5
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, APP_OPENGL_MAJOR);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, APP_OPENGL_MINOR);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
     SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
@@ -1,17 +1,37 @@
 #include "Shader.hpp"
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Utils.hpp"
 
+bool Shader::mParallelCompile = false;
+
+namespace
+{
+// GL_KHR_parallel_shader_compile (and its ARB twin), not part of the generated glad loader
+const GLenum GL_COMPLETION_STATUS = 0x91B1;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+// let the driver pick the number of compiler threads
+const GLuint ALL_COMPILER_THREADS = 0xFFFFFFFFu;
+// relative to the working directory, next to ./shaders
+const char* PROGRAM_CACHE_DIRECTORY = "./shader_cache";
+}
+
 /**
  * @brief Shader::Shader
  */
 Shader::Shader()
+: mHash(ShaderSource::EMPTY_HASH)
+, mPendingProgram(0)
+, mPendingHash(ShaderSource::EMPTY_HASH)
 {
     createProgram();
 }
@@ -25,40 +45,28 @@ Shader::~Shader()
 }
 
 /**
+ * Defines are injected after the #version line of every stage compiled afterwards,
+ * so one source file can be compiled into several variants.
+ * @brief Shader::addDefine
+ * @param define - "NAME" or "NAME value"
+ */
+void Shader::addDefine(const std::string& define)
+{
+    mDefines.push_back(define);
+}
+
+/**
+ * The file is read and its #include "file" directives resolved now, the
+ * stage is compiled by linkProgram unless the program binary cache already
+ * holds the linked program.
  * @brief Shader::compileAndAttachShader
  * @param shaderType
  * @param filename
  */
 void Shader::compileAndAttachShader(const int shaderType, const std::string& filename)
 {
-    // Build shader string from a file
-    std::string shaderCode = ""; 
-    // Code from LearnOpenGL.com
-    std::ifstream shaderFileStream;
-    // ensure ifstream objects can throw exceptions:
-    shaderFileStream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try 
-    {
-        shaderFileStream.open(filename);
-        std::stringstream shaderStrStream;
-        // read file's buffer contents into streams
-        shaderStrStream << shaderFileStream.rdbuf();		
-        // close file handlers
-        shaderFileStream.close();
-        // convert stream into string
-        shaderCode = shaderStrStream.str();		
-    }
-    catch(std::ifstream::failure e)
-    {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-    }
-
     mFileNames.emplace(shaderType, filename);
-    GLuint shaderId = compile(shaderType, shaderCode);
-
-    attach(shaderId);
-
-    deleteShader(shaderId);
+    mSources.emplace(shaderType, ShaderSource(filename));
 }
 
 /**
@@ -78,12 +86,36 @@ void Shader::compileAndAttachShader(const int shaderType, const std::string& cod
 }
 
 /**
+ * Programs read entirely from files are cached by the hash of their
+ * sources, defines and driver, a hit skips compiling and linking.
  * @brief Shader::linkProgram
  */
 void Shader::linkProgram()
 {
+    const bool cacheable = isCacheable(mSources);
+    const std::uint64_t hash = getProgramHash(mSources);
+    if (cacheable && loadBinary(mProgram, hash))
+    {
+        for (const auto& file : mFileNames)
+            printf("%s loaded from the program cache\n", file.second.c_str());
+        mHash = hash;
+        return;
+    }
+
+    std::vector<GLuint> shaderIds;
+    for (const auto& source : mSources)
+    {
+        GLuint shaderId = compile(source.first, source.second);
+        attach(shaderId);
+        shaderIds.push_back(shaderId);
+    }
+
+    glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(mProgram);
 
+    for (GLuint shaderId : shaderIds)
+        deleteShader(shaderId);
+
     GLint success;
     GLchar infoLog[512];
 
@@ -93,6 +125,12 @@ void Shader::linkProgram()
         glGetProgramInfoLog(mProgram, 512, nullptr, infoLog);
         printf("Program link failed: %s\n", infoLog);
     }
+    else
+    {
+        mHash = hash;
+        if (cacheable)
+            saveBinary(mProgram, hash);
+    }
 }
 
 /**
@@ -116,10 +154,189 @@ void Shader::release() const
  */
 void Shader::cleanUp()
 {
+    finishReload(false);
     if (mProgram)
         deleteProgram(mProgram);
     mGlslLocations.clear();
+    mUniforms.clear();
     mFileNames.clear();
+    mDefines.clear();
+    mSources.clear();
+    mHash = ShaderSource::EMPTY_HASH;
+}
+
+/**
+ * Rebuilds the program from the same files and defines without waiting for
+ * the compiler: with parallel shader compilation the driver compiles on its
+ * own threads and the current program keeps rendering until finishReload
+ * swaps the result in. Nothing is rebuilt if the include graph hashes to the
+ * current program, a program seen before comes from the binary cache.
+ * A reload still pending is dropped for the new one.
+ * @brief Shader::reload
+ */
+void Shader::reload()
+{
+    // programs built from code strings can't be reread
+    if (mSources.empty() || mSources.size() != mFileNames.size())
+        return;
+
+    std::map<int, ShaderSource> sources;
+    for (const auto& source : mSources)
+    {
+        ShaderSource reread(mFileNames.at(source.first));
+        if (!reread.isValid())
+            return;
+        sources.emplace(source.first, reread);
+    }
+
+    const std::uint64_t hash = getProgramHash(sources);
+    if (hash == mHash || (mPendingProgram && hash == mPendingHash))
+        return;
+
+    finishReload(false);
+    mPendingProgram = glCreateProgram();
+    mPendingHash = hash;
+    mPendingSources = sources;
+    if (loadBinary(mPendingProgram, hash))
+        return;
+
+    for (const auto& source : mPendingSources)
+    {
+        GLuint shaderId = submit(source.first, source.second);
+        glAttachShader(mPendingProgram, shaderId);
+        mPendingShaders.emplace_back(source.first, shaderId);
+    }
+    glProgramParameteri(mPendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(mPendingProgram);
+}
+
+/**
+ * @brief Shader::usesFile
+ * @param filename
+ * @return true if a stage or a file it includes was read from filename
+ */
+bool Shader::usesFile(const std::string& filename) const
+{
+    for (const auto& source : mSources)
+    {
+        const std::vector<std::string>& files = source.second.getFiles();
+        if (std::find(files.begin(), files.end(), filename) != files.end())
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Shader::isReloading
+ * @return true between reload and finishReload
+ */
+bool Shader::isReloading() const
+{
+    return mPendingProgram != 0;
+}
+
+/**
+ * @brief Shader::isReloadComplete
+ * @return true once checkReload won't stall, always without parallel shader compilation
+ */
+bool Shader::isReloadComplete() const
+{
+    if (!mPendingProgram || !mParallelCompile)
+        return true;
+
+    GLint complete = GL_FALSE;
+    glGetProgramiv(mPendingProgram, GL_COMPLETION_STATUS, &complete);
+    return complete == GL_TRUE;
+}
+
+/**
+ * Prints the compile and link logs of the pending program.
+ * @brief Shader::checkReload
+ * @return true if the pending program linked
+ */
+bool Shader::checkReload() const
+{
+    if (!mPendingProgram)
+        return false;
+
+    bool compiled = true;
+    for (const auto& pending : mPendingShaders)
+        compiled = checkCompileStatus(pending.first, mPendingSources.at(pending.first), pending.second) && compiled;
+
+    GLint success;
+    GLchar infoLog[512];
+
+    glGetProgramiv(mPendingProgram, GL_LINK_STATUS, &success);
+    if (compiled && !success)
+    {
+        glGetProgramInfoLog(mPendingProgram, 512, nullptr, infoLog);
+        printf("Program link failed: %s\n", infoLog);
+    }
+
+    return compiled && success;
+}
+
+/**
+ * Uniform locations are looked up again in the new program, uniform values
+ * are not carried over (every uniform is set before each dispatch).
+ * @brief Shader::finishReload
+ * @param swap - replace the current program with the pending one, else drop it
+ */
+void Shader::finishReload(bool swap)
+{
+    // loaded from the cache if nothing was compiled
+    const bool compiled = !mPendingShaders.empty();
+    for (const auto& pending : mPendingShaders)
+        deleteShader(pending.second);
+    mPendingShaders.clear();
+
+    if (!mPendingProgram)
+        return;
+
+    if (swap)
+    {
+        deleteProgram(mProgram);
+        mProgram = mPendingProgram;
+        mGlslLocations.clear();
+        resolveUniforms();
+        mSources = mPendingSources;
+        mHash = mPendingHash;
+        if (compiled)
+            saveBinary(mProgram, mHash);
+    }
+    else
+    {
+        deleteProgram(mPendingProgram);
+    }
+    mPendingProgram = 0;
+    mPendingHash = ShaderSource::EMPTY_HASH;
+    mPendingSources.clear();
+}
+
+/**
+ * GL_KHR_parallel_shader_compile lets reload return before the compile
+ * finishes, without it checkReload blocks on the compiler instead.
+ * Needs a current context.
+ * @brief Shader::EnableParallelCompile
+ * @return true if the extension is available
+ */
+bool Shader::EnableParallelCompile()
+{
+    const char* maxThreadsName = nullptr;
+    if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile"))
+        maxThreadsName = "glMaxShaderCompilerThreadsKHR";
+    else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile"))
+        maxThreadsName = "glMaxShaderCompilerThreadsARB";
+
+    PFNGLMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+    if (maxThreadsName)
+        maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSPROC>(SDL_GL_GetProcAddress(maxThreadsName));
+
+    mParallelCompile = maxShaderCompilerThreads != nullptr;
+    if (mParallelCompile)
+        maxShaderCompilerThreads(ALL_COMPILER_THREADS);
+
+    return mParallelCompile;
 }
 
 /**
@@ -321,6 +538,152 @@ void Shader::setUniform(const std::string& str, GLuint value)
     glUniform1ui(getUniformLocation(str), value);
 }
 
+/**
+ * Resolve a uniform once after linkProgram and set it through the handle,
+ * the per frame path then neither builds nor hashes a string. For an array, "uArray[2]" is the
+ * range starting at element 2. The handles set with glProgramUniform, the
+ * program does not need to be bound.
+ * @brief Shader::getUniform
+ * @param name
+ * @return the same handle for the same name, the location is -1 if the
+ * program does not use the uniform and setting it does nothing
+ */
+Shader::Uniform Shader::getUniform(const std::string& name)
+{
+    for (GLuint index = 0; index != mUniforms.size(); ++index)
+    {
+        if (mUniforms[index].first == name)
+            return {index};
+    }
+
+    mUniforms.emplace_back(name, glGetUniformLocation(mProgram, name.c_str()));
+    return {static_cast<GLuint>(mUniforms.size() - 1)};
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param matrix
+ */
+void Shader::setUniform(Uniform uniform, const glm::mat3& matrix) const
+{
+    glProgramUniformMatrix3fv(mProgram, mUniforms[uniform.index].second, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param matrix
+ */
+void Shader::setUniform(Uniform uniform, const glm::mat4& matrix) const
+{
+    glProgramUniformMatrix4fv(mProgram, mUniforms[uniform.index].second, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param vec
+ */
+void Shader::setUniform(Uniform uniform, const glm::vec2& vec) const
+{
+    glProgramUniform2f(mProgram, mUniforms[uniform.index].second, vec.x, vec.y);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param vec
+ */
+void Shader::setUniform(Uniform uniform, const glm::vec3& vec) const
+{
+    glProgramUniform3f(mProgram, mUniforms[uniform.index].second, vec.x, vec.y, vec.z);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param vec
+ */
+void Shader::setUniform(Uniform uniform, const glm::vec4& vec) const
+{
+    glProgramUniform4f(mProgram, mUniforms[uniform.index].second, vec.x, vec.y, vec.z, vec.w);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform - first element of the range
+ * @param arr
+ * @param count
+ */
+void Shader::setUniform(Uniform uniform, const glm::vec4 arr[], GLsizei count) const
+{
+    glProgramUniform4fv(mProgram, mUniforms[uniform.index].second, count, glm::value_ptr(arr[0]));
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform - first element of the range
+ * @param arr
+ * @param count
+ */
+void Shader::setUniform(Uniform uniform, const GLfloat arr[], GLsizei count) const
+{
+    glProgramUniform1fv(mProgram, mUniforms[uniform.index].second, count, arr);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform - first element of the range
+ * @param arr
+ * @param count
+ */
+void Shader::setUniform(Uniform uniform, const GLint arr[], GLsizei count) const
+{
+    glProgramUniform1iv(mProgram, mUniforms[uniform.index].second, count, arr);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform - first element of the range
+ * @param arr
+ * @param count
+ */
+void Shader::setUniform(Uniform uniform, const GLuint arr[], GLsizei count) const
+{
+    glProgramUniform1uiv(mProgram, mUniforms[uniform.index].second, count, arr);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param value
+ */
+void Shader::setUniform(Uniform uniform, GLfloat value) const
+{
+    glProgramUniform1f(mProgram, mUniforms[uniform.index].second, value);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param value
+ */
+void Shader::setUniform(Uniform uniform, GLint value) const
+{
+    glProgramUniform1i(mProgram, mUniforms[uniform.index].second, value);
+}
+
+/**
+ * @brief Shader::setUniform
+ * @param uniform
+ * @param value
+ */
+void Shader::setUniform(Uniform uniform, GLuint value) const
+{
+    glProgramUniform1ui(mProgram, mUniforms[uniform.index].second, value);
+}
+
 /**
  * @brief Shader::setSubroutine
  * @param shaderType
@@ -427,37 +790,68 @@ std::unordered_map<int, std::string> Shader::getFileNames() const
 /**
  * @brief Shader::compile
  * @param shaderType
- * @param shaderCode
+ * @param source
  * @return
  */
-GLuint Shader::compile(const int shaderType, const std::string& shaderCode)
+GLuint Shader::compile(const int shaderType, const ShaderSource& source)
 {
-    GLint length = static_cast<GLint>(shaderCode.length());
-    const GLchar* glShaderString = shaderCode.c_str();
-
-    GLenum glShaderType = getShaderType(shaderType);
+    GLuint shaderId = submit(shaderType, source);
+    checkCompileStatus(shaderType, source, shaderId);
+    return shaderId;
+}
 
-    GLint success;
-    GLchar infoLog[512];
+/**
+ * Hands the source to the compiler without asking for the result.
+ * @brief Shader::submit
+ * @param shaderType
+ * @param source
+ * @return
+ */
+GLuint Shader::submit(const int shaderType, const ShaderSource& source) const
+{
+    const std::string definedCode = source.getCode(getDefines());
+    GLint length = static_cast<GLint>(definedCode.length());
+    const GLchar* glShaderString = definedCode.c_str();
 
-    GLuint shaderId = glCreateShader(glShaderType);
+    GLuint shaderId = glCreateShader(getShaderType(shaderType));
 
     glShaderSource(shaderId, 1, &glShaderString, &length);
     glCompileShader(shaderId);
-    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &length);
+
+    return shaderId;
+}
+
+/**
+ * The log refers to files by their #line source string number, the
+ * numbers are listed after a failed compile.
+ * @brief Shader::checkCompileStatus
+ * @param shaderType
+ * @param source
+ * @param shaderId
+ * @return true if the stage compiled, the log is printed either way
+ */
+bool Shader::checkCompileStatus(const int shaderType, const ShaderSource& source, GLuint shaderId) const
+{
+    GLint success;
+    GLchar infoLog[512];
+
     glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
 
     if (!success)
     {
         glGetShaderInfoLog(shaderId, 512, nullptr, infoLog);
         printf("%s -- Shader Compilation Failed: %s\n", mFileNames.at(shaderType).c_str(), infoLog);
+
+        const std::vector<std::string>& files = source.getFiles();
+        for (std::size_t index = 0; index != files.size(); ++index)
+            printf("\tsource string %zu = %s\n", index, files.at(index).c_str());
     }
     else if (success)
     {
         printf("%s compiled successfully\n", mFileNames.at(shaderType).c_str());
     }
 
-    return shaderId;
+    return success;
 }
 
 /**
@@ -496,6 +890,126 @@ GLuint Shader::compile(const int shaderType, const GLchar* shaderCode)
 
 }
 
+/**
+ * @brief Shader::getDefines
+ * @return a #define line per addDefine call
+ */
+std::string Shader::getDefines() const
+{
+    std::string defines;
+    for (const auto& define : mDefines)
+        defines += "#define " + define + "\n";
+    return defines;
+}
+
+/**
+ * A binary is only valid for the driver that produced it, the renderer
+ * and version strings are part of the hash.
+ * @brief Shader::getProgramHash
+ * @param sources
+ * @return hash of the stages, their include graphs and the defines
+ */
+std::uint64_t Shader::getProgramHash(const std::map<int, ShaderSource>& sources) const
+{
+    std::uint64_t hash = ShaderSource::Hash(getDefines());
+    for (const auto& source : sources)
+        hash = ShaderSource::Hash(Utils::toString(source.first) + ":" + Utils::toString(source.second.getHash()) + "\n", hash);
+
+    for (GLenum name : {GL_RENDERER, GL_VERSION})
+    {
+        const GLubyte* string = glGetString(name);
+        if (string)
+            hash = ShaderSource::Hash(reinterpret_cast<const char*>(string), hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief Shader::isCacheable
+ * @param sources
+ * @return true if every stage was read from a file
+ */
+bool Shader::isCacheable(const std::map<int, ShaderSource>& sources) const
+{
+    if (sources.empty() || sources.size() != mFileNames.size())
+        return false;
+
+    for (const auto& source : sources)
+    {
+        if (!source.second.isValid())
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Shader::loadBinary
+ * @param program
+ * @param hash
+ * @return true if the cache held a binary the driver accepted,
+ * a stale one (driver update) is compiled again and overwritten
+ */
+bool Shader::loadBinary(GLuint program, std::uint64_t hash) const
+{
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0)
+        return false;
+
+    std::ifstream file(GetCacheFile(hash), std::ios::binary);
+    GLenum format = 0;
+    if (!file || !file.read(reinterpret_cast<char*>(&format), sizeof(format)))
+        return false;
+
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return false;
+
+    glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success == GL_TRUE;
+}
+
+/**
+ * @brief Shader::saveBinary
+ * @param program - linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+ * @param hash
+ */
+void Shader::saveBinary(GLuint program, std::uint64_t hash) const
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(PROGRAM_CACHE_DIRECTORY, error);
+
+    std::ofstream file(GetCacheFile(hash), std::ios::binary);
+    if (!file)
+        return;
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), length);
+}
+
+/**
+ * @brief Shader::GetCacheFile
+ * @param hash
+ * @return the cache entry for a program hash
+ */
+std::string Shader::GetCacheFile(std::uint64_t hash)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return std::string(PROGRAM_CACHE_DIRECTORY) + "/" + name;
+}
+
 /**
  * @brief Shader::attach
  * @param shaderId
@@ -559,6 +1073,16 @@ GLint Shader::getUniformLocation(const std::string& str)
     }
 }
 
+/**
+ * Looks the getUniform handles up again after the program changed.
+ * @brief Shader::resolveUniforms
+ */
+void Shader::resolveUniforms()
+{
+    for (auto& uniform : mUniforms)
+        uniform.second = glGetUniformLocation(mProgram, uniform.first.c_str());
+}
+
 /**
  * @brief Shader::getAttribLocation
  * @param str
@@ -1,14 +1,19 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <cstdint>
+#include <map>
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "SDLHelper.hpp"
+#include "ShaderSource.hpp"
 
 namespace ShaderTypes
 {
@@ -24,10 +29,18 @@ class Shader final
 {
 public:
     typedef std::unique_ptr<Shader> Ptr;
+
+    // a uniform resolved once by getUniform, an index into the program's
+    // location table, so it stays valid when a hot reload relinks the program
+    struct Uniform
+    {
+        GLuint index;
+    };
 public:
     explicit Shader();
     virtual ~Shader();
 
+    void addDefine(const std::string& define);
     void compileAndAttachShader(const int shaderType, const std::string& filename);
     void compileAndAttachShader(const int shaderType, const std::string& codeId, const GLchar* code);
     void linkProgram();
@@ -36,6 +49,15 @@ public:
 
     void cleanUp();
 
+    void reload();
+    bool usesFile(const std::string& filename) const;
+    bool isReloading() const;
+    bool isReloadComplete() const;
+    bool checkReload() const;
+    void finishReload(bool swap);
+
+    static bool EnableParallelCompile();
+
     std::string getGlslUniforms() const;
     std::string getGlslAttribs() const;
 
@@ -52,6 +74,20 @@ public:
     void setUniform(const std::string& str, GLint value);
     void setUniform(const std::string& str, GLuint value);
 
+    Uniform getUniform(const std::string& name);
+    void setUniform(Uniform uniform, const glm::mat3& matrix) const;
+    void setUniform(Uniform uniform, const glm::mat4& matrix) const;
+    void setUniform(Uniform uniform, const glm::vec2& vec) const;
+    void setUniform(Uniform uniform, const glm::vec3& vec) const;
+    void setUniform(Uniform uniform, const glm::vec4& vec) const;
+    void setUniform(Uniform uniform, const glm::vec4 arr[], GLsizei count) const;
+    void setUniform(Uniform uniform, const GLfloat arr[], GLsizei count) const;
+    void setUniform(Uniform uniform, const GLint arr[], GLsizei count) const;
+    void setUniform(Uniform uniform, const GLuint arr[], GLsizei count) const;
+    void setUniform(Uniform uniform, GLfloat value) const;
+    void setUniform(Uniform uniform, GLint value) const;
+    void setUniform(Uniform uniform, GLuint value) const;
+
     void setSubroutine(GLenum shaderType, GLuint count, const std::string& name);
     void setSubroutine(GLenum shaderType, GLuint count, GLuint index);
 
@@ -66,17 +102,38 @@ public:
 private:
     GLint mProgram;
     std::unordered_map<std::string, GLint> mGlslLocations;
+    // getUniform names and their locations in mProgram, indexed by Uniform::index
+    std::vector<std::pair<std::string, GLint>> mUniforms;
     std::unordered_map<int, std::string> mFileNames;
+    std::vector<std::string> mDefines;
+    // stages read from files, compiled by linkProgram
+    std::map<int, ShaderSource> mSources;
+    std::uint64_t mHash;
+    // the rebuild started by reload, swapped in by finishReload
+    GLint mPendingProgram;
+    std::uint64_t mPendingHash;
+    std::map<int, ShaderSource> mPendingSources;
+    std::vector<std::pair<int, GLuint>> mPendingShaders;
+    static bool mParallelCompile;
 private:
     Shader(const Shader& other);
     Shader& operator=(const Shader& other);
-    GLuint compile(const int shaderType, const std::string& shaderCode);
+    GLuint compile(const int shaderType, const ShaderSource& source);
     GLuint compile(const int shaderType, const GLchar* shaderCode);
+    GLuint submit(const int shaderType, const ShaderSource& source) const;
+    bool checkCompileStatus(const int shaderType, const ShaderSource& source, GLuint shaderId) const;
+    std::string getDefines() const;
+    std::uint64_t getProgramHash(const std::map<int, ShaderSource>& sources) const;
+    bool isCacheable(const std::map<int, ShaderSource>& sources) const;
+    bool loadBinary(GLuint program, std::uint64_t hash) const;
+    void saveBinary(GLuint program, std::uint64_t hash) const;
+    static std::string GetCacheFile(std::uint64_t hash);
     void attach(GLuint shaderId);
     void createProgram();
     void deleteShader(GLuint shaderId);
     void deleteProgram(GLint shaderId);
     GLint getUniformLocation(const std::string& str);
+    void resolveUniforms();
     GLint getAttribLocation(const std::string& str);
     GLuint getSubroutineLocation(GLenum shaderType, const std::string& name);
     std::string getStringFromType(GLenum shaderType) const;
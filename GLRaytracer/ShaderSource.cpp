@@ -0,0 +1,221 @@
+#include "ShaderSource.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// FNV-1a offset basis
+const std::uint64_t ShaderSource::EMPTY_HASH = 14695981039346656037ull;
+
+namespace
+{
+const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+std::string getLineDirective(unsigned int line, unsigned int fileIndex)
+{
+    return "#line " + std::to_string(line) + " " + std::to_string(fileIndex) + "\n";
+}
+
+bool isDirective(const std::string& line, const std::string& name, std::size_t& end)
+{
+    std::size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] != '#')
+        return false;
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos || line.compare(pos, name.length(), name) != 0)
+        return false;
+    end = pos + name.length();
+    return true;
+}
+}
+
+/**
+ * @brief ShaderSource::ShaderSource
+ * @param filename - the root file, the one holding #version
+ */
+ShaderSource::ShaderSource(const std::string& filename)
+: mHash(EMPTY_HASH)
+, mValid(true)
+{
+    std::vector<std::string> includeStack;
+    expand(filename, includeStack);
+}
+
+/**
+ * @brief ShaderSource::getCode
+ * @param prologue - #define lines, goes right after the #version line
+ * @return the expanded code, line numbers of the files are kept
+ */
+std::string ShaderSource::getCode(const std::string& prologue) const
+{
+    if (mVersion.empty())
+        return prologue + mCode;
+    return mVersion + "\n" + prologue + mCode;
+}
+
+/**
+ * @brief ShaderSource::getFiles
+ * @return every file read, indexed by the #line source string number
+ */
+const std::vector<std::string>& ShaderSource::getFiles() const
+{
+    return mFiles;
+}
+
+/**
+ * @brief ShaderSource::getHash
+ * @return the contents of every file in include order, hashed
+ */
+std::uint64_t ShaderSource::getHash() const
+{
+    return mHash;
+}
+
+/**
+ * @brief ShaderSource::isValid
+ * @return false if a file could not be read or includes itself
+ */
+bool ShaderSource::isValid() const
+{
+    return mValid;
+}
+
+/**
+ * 64 bit FNV-1a, chain the calls to hash several strings.
+ * @brief ShaderSource::Hash
+ * @param text
+ * @param hash = EMPTY_HASH
+ * @return
+ */
+std::uint64_t ShaderSource::Hash(const std::string& text, std::uint64_t hash)
+{
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief ShaderSource::expand
+ * @param filename
+ * @param includeStack - the files currently being expanded, to catch cycles
+ */
+void ShaderSource::expand(const std::string& filename, std::vector<std::string>& includeStack)
+{
+    if (std::find(includeStack.begin(), includeStack.end(), filename) != includeStack.end())
+    {
+        printf("%s includes itself\n", filename.c_str());
+        mValid = false;
+        return;
+    }
+
+    std::string text;
+    if (!ReadFile(filename, text))
+    {
+        mValid = false;
+        return;
+    }
+
+    const unsigned int fileIndex = getFileIndex(filename);
+    mHash = Hash(text, mHash);
+    includeStack.push_back(filename);
+
+    mCode += getLineDirective(1, fileIndex);
+
+    std::istringstream lines(text);
+    std::string line;
+    for (unsigned int lineNumber = 1; std::getline(lines, line); ++lineNumber)
+    {
+        std::size_t end = 0;
+        std::string include;
+        if (includeStack.size() == 1 && mVersion.empty() && isDirective(line, "version", end))
+        {
+            mVersion = line;
+            mCode += getLineDirective(lineNumber + 1, fileIndex);
+        }
+        else if (GetInclude(line, include))
+        {
+            expand(GetDirectory(filename) + include, includeStack);
+            mCode += getLineDirective(lineNumber + 1, fileIndex);
+        }
+        else
+        {
+            mCode += line + "\n";
+        }
+    }
+
+    includeStack.pop_back();
+}
+
+/**
+ * @brief ShaderSource::getFileIndex
+ * @param filename
+ * @return index in mFiles, the file is added on first use
+ */
+unsigned int ShaderSource::getFileIndex(const std::string& filename)
+{
+    auto iter = std::find(mFiles.begin(), mFiles.end(), filename);
+    if (iter != mFiles.end())
+        return static_cast<unsigned int>(iter - mFiles.begin());
+
+    mFiles.push_back(filename);
+    return static_cast<unsigned int>(mFiles.size() - 1);
+}
+
+/**
+ * @brief ShaderSource::ReadFile
+ * @param filename
+ * @param text - the whole file
+ * @return false if it can't be read
+ */
+bool ShaderSource::ReadFile(const std::string& filename, std::string& text)
+{
+    std::ifstream fileStream(filename);
+    if (!fileStream)
+    {
+        printf("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ %s\n", filename.c_str());
+        return false;
+    }
+
+    std::stringstream textStream;
+    textStream << fileStream.rdbuf();
+    text = textStream.str();
+    return true;
+}
+
+/**
+ * @brief ShaderSource::GetInclude
+ * @param line
+ * @param include - the quoted file name
+ * @return true for #include "file"
+ */
+bool ShaderSource::GetInclude(const std::string& line, std::string& include)
+{
+    std::size_t end = 0;
+    if (!isDirective(line, "include", end))
+        return false;
+
+    std::size_t open = line.find_first_not_of(" \t", end);
+    if (open == std::string::npos || line[open] != '"')
+        return false;
+    std::size_t close = line.find('"', open + 1);
+    if (close == std::string::npos)
+        return false;
+
+    include = line.substr(open + 1, close - open - 1);
+    return true;
+}
+
+/**
+ * @brief ShaderSource::GetDirectory
+ * @param filename
+ * @return everything up to and including the last '/', "./shaders/" for "./shaders/raytracer.cs.glsl"
+ */
+std::string ShaderSource::GetDirectory(const std::string& filename)
+{
+    std::size_t slash = filename.find_last_of('/');
+    return (slash == std::string::npos) ? std::string() : filename.substr(0, slash + 1);
+}
@@ -0,0 +1,54 @@
+#ifndef SHADERSOURCE_HPP
+#define SHADERSOURCE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// where the shaders are read and watched from, CMake points it at the source tree
+// so hot reload sees the edits; "./shaders" next to the executable otherwise
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "./shaders"
+#endif
+
+/**
+ * A GLSL file with its #include "file" directives resolved, paths relative
+ * to the including file. Every inclusion is bracketed by #line directives
+ * whose source string number is the file's index in getFiles(), so the
+ * compiler log points into the right file. #include <...> is left alone,
+ * layout.glsl keeps its C++ includes behind #ifdef __cplusplus.
+ * The hash covers the contents of the whole include graph, equal hashes
+ * mean the expanded code is the same.
+ * @brief The ShaderSource class
+ */
+class ShaderSource final
+{
+public:
+    static const std::uint64_t EMPTY_HASH;
+public:
+    explicit ShaderSource(const std::string& filename);
+
+    std::string getCode(const std::string& prologue) const;
+    const std::vector<std::string>& getFiles() const;
+    std::uint64_t getHash() const;
+    bool isValid() const;
+
+    static std::uint64_t Hash(const std::string& text, std::uint64_t hash = EMPTY_HASH);
+
+private:
+    // expanded code without the #version line
+    std::string mVersion;
+    std::string mCode;
+    // the root file first, each included file once
+    std::vector<std::string> mFiles;
+    std::uint64_t mHash;
+    bool mValid;
+private:
+    void expand(const std::string& filename, std::vector<std::string>& includeStack);
+    unsigned int getFileIndex(const std::string& filename);
+    static bool ReadFile(const std::string& filename, std::string& text);
+    static bool GetInclude(const std::string& line, std::string& include);
+    static std::string GetDirectory(const std::string& filename);
+};
+
+#endif // SHADERSOURCE_HPP
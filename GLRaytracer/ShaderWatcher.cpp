@@ -0,0 +1,98 @@
+#include "ShaderWatcher.hpp"
+
+#include <cstdio>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// how long the watch thread blocks before checking for shutdown
+const int POLL_TIMEOUT_MS = 100;
+}
+
+/**
+ * Editors either rewrite the file in place or rename a temporary over it,
+ * both are reported once the new contents are complete.
+ * @brief ShaderWatcher::ShaderWatcher
+ * @param directory - as the Shader file names spell it, SHADER_SOURCE_DIR
+ */
+ShaderWatcher::ShaderWatcher(const std::string& directory)
+: mDirectory(directory)
+, mRunning(false)
+, mInotify(-1)
+{
+#if defined(__linux__)
+    mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (mInotify < 0 || inotify_add_watch(mInotify, mDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        printf("Shader hot reload disabled, can't watch %s\n", mDirectory.c_str());
+        return;
+    }
+
+    mRunning.store(true);
+    mThread = std::thread(&ShaderWatcher::watchLoop, this);
+#else
+    printf("Shader hot reload needs inotify, %s is not watched\n", mDirectory.c_str());
+#endif
+}
+
+/**
+ * @brief ShaderWatcher::~ShaderWatcher
+ */
+ShaderWatcher::~ShaderWatcher()
+{
+    mRunning.store(false);
+    if (mThread.joinable())
+        mThread.join();
+
+#if defined(__linux__)
+    if (mInotify >= 0)
+        close(mInotify);
+#endif
+}
+
+/**
+ * @brief ShaderWatcher::takeChanged
+ * @return the files written since the last call, each once
+ */
+std::vector<std::string> ShaderWatcher::takeChanged()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<std::string> changed(mChanged.begin(), mChanged.end());
+    mChanged.clear();
+    return changed;
+}
+
+/**
+ * @brief ShaderWatcher::watchLoop
+ */
+void ShaderWatcher::watchLoop()
+{
+#if defined(__linux__)
+    alignas(inotify_event) char buffer[4096];
+    pollfd descriptor = {mInotify, POLLIN, 0};
+
+    while (mRunning.load())
+    {
+        if (poll(&descriptor, 1, POLL_TIMEOUT_MS) <= 0)
+            continue;
+
+        ssize_t length = 0;
+        while ((length = read(mInotify, buffer, sizeof(buffer))) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (char* next = buffer; next < buffer + length; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(next);
+                if (event->len > 0)
+                    mChanged.insert(mDirectory + "/" + event->name);
+                next += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef SHADERWATCHER_HPP
+#define SHADERWATCHER_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Watches a shader directory with inotify on a background thread and
+ * collects the files written since the last poll. The render loop takes
+ * the changed paths and starts the rebuilds itself, every GL call stays on
+ * the thread owning the context. Without inotify (non Linux builds) no
+ * change is ever reported.
+ * @brief The ShaderWatcher class
+ */
+class ShaderWatcher final
+{
+public:
+    typedef std::unique_ptr<ShaderWatcher> Ptr;
+public:
+    explicit ShaderWatcher(const std::string& directory);
+    ~ShaderWatcher();
+
+    std::vector<std::string> takeChanged();
+
+private:
+    std::string mDirectory;
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::mutex mMutex;
+    // directory + "/" + file name, the form the Shader file names use
+    std::set<std::string> mChanged;
+    int mInotify;
+private:
+    ShaderWatcher(const ShaderWatcher& other);
+    ShaderWatcher& operator=(const ShaderWatcher& other);
+    void watchLoop();
+};
+
+#endif // SHADERWATCHER_HPP
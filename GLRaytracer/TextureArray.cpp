@@ -0,0 +1,336 @@
+#include "TextureArray.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// power of two, the mip chain halves it down to 1x1
+const GLsizei TextureArray::LAYER_SIZE = 512;
+// should match the uTextures binding in texture.glsl
+const GLuint TextureArray::TEXTURE_UNIT = 1;
+
+namespace
+{
+const int CHANNELS = 4;
+const float TWO_PI = 6.28318531f;
+
+// lattice value in [0, 1], wraps every period cells so the noise tiles
+float getLatticeValue(int x, int y, int period)
+{
+    std::uint32_t h = static_cast<std::uint32_t>((x % period + period) % period) * 73856093u
+        ^ static_cast<std::uint32_t>((y % period + period) % period) * 19349663u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return static_cast<float>(h & 0xFFFFu) / 65535.0f;
+}
+
+float getValueNoise(float x, float y, int period)
+{
+    const int ix = static_cast<int>(std::floor(x));
+    const int iy = static_cast<int>(std::floor(y));
+    float fx = x - static_cast<float>(ix);
+    float fy = y - static_cast<float>(iy);
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+
+    const float bottom = getLatticeValue(ix, iy, period) * (1.0f - fx) + getLatticeValue(ix + 1, iy, period) * fx;
+    const float top = getLatticeValue(ix, iy + 1, period) * (1.0f - fx) + getLatticeValue(ix + 1, iy + 1, period) * fx;
+    return bottom * (1.0f - fy) + top * fy;
+}
+
+// four octaves over [0, period) x [0, period), in [0, 1]
+float getFbm(float x, float y, int period)
+{
+    float sum = 0.0f;
+    float amplitude = 0.5f;
+    for (int octave = 0; octave != 4; ++octave)
+    {
+        sum += getValueNoise(x, y, period) * amplitude;
+        x *= 2.0f;
+        y *= 2.0f;
+        period *= 2;
+        amplitude *= 0.5f;
+    }
+    return sum / 0.9375f;
+}
+
+std::uint8_t toByte(float value)
+{
+    return static_cast<std::uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+}
+
+/**
+ * The layers are white until their decode finishes, update() uploads them.
+ * @brief TextureArray::TextureArray
+ * @param files - one image per layer, any format stb_image reads
+ */
+TextureArray::TextureArray(const std::vector<std::string>& files)
+: mFiles(files)
+, mLevels(1)
+, mTexture(0)
+, mUploaded(0)
+{
+    for (GLsizei size = LAYER_SIZE; size > 1; size /= 2)
+        mLevels++;
+
+    glGenTextures(1, &mTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, mLevels, GL_RGBA8, LAYER_SIZE, LAYER_SIZE, std::max(getLayerCount(), 1));
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    const GLubyte white[CHANNELS] = {255, 255, 255, 255};
+    for (GLint level = 0; level != mLevels; ++level)
+        glClearTexImage(mTexture, level, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+    if (mFiles.empty())
+        return;
+
+    // TileScheduler::run blocks until every layer is done, keep it off the render thread
+    const unsigned int workers = std::min(static_cast<unsigned int>(mFiles.size()),
+        std::max(std::thread::hardware_concurrency(), 1u));
+    mScheduler = std::make_unique<TileScheduler>(workers);
+    mLoader = std::thread([this]() {
+        mScheduler->run(static_cast<unsigned int>(mFiles.size()), 1,
+            [this](unsigned int layer, unsigned int) { loadLayer(layer); });
+    });
+}
+
+/**
+ * Waits for the layers still decoding.
+ * @brief TextureArray::~TextureArray
+ */
+TextureArray::~TextureArray()
+{
+    if (mLoader.joinable())
+        mLoader.join();
+    mScheduler.reset();
+
+    glDeleteTextures(1, &mTexture);
+}
+
+/**
+ * @brief TextureArray::bind
+ */
+void TextureArray::bind() const
+{
+    glBindTextureUnit(TEXTURE_UNIT, mTexture);
+}
+
+/**
+ * Uploads the layers decoded since the last call, cheap once all are in.
+ * @brief TextureArray::update
+ * @return true if layers were uploaded, the traced image changes then
+ */
+bool TextureArray::update()
+{
+    if (mUploaded == getLayerCount())
+        return false;
+
+    std::vector<Layer> decoded;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        decoded.swap(mDecoded);
+    }
+
+    for (const Layer& layer : decoded)
+    {
+        GLsizei size = LAYER_SIZE;
+        for (GLint level = 0; level != static_cast<GLint>(layer.levels.size()); ++level, size /= 2)
+        {
+            glTextureSubImage3D(mTexture, level, 0, 0, layer.index, size, size, 1,
+                GL_RGBA, GL_UNSIGNED_BYTE, layer.levels.at(level).data());
+        }
+    }
+
+    mUploaded += static_cast<GLsizei>(decoded.size());
+    if (!decoded.empty() && mUploaded == getLayerCount())
+        printf("Textures: %d layers of %dx%d uploaded\n", mUploaded, LAYER_SIZE, LAYER_SIZE);
+    return !decoded.empty();
+}
+
+/**
+ * @brief TextureArray::getLayerCount
+ * @return
+ */
+GLsizei TextureArray::getLayerCount() const
+{
+    return static_cast<GLsizei>(mFiles.size());
+}
+
+/**
+ * Runs on a worker: decode or generate level 0, then the mip chain.
+ * @brief TextureArray::loadLayer
+ * @param index - layer and index into mFiles
+ */
+void TextureArray::loadLayer(unsigned int index)
+{
+    Layer layer;
+    layer.index = static_cast<GLint>(index);
+    layer.levels.emplace_back();
+    if (!Decode(mFiles.at(index), layer.levels.back()))
+    {
+        printf("Texture %s not found, using a procedural stand-in\n", mFiles.at(index).c_str());
+        Generate(index, layer.levels.back());
+    }
+
+    for (GLsizei size = LAYER_SIZE; size > 1; size /= 2)
+        layer.levels.push_back(Downsample(layer.levels.back(), size));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDecoded.push_back(std::move(layer));
+}
+
+/**
+ * Bilinear resample to LAYER_SIZE, rows are flipped to GL's bottom up order.
+ * @brief TextureArray::Decode
+ * @param filename
+ * @param pixels - RGBA8, LAYER_SIZE x LAYER_SIZE
+ * @return false if stb_image can't read the file
+ */
+bool TextureArray::Decode(const std::string& filename, std::vector<std::uint8_t>& pixels)
+{
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    stbi_uc* image = stbi_load(filename.c_str(), &width, &height, &channels, CHANNELS);
+    if (image == nullptr)
+        return false;
+
+    pixels.resize(static_cast<std::size_t>(LAYER_SIZE) * LAYER_SIZE * CHANNELS);
+    for (GLsizei y = 0; y != LAYER_SIZE; ++y)
+    {
+        const float sourceY = std::max((static_cast<float>(y) + 0.5f) * static_cast<float>(height) / LAYER_SIZE - 0.5f, 0.0f);
+        const int y0 = std::min(static_cast<int>(sourceY), height - 1);
+        const int y1 = std::min(y0 + 1, height - 1);
+        const float fy = sourceY - static_cast<float>(y0);
+
+        for (GLsizei x = 0; x != LAYER_SIZE; ++x)
+        {
+            const float sourceX = std::max((static_cast<float>(x) + 0.5f) * static_cast<float>(width) / LAYER_SIZE - 0.5f, 0.0f);
+            const int x0 = std::min(static_cast<int>(sourceX), width - 1);
+            const int x1 = std::min(x0 + 1, width - 1);
+            const float fx = sourceX - static_cast<float>(x0);
+
+            std::uint8_t* out = &pixels.at((static_cast<std::size_t>(LAYER_SIZE - 1 - y) * LAYER_SIZE + x) * CHANNELS);
+            for (int c = 0; c != CHANNELS; ++c)
+            {
+                const float bottom = image[(y0 * width + x0) * CHANNELS + c] * (1.0f - fx) + image[(y0 * width + x1) * CHANNELS + c] * fx;
+                const float top = image[(y1 * width + x0) * CHANNELS + c] * (1.0f - fx) + image[(y1 * width + x1) * CHANNELS + c] * fx;
+                out[c] = static_cast<std::uint8_t>(bottom * (1.0f - fy) + top * fy + 0.5f);
+            }
+        }
+    }
+
+    stbi_image_free(image);
+    return true;
+}
+
+/**
+ * Tileable stand-ins, so the textured materials show something without
+ * image files: tiles, marble, wood grain and a UV test grid.
+ * @brief TextureArray::Generate
+ * @param pattern - modulo the four patterns
+ * @param pixels - RGBA8, LAYER_SIZE x LAYER_SIZE
+ */
+void TextureArray::Generate(unsigned int pattern, std::vector<std::uint8_t>& pixels)
+{
+    pixels.resize(static_cast<std::size_t>(LAYER_SIZE) * LAYER_SIZE * CHANNELS);
+    for (GLsizei y = 0; y != LAYER_SIZE; ++y)
+    {
+        for (GLsizei x = 0; x != LAYER_SIZE; ++x)
+        {
+            const float u = (static_cast<float>(x) + 0.5f) / LAYER_SIZE;
+            const float v = (static_cast<float>(y) + 0.5f) / LAYER_SIZE;
+            float r = 1.0f, g = 1.0f, b = 1.0f;
+
+            switch (pattern % 4)
+            {
+            case 0:
+            {
+                // 8x8 tiles with dark grout, each tile slightly different
+                const float tileU = u * 8.0f;
+                const float tileV = v * 8.0f;
+                const float edge = std::min(std::min(tileU - std::floor(tileU), std::ceil(tileU) - tileU),
+                    std::min(tileV - std::floor(tileV), std::ceil(tileV) - tileV));
+                const float shade = 0.8f + 0.15f * getLatticeValue(static_cast<int>(tileU), static_cast<int>(tileV), 8)
+                    + 0.05f * getFbm(u * 32.0f, v * 32.0f, 32);
+                r = g = b = (edge < 0.04f) ? 0.45f : shade;
+                g *= 0.97f;
+                b *= 0.92f;
+                break;
+            }
+            case 1:
+            {
+                // veins along u, bent by noise
+                const float vein = 0.5f + 0.5f * std::sin(TWO_PI * (u * 4.0f + getFbm(u * 8.0f, v * 8.0f, 8) * 1.5f));
+                r = g = b = 0.35f + 0.65f * std::sqrt(vein);
+                b *= 1.05f;
+                break;
+            }
+            case 2:
+            {
+                // growth rings across v
+                const float ring = v * 12.0f + getFbm(u * 4.0f, v * 4.0f, 4) * 2.0f;
+                const float grain = 0.75f + 0.25f * (ring - std::floor(ring));
+                r = 0.55f * grain;
+                g = 0.35f * grain;
+                b = 0.2f * grain;
+                break;
+            }
+            default:
+            {
+                // 16x16 checker tinted by u, dimmed towards the v seams
+                const bool odd = ((static_cast<int>(u * 16.0f) + static_cast<int>(v * 16.0f)) & 1) != 0;
+                const float checker = (odd ? 0.6f : 1.0f) * (0.75f + 0.25f * std::cos(TWO_PI * v));
+                r = checker * (0.5f + 0.5f * std::cos(TWO_PI * u));
+                g = checker * (0.5f + 0.5f * std::cos(TWO_PI * (u - 1.0f / 3.0f)));
+                b = checker * (0.5f + 0.5f * std::cos(TWO_PI * (u - 2.0f / 3.0f)));
+                break;
+            }
+            }
+
+            std::uint8_t* out = &pixels.at((static_cast<std::size_t>(y) * LAYER_SIZE + x) * CHANNELS);
+            out[0] = toByte(r);
+            out[1] = toByte(g);
+            out[2] = toByte(b);
+            out[3] = 255;
+        }
+    }
+}
+
+/**
+ * 2x2 box filter.
+ * @brief TextureArray::Downsample
+ * @param pixels - RGBA8, size x size
+ * @param size - power of two
+ * @return RGBA8, size / 2 x size / 2
+ */
+std::vector<std::uint8_t> TextureArray::Downsample(const std::vector<std::uint8_t>& pixels, GLsizei size)
+{
+    const GLsizei half = size / 2;
+    std::vector<std::uint8_t> result(static_cast<std::size_t>(half) * half * CHANNELS);
+    for (GLsizei y = 0; y != half; ++y)
+    {
+        for (GLsizei x = 0; x != half; ++x)
+        {
+            for (int c = 0; c != CHANNELS; ++c)
+            {
+                const unsigned int sum = pixels[((2 * y) * size + 2 * x) * CHANNELS + c]
+                    + pixels[((2 * y) * size + 2 * x + 1) * CHANNELS + c]
+                    + pixels[((2 * y + 1) * size + 2 * x) * CHANNELS + c]
+                    + pixels[((2 * y + 1) * size + 2 * x + 1) * CHANNELS + c];
+                result[(y * half + x) * CHANNELS + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+#ifndef TEXTUREARRAY_HPP
+#define TEXTUREARRAY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "TileScheduler.hpp"
+
+/**
+ * Material textures as the layers of one mipmapped GL_TEXTURE_2D_ARRAY,
+ * so a material only stores its layer index and the tracers bind a single
+ * sampler. The images are decoded with stb_image on a TileScheduler pool,
+ * one job per layer, resized to LAYER_SIZE and mipmapped on the worker.
+ * Loading runs behind the first frames, update() uploads what is ready
+ * and the layers stay white, i.e. untextured, until then. A file that
+ * can't be read is replaced by a procedural stand-in.
+ * @brief The TextureArray class
+ */
+class TextureArray final
+{
+public:
+    typedef std::unique_ptr<TextureArray> Ptr;
+    static const GLsizei LAYER_SIZE;
+    static const GLuint TEXTURE_UNIT;
+public:
+    explicit TextureArray(const std::vector<std::string>& files);
+    ~TextureArray();
+
+    void bind() const;
+    bool update();
+
+    GLsizei getLayerCount() const;
+
+private:
+    // RGBA8 mip chain of one layer, level 0 first
+    struct Layer
+    {
+        GLint index;
+        std::vector<std::vector<std::uint8_t>> levels;
+    };
+
+    std::vector<std::string> mFiles;
+    GLsizei mLevels;
+    GLuint mTexture;
+    GLsizei mUploaded;
+    TileScheduler::Ptr mScheduler;
+    std::thread mLoader;
+    std::mutex mMutex;
+    // decoded by the workers, not uploaded yet
+    std::vector<Layer> mDecoded;
+private:
+    TextureArray(const TextureArray& other);
+    TextureArray& operator=(const TextureArray& other);
+    void loadLayer(unsigned int index);
+    static bool Decode(const std::string& filename, std::vector<std::uint8_t>& pixels);
+    static void Generate(unsigned int pattern, std::vector<std::uint8_t>& pixels);
+    static std::vector<std::uint8_t> Downsample(const std::vector<std::uint8_t>& pixels, GLsizei size);
+};
+
+#endif // TEXTUREARRAY_HPP
@@ -0,0 +1,227 @@
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * @brief TileScheduler::TileScheduler
+ * @param workerCount = 0, one worker per hardware thread
+ */
+TileScheduler::TileScheduler(unsigned int workerCount)
+: mJob(nullptr)
+, mTilesRemaining(0)
+, mGeneration(0)
+, mShutdown(false)
+{
+    if (workerCount == 0)
+        workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (unsigned int index = 0; index != workerCount; ++index)
+        mWorkers.emplace_back(std::make_unique<Worker>());
+
+    // start the threads once every deque exists, workers steal from each other
+    for (unsigned int index = 0; index != workerCount; ++index)
+    {
+        mWorkers.at(index)->thread = std::thread(&TileScheduler::workerLoop, this, index);
+        pinToCore(mWorkers.at(index)->thread, index);
+    }
+}
+
+/**
+ * @brief TileScheduler::~TileScheduler
+ */
+TileScheduler::~TileScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShutdown = true;
+    }
+    mWakeCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+/**
+ * Blocks until job has been called once for every tile.
+ * @brief TileScheduler::run
+ * @param tilesX
+ * @param tilesY
+ * @param job - called concurrently from the worker threads
+ */
+void TileScheduler::run(unsigned int tilesX, unsigned int tilesY, const TileJob& job)
+{
+    if (tilesX == 0 || tilesY == 0)
+        return;
+
+    std::vector<std::uint32_t> order;
+    order.reserve(tilesX * tilesY);
+    for (std::uint32_t y = 0; y != tilesY; ++y)
+        for (std::uint32_t x = 0; x != tilesX; ++x)
+            order.push_back(x | (y << 16));
+
+    std::sort(order.begin(), order.end(), [](std::uint32_t lhs, std::uint32_t rhs) {
+        return getMortonCode(lhs & 0xFFFF, lhs >> 16) < getMortonCode(rhs & 0xFFFF, rhs >> 16);
+    });
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mJob.store(&job);
+    mTilesRemaining.store(static_cast<unsigned int>(order.size()));
+
+    // contiguous runs of the curve, each worker starts on a compact block of the image
+    const std::size_t workers = mWorkers.size();
+    for (std::size_t index = 0; index != workers; ++index)
+    {
+        auto first = order.begin() + (order.size() * index) / workers;
+        auto last = order.begin() + (order.size() * (index + 1)) / workers;
+
+        std::lock_guard<std::mutex> workerLock(mWorkers.at(index)->mutex);
+        mWorkers.at(index)->tiles.assign(first, last);
+    }
+
+    ++mGeneration;
+    mWakeCondition.notify_all();
+    mDoneCondition.wait(lock, [this]() { return mTilesRemaining.load() == 0; });
+    mJob.store(nullptr);
+}
+
+/**
+ * @brief TileScheduler::getWorkerCount
+ * @return
+ */
+unsigned int TileScheduler::getWorkerCount() const
+{
+    return static_cast<unsigned int>(mWorkers.size());
+}
+
+/**
+ * Interleave the bits of x and y (16 bits each).
+ * @brief TileScheduler::getMortonCode
+ * @param x
+ * @param y
+ * @return
+ */
+std::uint32_t TileScheduler::getMortonCode(std::uint32_t x, std::uint32_t y)
+{
+    auto spread = [](std::uint32_t v) {
+        v &= 0x0000FFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+/**
+ * @brief TileScheduler::workerLoop
+ * @param index
+ */
+void TileScheduler::workerLoop(unsigned int index)
+{
+    unsigned int seenGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeCondition.wait(lock, [this, seenGeneration]() {
+                return mShutdown || mGeneration != seenGeneration;
+            });
+            if (mShutdown)
+                return;
+            seenGeneration = mGeneration;
+        }
+
+        std::uint32_t tile = 0;
+        while (popLocal(index, tile) || steal(index, tile))
+            execute(tile);
+    }
+}
+
+/**
+ * @brief TileScheduler::popLocal
+ * @param index
+ * @param tile
+ * @return false once the worker's own deque is empty
+ */
+bool TileScheduler::popLocal(unsigned int index, std::uint32_t& tile)
+{
+    Worker& worker = *mWorkers.at(index);
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tiles.empty())
+        return false;
+
+    tile = worker.tiles.front();
+    worker.tiles.pop_front();
+    return true;
+}
+
+/**
+ * Try the nearest neighbors first, their runs are closest on the curve.
+ * @brief TileScheduler::steal
+ * @param thief
+ * @param tile
+ * @return false if every deque is empty
+ */
+bool TileScheduler::steal(unsigned int thief, std::uint32_t& tile)
+{
+    const unsigned int workers = static_cast<unsigned int>(mWorkers.size());
+    for (unsigned int distance = 1; distance != workers; ++distance)
+    {
+        Worker& victim = *mWorkers.at((thief + distance) % workers);
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tiles.empty())
+            continue;
+
+        tile = victim.tiles.back();
+        victim.tiles.pop_back();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief TileScheduler::execute
+ * @param tile
+ */
+void TileScheduler::execute(std::uint32_t tile)
+{
+    const TileJob* job = mJob.load();
+    (*job)(tile & 0xFFFF, tile >> 16);
+
+    if (mTilesRemaining.fetch_sub(1) == 1)
+    {
+        // take the lock so run() can't miss the notification between its check and wait
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDoneCondition.notify_all();
+    }
+}
+
+/**
+ * @brief TileScheduler::pinToCore
+ * @param thread
+ * @param core
+ */
+void TileScheduler::pinToCore(std::thread& thread, unsigned int core)
+{
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core % CPU_SETSIZE, &cpuSet);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuSet) != 0)
+        printf("TileScheduler: could not pin worker to core %u\n", core);
+#else
+    // affinity is left to the OS scheduler
+    (void) thread;
+    (void) core;
+#endif
+}
@@ -0,0 +1,64 @@
+#ifndef TILESCHEDULER_HPP
+#define TILESCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool for CPU side tile rendering.
+ * Tiles are ordered along a Morton curve and split into contiguous runs,
+ * one deque per worker. A worker pops from the front of its own run and,
+ * once empty, steals from the back of its neighbors' runs, so both stay
+ * on nearby tiles. Workers are pinned to cores where the OS allows it.
+ * @brief The TileScheduler class
+ */
+class TileScheduler final
+{
+public:
+    typedef std::unique_ptr<TileScheduler> Ptr;
+    typedef std::function<void(unsigned int tileX, unsigned int tileY)> TileJob;
+public:
+    explicit TileScheduler(unsigned int workerCount = 0);
+    ~TileScheduler();
+
+    void run(unsigned int tilesX, unsigned int tilesY, const TileJob& job);
+
+    unsigned int getWorkerCount() const;
+
+    static std::uint32_t getMortonCode(std::uint32_t x, std::uint32_t y);
+
+private:
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        // packed tile coordinates, x | y << 16
+        std::deque<std::uint32_t> tiles;
+    };
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mWakeCondition;
+    std::condition_variable mDoneCondition;
+    std::atomic<const TileJob*> mJob;
+    std::atomic<unsigned int> mTilesRemaining;
+    unsigned int mGeneration;
+    bool mShutdown;
+private:
+    TileScheduler(const TileScheduler& other);
+    TileScheduler& operator=(const TileScheduler& other);
+    void workerLoop(unsigned int index);
+    bool popLocal(unsigned int index, std::uint32_t& tile);
+    bool steal(unsigned int thief, std::uint32_t& tile);
+    void execute(std::uint32_t tile);
+    static void pinToCore(std::thread& thread, unsigned int core);
+};
+
+#endif // TILESCHEDULER_HPP
@@ -0,0 +1,100 @@
+#include "Tlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+const GLuint Tlas::INSTANCE_SPHERE = 0;
+const GLuint Tlas::INSTANCE_MESH = 1;
+const GLuint Tlas::INSTANCE_SPHERE_TREE = 2;
+
+/**
+ * @brief Tlas::Tlas
+ * @param blas - bottom level nodes the mesh instances point into
+ */
+Tlas::Tlas(const Bvh& blas)
+: mBlas(blas)
+{
+
+}
+
+/**
+ * @brief Tlas::build
+ * @param instances - at most TOTAL_INSTANCES, the rest are dropped
+ * @param spheres - this frame's animated spheres
+ * @param block - ring buffer slot the GPU reads as TlasBuffer
+ */
+void Tlas::build(const std::vector<Instance>& instances, const SphereBlock& spheres, TlasBlock& block)
+{
+    const std::size_t count = std::min(instances.size(), static_cast<std::size_t>(TOTAL_INSTANCES));
+
+    mPrimitives.clear();
+    for (std::size_t index = 0; index != count; ++index)
+    {
+        const Instance& instance = instances.at(index);
+        Bvh::Primitive primitive;
+        getWorldBounds(instance, spheres, primitive.boundsMin, primitive.boundsMax);
+        primitive.ref = static_cast<GLuint>(index);
+        mPrimitives.push_back(primitive);
+
+        // rows of the 4x3 inverse, glm is column major
+        glm::mat4 worldToObject = glm::transpose(glm::inverse(instance.objectToWorld));
+        InstanceData& data = block.instances[index];
+        data.worldToObject[0] = worldToObject[0];
+        data.worldToObject[1] = worldToObject[1];
+        data.worldToObject[2] = worldToObject[2];
+        data.info = glm::uvec4(instance.kind, instance.index, 0, 0);
+    }
+
+    Bvh::Build(mPrimitives, mNodes, mInstanceRefs);
+
+    // a binary tree over n leaves has at most 2n - 1 nodes
+    std::memcpy(block.nodes, mNodes.data(), mNodes.size() * sizeof(BvhNodeData));
+    std::memcpy(block.instanceRefs, mInstanceRefs.data(), mInstanceRefs.size() * sizeof(GLuint));
+}
+
+/**
+ * @brief Tlas::getWorldBounds
+ * @param instance
+ * @param spheres
+ * @param boundsMin
+ * @param boundsMax
+ */
+void Tlas::getWorldBounds(const Instance& instance, const SphereBlock& spheres,
+    glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    if (instance.kind == INSTANCE_SPHERE)
+    {
+        const Sphere& sphere = spheres.spheres[instance.index];
+        boundsMin = glm::vec3(sphere.center) - glm::vec3(sphere.radius);
+        boundsMax = glm::vec3(sphere.center) + glm::vec3(sphere.radius);
+        return;
+    }
+
+    // the GPU tree is never read back, its root box is the union of the spheres written this frame
+    if (instance.kind == INSTANCE_SPHERE_TREE)
+    {
+        boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (const Sphere& sphere : spheres.spheres)
+        {
+            boundsMin = glm::min(boundsMin, glm::vec3(sphere.center) - glm::vec3(sphere.radius));
+            boundsMax = glm::max(boundsMax, glm::vec3(sphere.center) + glm::vec3(sphere.radius));
+        }
+        return;
+    }
+
+    // transform the corners of the BLAS root box
+    const BvhNodeData& root = mBlas.getNodes().at(instance.index);
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (unsigned int corner = 0; corner != 8; ++corner)
+    {
+        glm::vec3 point((corner & 1) ? root.boundsMax.x : root.boundsMin.x,
+            (corner & 2) ? root.boundsMax.y : root.boundsMin.y,
+            (corner & 4) ? root.boundsMax.z : root.boundsMin.z);
+        point = glm::vec3(instance.objectToWorld * glm::vec4(point, 1.0f));
+        boundsMin = glm::min(boundsMin, point);
+        boundsMax = glm::max(boundsMax, point);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef TLAS_HPP
+#define TLAS_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bvh.hpp"
+#include "FrameData.hpp"
+
+/**
+ * Top level acceleration structure over instances. A mesh instance is a
+ * transform plus the root of a bottom level Bvh shared by every instance of
+ * that mesh, a sphere instance points at its animated sphere. Only the
+ * instances move, so the small top level tree is rebuilt every frame into
+ * the ring buffer while the bottom level trees are built once. The sphere
+ * tree instance stands for all spheres, its BLAS is rebuilt by Lbvh.
+ * @brief The Tlas class
+ */
+class Tlas final
+{
+public:
+    typedef std::unique_ptr<Tlas> Ptr;
+    static const GLuint INSTANCE_SPHERE;
+    static const GLuint INSTANCE_MESH;
+    // every sphere at once, through the tree Lbvh builds on the GPU
+    static const GLuint INSTANCE_SPHERE_TREE;
+
+    struct Instance
+    {
+        glm::mat4 objectToWorld;
+        GLuint kind;
+        // sphere index, or root node of the BLAS
+        GLuint index;
+    };
+public:
+    explicit Tlas(const Bvh& blas);
+
+    void build(const std::vector<Instance>& instances, const SphereBlock& spheres, TlasBlock& block);
+
+private:
+    const Bvh& mBlas;
+    std::vector<Bvh::Primitive> mPrimitives;
+    std::vector<BvhNodeData> mNodes;
+    std::vector<GLuint> mInstanceRefs;
+private:
+    Tlas(const Tlas& other);
+    Tlas& operator=(const Tlas& other);
+    void getWorldBounds(const Instance& instance, const SphereBlock& spheres,
+        glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+};
+
+#endif // TLAS_HPP
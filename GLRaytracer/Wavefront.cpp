@@ -0,0 +1,211 @@
+#include "Wavefront.hpp"
+
+#include <algorithm>
+
+#include "FrameData.hpp"
+
+// should match WAVEFRONT_GROUP_SIZE in wavefront.cs.glsl and MAX_RAY_BOUNCES in scene.glsl
+const GLuint Wavefront::GROUP_SIZE = 64;
+const GLuint Wavefront::MAX_BOUNCES = 5;
+// the GL_MAX_COMPUTE_WORK_GROUP_COUNT minimum, should match WAVEFRONT_MAX_GROUPS_X in wavefront.cs.glsl
+const GLuint Wavefront::MAX_GROUPS_X = 65535;
+// should match SORT_BINS in wavefront.cs.glsl
+const GLuint Wavefront::SORT_BINS = 4096;
+
+namespace
+{
+// (groups x, groups y, groups z, count) in front of every queue
+const GLsizeiptr QUEUE_HEADER_SIZE = 4 * sizeof(GLuint);
+const GLsizeiptr QUEUED_RAY_SIZE = 2 * 4 * sizeof(GLfloat);
+const GLsizeiptr QUEUED_HIT_SIZE = 3 * 4 * sizeof(GLfloat);
+
+GLuint createQueue(GLsizeiptr elementSize, GLsizeiptr elements)
+{
+    GLuint queue = 0;
+    glGenBuffers(1, &queue);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, QUEUE_HEADER_SIZE + elementSize * elements, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return queue;
+}
+}
+
+/**
+ * Queues are sized for one entry per pixel (per light for shadows),
+ * every bounce can at most reflect each path once.
+ * @brief Wavefront::Wavefront
+ * @param width
+ * @param height
+ */
+Wavefront::Wavefront(GLsizei width, GLsizei height)
+: mWidth(width)
+, mHeight(height)
+, mSortedQueue(0)
+, mSortBins(0)
+, mHitQueue(0)
+, mShadowQueue(0)
+{
+    compileStage(mGenerate, "WAVEFRONT_GENERATE");
+    compileStage(mClosestHit, "WAVEFRONT_CLOSEST_HIT");
+    compileStage(mShadow, "WAVEFRONT_SHADOW");
+    compileStage(mShade, "WAVEFRONT_SHADE");
+    compileStage(mSortHistogram, "WAVEFRONT_SORT_HISTOGRAM");
+    compileStage(mSortScan, "WAVEFRONT_SORT_SCAN");
+    compileStage(mSortScatter, "WAVEFRONT_SORT_SCATTER");
+    mBounce = mShade.getUniform("uBounce");
+
+    const GLsizeiptr pixels = static_cast<GLsizeiptr>(mWidth) * static_cast<GLsizeiptr>(mHeight);
+    mRayQueues[0] = createQueue(QUEUED_RAY_SIZE, pixels);
+    mRayQueues[1] = createQueue(QUEUED_RAY_SIZE, pixels);
+    mHitQueue = createQueue(QUEUED_HIT_SIZE, pixels);
+    mShadowQueue = createQueue(sizeof(GLfloat), pixels * TOTAL_LIGHTS);
+    mSortedQueue = createQueue(QUEUED_RAY_SIZE, pixels);
+
+    glGenBuffers(1, &mSortBins);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSortBins);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SORT_BINS * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/**
+ * @brief Wavefront::~Wavefront
+ */
+Wavefront::~Wavefront()
+{
+    glDeleteBuffers(2, mRayQueues);
+    glDeleteBuffers(1, &mHitQueue);
+    glDeleteBuffers(1, &mShadowQueue);
+    glDeleteBuffers(1, &mSortedQueue);
+    glDeleteBuffers(1, &mSortBins);
+}
+
+/**
+ * Expects the FrameBlock UBO, the sphere SSBO and image units 0 (color)
+ * and 2 (G-buffer) to be bound already.
+ * @brief Wavefront::trace
+ * @param sortRays - sort the reflection rays of every bounce before intersecting them
+ */
+void Wavefront::trace(bool sortRays)
+{
+    // the buffer update bit orders the next queue resets after this stage's writes to the queues
+    const GLbitfield stageBarrier = GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT
+        | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+    const GLuint pixels = static_cast<GLuint>(mWidth) * static_cast<GLuint>(mHeight);
+
+    // primary rays always fill the whole screen, no need for indirect arguments, split like the queues
+    const GLuint groups = (pixels + GROUP_SIZE - 1) / GROUP_SIZE;
+    resetQueue(mRayQueues[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYS_OUT, mRayQueues[0]);
+    mGenerate.bind();
+    glDispatchCompute(std::min(groups, MAX_GROUPS_X), (groups + MAX_GROUPS_X - 1) / MAX_GROUPS_X, 1);
+    glMemoryBarrier(stageBarrier);
+
+    unsigned int in = 0;
+    for (GLuint bounce = 0; bounce != MAX_BOUNCES; ++bounce)
+    {
+        // primary rays are coherent already
+        GLuint rays = mRayQueues[in];
+        if (sortRays && bounce != 0)
+            rays = sortQueue(rays);
+
+        const unsigned int out = 1 - in;
+        resetQueue(mRayQueues[out]);
+        resetQueue(mHitQueue);
+        resetQueue(mShadowQueue);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYS_IN, rays);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYS_OUT, mRayQueues[out]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HITS, mHitQueue);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOWS, mShadowQueue);
+
+        dispatchIndirect(mClosestHit, rays);
+        glMemoryBarrier(stageBarrier);
+
+        dispatchIndirect(mShadow, mShadowQueue);
+        glMemoryBarrier(stageBarrier);
+
+        mShade.setUniform(mBounce, bounce);
+        dispatchIndirect(mShade, mHitQueue);
+        glMemoryBarrier(stageBarrier);
+
+        in = out;
+    }
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+/**
+ * @brief Wavefront::getShaders
+ * @return every stage program, for the shader hot reload
+ */
+std::vector<Shader*> Wavefront::getShaders()
+{
+    return {&mGenerate, &mClosestHit, &mShadow, &mShade, &mSortHistogram, &mSortScan, &mSortScatter};
+}
+
+/**
+ * @brief Wavefront::compileStage
+ * @param shader
+ * @param stage - the #define selecting the kernel in wavefront.cs.glsl
+ */
+void Wavefront::compileStage(Shader& shader, const std::string& stage)
+{
+    shader.addDefine(stage);
+    shader.compileAndAttachShader(ShaderTypes::COMPUTE_SHADER, SHADER_SOURCE_DIR "/wavefront.cs.glsl");
+    shader.linkProgram();
+}
+
+/**
+ * Empty queue with dispatch arguments (0, 1, 1), the stages raise x and y with atomicMax.
+ * @brief Wavefront::resetQueue
+ * @param queue
+ */
+void Wavefront::resetQueue(GLuint queue) const
+{
+    const GLuint resetArgs[4] = {0, 1, 1, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32UI, 0, QUEUE_HEADER_SIZE,
+        GL_RGBA_INTEGER, GL_UNSIGNED_INT, resetArgs);
+}
+
+/**
+ * @brief Wavefront::dispatchIndirect
+ * @param shader
+ * @param queue - one invocation per queued element
+ */
+void Wavefront::dispatchIndirect(Shader& shader, GLuint queue) const
+{
+    shader.bind();
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, queue);
+    glDispatchComputeIndirect(0);
+}
+
+/**
+ * Counting sort by (direction octant, origin Morton cell): histogram, scan, scatter.
+ * @brief Wavefront::sortQueue
+ * @param queue - rays to sort, left untouched
+ * @return mSortedQueue with the same rays and dispatch arguments
+ */
+GLuint Wavefront::sortQueue(GLuint queue)
+{
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSortBins);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYS_IN, queue);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAYS_OUT, mSortedQueue);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_BINS_BINDING, mSortBins);
+
+    dispatchIndirect(mSortHistogram, queue);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    mSortScan.bind();
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    dispatchIndirect(mSortScatter, queue);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    return mSortedQueue;
+}
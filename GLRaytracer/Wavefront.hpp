@@ -0,0 +1,72 @@
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.hpp"
+
+/**
+ * Wavefront tracer: the bounce loop of the megakernel split into
+ * generate / closest hit / shadow / shade kernels that exchange rays
+ * through SSBO queues. Each queue starts with its own indirect dispatch
+ * arguments, so only live rays are launched on later bounces.
+ * Secondary rays can be counting sorted by direction octant and origin
+ * Morton cell before intersection, so neighboring invocations traverse
+ * the scene coherently.
+ * @brief The Wavefront class
+ */
+class Wavefront final
+{
+public:
+    typedef std::unique_ptr<Wavefront> Ptr;
+    static const GLuint GROUP_SIZE;
+    static const GLuint MAX_BOUNCES;
+    static const GLuint MAX_GROUPS_X;
+    static const GLuint SORT_BINS;
+public:
+    explicit Wavefront(GLsizei width, GLsizei height);
+    ~Wavefront();
+
+    void trace(bool sortRays);
+
+    std::vector<Shader*> getShaders();
+
+private:
+    // queue bindings in wavefront.cs.glsl
+    enum QueueBinding : GLuint
+    {
+        RAYS_IN = 5,
+        RAYS_OUT = 6,
+        HITS = 7,
+        SHADOWS = 8,
+        SORT_BINS_BINDING = 10
+    };
+
+    GLsizei mWidth;
+    GLsizei mHeight;
+    Shader mGenerate;
+    Shader mClosestHit;
+    Shader mShadow;
+    Shader mShade;
+    Shader mSortHistogram;
+    Shader mSortScan;
+    Shader mSortScatter;
+    Shader::Uniform mBounce;
+    GLuint mRayQueues[2];
+    GLuint mSortedQueue;
+    GLuint mSortBins;
+    GLuint mHitQueue;
+    GLuint mShadowQueue;
+private:
+    Wavefront(const Wavefront& other);
+    Wavefront& operator=(const Wavefront& other);
+    void compileStage(Shader& shader, const std::string& stage);
+    void resetQueue(GLuint queue) const;
+    void dispatchIndirect(Shader& shader, GLuint queue) const;
+    GLuint sortQueue(GLuint queue);
+};
+
+#endif // WAVEFRONT_HPP
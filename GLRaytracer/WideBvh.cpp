@@ -0,0 +1,271 @@
+#include "WideBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const unsigned int WideBvh::WIDTH = 4;
+const GLuint WideBvh::LEAF_BIT = 0x80000000u;
+const GLuint WideBvh::LEAF_COUNT_SHIFT = 23;
+const GLuint WideBvh::LEAF_FIRST_MASK = (1u << 23) - 1u;
+const GLuint WideBvh::MAX_LEAF_COUNT = 255;
+const GLuint WideBvh::EMPTY_CHILD = 0x80000000u;
+// popping a node at depth d leaves at most 3 d siblings on the stack, then its four children
+const unsigned int WideBvh::MAX_DEPTH = (WIDE_BVH_STACK_SIZE - 1) / 3;
+
+namespace
+{
+// should match the binding in scene.glsl
+const GLuint NODE_BINDING = 26;
+const GLuint NO_NODE = 0xFFFFFFFFu;
+const float QUANTIZED_STEPS = 255.0f;
+
+bool isLeaf(const BvhNodeData& node)
+{
+    return (node.count & ~Bvh::SHADOW_RIGHT_FIRST) != 0;
+}
+
+float getSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 extent = boundsMax - boundsMin;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// same expression as the traversals, so the rounding matches
+float dequantize(float origin, float scale, GLuint q)
+{
+    return origin + static_cast<float>(q) * scale;
+}
+}
+
+/**
+ * @brief WideBvh::WideBvh
+ * @param bvh - collapsed from its root, the wide root is node 0 as well
+ */
+WideBvh::WideBvh(const Bvh& bvh)
+: mDepth(0)
+, mBuffer(0)
+{
+    mDepth = Collapse(bvh.getNodes(), mNodes);
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, mNodes.size() * sizeof(WideBvhNodeData), mNodes.data(), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/**
+ * @brief WideBvh::~WideBvh
+ */
+WideBvh::~WideBvh()
+{
+    glDeleteBuffers(1, &mBuffer);
+}
+
+/**
+ * The primitive references stay bound by the Bvh.
+ * @brief WideBvh::bind
+ */
+void WideBvh::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, mBuffer);
+}
+
+/**
+ * @brief WideBvh::getNodes
+ * @return root first
+ */
+const std::vector<WideBvhNodeData>& WideBvh::getNodes() const
+{
+    return mNodes;
+}
+
+/**
+ * Range splits of long leaves add levels the binary tree does not have,
+ * so the depth is only known once collapsed.
+ * @brief WideBvh::getDepth
+ * @return depth of the deepest node, 0 for the root alone
+ */
+unsigned int WideBvh::getDepth() const
+{
+    return mDepth;
+}
+
+/**
+ * Every wide node opens the binary interior child with the largest surface
+ * area until it holds WIDTH children or only leaves are left.
+ * @brief WideBvh::Collapse
+ * @param binary - root first, as built by Bvh::Build
+ * @param wide - root first
+ * @return depth of the deepest node
+ */
+unsigned int WideBvh::Collapse(const std::vector<BvhNodeData>& binary, std::vector<WideBvhNodeData>& wide)
+{
+    wide.clear();
+    wide.emplace_back();
+
+    // an empty tree is an interior root without children, leave every slot empty
+    if (binary.size() == 1 && !isLeaf(binary.front()))
+    {
+        Quantize(nullptr, 0, wide.front());
+        return 0;
+    }
+
+    return CollapseNode(binary, MakeChild(binary, 0), wide, 0, 0);
+}
+
+/**
+ * @brief WideBvh::CollapseNode
+ * @param binary
+ * @param parent - a binary interior node, or a reference range to split
+ * @param wide
+ * @param wideIndex - slot already allocated for parent
+ * @param depth - of wideIndex
+ * @return depth of the deepest node below wideIndex, or its own
+ */
+unsigned int WideBvh::CollapseNode(const std::vector<BvhNodeData>& binary, const Child& parent,
+    std::vector<WideBvhNodeData>& wide, GLuint wideIndex, unsigned int depth)
+{
+    Child children[4];
+    unsigned int count = 0;
+    if (parent.node != NO_NODE)
+    {
+        const BvhNodeData& node = binary.at(parent.node);
+        children[count++] = MakeChild(binary, node.leftFirst);
+        children[count++] = MakeChild(binary, node.leftFirst + 1);
+
+        while (count < WIDTH)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for (unsigned int index = 0; index != count; ++index)
+            {
+                float area = getSurfaceArea(children[index].boundsMin, children[index].boundsMax);
+                if (children[index].node != NO_NODE && area > largestArea)
+                {
+                    largest = static_cast<int>(index);
+                    largestArea = area;
+                }
+            }
+            if (largest == -1)
+                break;
+
+            const BvhNodeData& opened = binary.at(children[largest].node);
+            children[largest] = MakeChild(binary, opened.leftFirst);
+            children[count++] = MakeChild(binary, opened.leftFirst + 1);
+        }
+    }
+    else if (parent.count <= MAX_LEAF_COUNT)
+    {
+        // a root leaf, the only case where a leaf becomes a node of its own
+        children[count++] = parent;
+    }
+    else
+    {
+        // too many references for the count bits, split the range, every part keeps the whole box
+        const GLuint step = (parent.count + WIDTH - 1) / WIDTH;
+        for (GLuint first = parent.first; first < parent.first + parent.count; first += step)
+            children[count++] = {parent.boundsMin, parent.boundsMax, NO_NODE, first, std::min(step, parent.first + parent.count - first)};
+    }
+
+    WideBvhNodeData node;
+    Quantize(children, count, node);
+    for (unsigned int index = 0; index != count; ++index)
+    {
+        const Child& child = children[index];
+        if (child.node == NO_NODE && child.count <= MAX_LEAF_COUNT)
+        {
+            node.children[index] = LEAF_BIT | (child.count << LEAF_COUNT_SHIFT) | child.first;
+        }
+        else
+        {
+            node.children[index] = static_cast<GLuint>(wide.size());
+            wide.emplace_back();
+        }
+    }
+    wide.at(wideIndex) = node;
+
+    unsigned int deepest = depth;
+    for (unsigned int index = 0; index != count; ++index)
+    {
+        if ((node.children[index] & LEAF_BIT) == 0)
+            deepest = std::max(deepest, CollapseNode(binary, children[index], wide, node.children[index], depth + 1));
+    }
+    return deepest;
+}
+
+/**
+ * Conservative 8 bit child boxes: the step is rounded up until 255 steps
+ * reach the node maximum, minima round down and maxima up until the
+ * dequantized planes enclose the child.
+ * @brief WideBvh::Quantize
+ * @param children
+ * @param count - the remaining slots become EMPTY_CHILD
+ * @param node
+ */
+void WideBvh::Quantize(const Child children[], unsigned int count, WideBvhNodeData& node)
+{
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (unsigned int index = 0; index != count; ++index)
+    {
+        boundsMin = glm::min(boundsMin, children[index].boundsMin);
+        boundsMax = glm::max(boundsMax, children[index].boundsMax);
+    }
+    if (count == 0)
+        boundsMin = boundsMax = glm::vec3(0.0f);
+
+    node.origin = boundsMin;
+    for (int axis = 0; axis != 3; ++axis)
+    {
+        node.scale[axis] = (boundsMax[axis] - boundsMin[axis]) / QUANTIZED_STEPS;
+        while (dequantize(node.origin[axis], node.scale[axis], 255) < boundsMax[axis])
+            node.scale[axis] = std::nextafter(node.scale[axis], std::numeric_limits<float>::max());
+    }
+
+    GLuint quantizedMin[3] = {0, 0, 0};
+    GLuint quantizedMax[3] = {0, 0, 0};
+    for (unsigned int index = 0; index != count; ++index)
+    {
+        for (int axis = 0; axis != 3; ++axis)
+        {
+            const float origin = node.origin[axis];
+            const float scale = node.scale[axis];
+            GLuint qMin = 0, qMax = 0;
+            if (scale > 0.0f)
+            {
+                qMin = static_cast<GLuint>(std::clamp(std::floor((children[index].boundsMin[axis] - origin) / scale), 0.0f, QUANTIZED_STEPS));
+                qMax = static_cast<GLuint>(std::clamp(std::ceil((children[index].boundsMax[axis] - origin) / scale), 0.0f, QUANTIZED_STEPS));
+                while (qMin > 0 && dequantize(origin, scale, qMin) > children[index].boundsMin[axis])
+                    --qMin;
+                while (qMax < 255 && dequantize(origin, scale, qMax) < children[index].boundsMax[axis])
+                    ++qMax;
+            }
+            quantizedMin[axis] |= qMin << (8 * index);
+            quantizedMax[axis] |= qMax << (8 * index);
+        }
+    }
+
+    node.quantizedMinX = quantizedMin[0];
+    node.quantizedMinY = quantizedMin[1];
+    node.quantizedMinZ = quantizedMin[2];
+    node.quantizedMaxX = quantizedMax[0];
+    node.quantizedMaxY = quantizedMax[1];
+    node.quantizedMaxZ = quantizedMax[2];
+    for (unsigned int index = 0; index != WIDTH; ++index)
+        node.children[index] = EMPTY_CHILD;
+}
+
+/**
+ * @brief WideBvh::MakeChild
+ * @param binary
+ * @param nodeIndex
+ * @return the node's box, its reference range if it is a leaf
+ */
+WideBvh::Child WideBvh::MakeChild(const std::vector<BvhNodeData>& binary, GLuint nodeIndex)
+{
+    const BvhNodeData& node = binary.at(nodeIndex);
+    if (isLeaf(node))
+        return {node.boundsMin, node.boundsMax, NO_NODE, node.leftFirst, node.count & ~Bvh::SHADOW_RIGHT_FIRST};
+    return {node.boundsMin, node.boundsMax, nodeIndex, 0, 0};
+}
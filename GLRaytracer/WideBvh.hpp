@@ -0,0 +1,74 @@
+#ifndef WIDEBVH_HPP
+#define WIDEBVH_HPP
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bvh.hpp"
+#include "layout.glsl"
+
+// the node box minimum and one quantization step per axis, child c is
+// origin + q * scale with its 8 bit q in byte c of the quantized words
+typedef GpuLayout::WideBvhNode WideBvhNodeData;
+
+/**
+ * Four wide BVH collapsed from a binary Bvh, child boxes are stored in
+ * 8 bits per plane relative to the parent box. A node holds four child
+ * boxes in 64 bytes where the binary layout needs 32 bytes per box, and
+ * the four boxes are tested together (SSE lanes on the CPU, one loop on
+ * the GPU). Leaves keep the binary tree's primitive reference ranges, so
+ * the reference list is shared with the Bvh it was built from.
+ * @brief The WideBvh class
+ */
+class WideBvh final
+{
+public:
+    typedef std::unique_ptr<WideBvh> Ptr;
+    static const unsigned int WIDTH;
+    static const GLuint LEAF_BIT;
+    static const GLuint LEAF_COUNT_SHIFT;
+    static const GLuint LEAF_FIRST_MASK;
+    static const GLuint MAX_LEAF_COUNT;
+    // a leaf without primitives fills unused child slots
+    static const GLuint EMPTY_CHILD;
+    // deepest node the traversal stacks (WIDE_BVH_STACK_SIZE) can reach, see getDepth
+    static const unsigned int MAX_DEPTH;
+public:
+    explicit WideBvh(const Bvh& bvh);
+    ~WideBvh();
+
+    void bind() const;
+
+    const std::vector<WideBvhNodeData>& getNodes() const;
+    unsigned int getDepth() const;
+
+    static unsigned int Collapse(const std::vector<BvhNodeData>& binary, std::vector<WideBvhNodeData>& wide);
+
+private:
+    // a binary node, or a range of references too long for one leaf child
+    struct Child
+    {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // binary interior node, or NO_NODE for a reference range
+        GLuint node;
+        GLuint first;
+        GLuint count;
+    };
+
+    std::vector<WideBvhNodeData> mNodes;
+    unsigned int mDepth;
+    GLuint mBuffer;
+private:
+    WideBvh(const WideBvh& other);
+    WideBvh& operator=(const WideBvh& other);
+    static unsigned int CollapseNode(const std::vector<BvhNodeData>& binary, const Child& parent,
+        std::vector<WideBvhNodeData>& wide, GLuint wideIndex, unsigned int depth);
+    static void Quantize(const Child children[], unsigned int count, WideBvhNodeData& node);
+    static Child MakeChild(const std::vector<BvhNodeData>& binary, GLuint nodeIndex);
+};
+
+#endif // WIDEBVH_HPP
@@ -0,0 +1,244 @@
+#version 450 core
+
+#include "layout.glsl"
+#include "frame.glsl"
+#include "gbuffer.glsl"
+
+// Edge-aware denoiser for the megakernel's frames (Schied et al. 2017, "Spatiotemporal
+// Variance-Guided Filtering"). DENOISE_TEMPORAL reprojects and blends the filtered history
+// and tracks the luminance moments, DENOISE_ATROUS is one iteration of the a-trous wavelet
+// filter, run with growing steps. Both stop at edges in the G-buffer written by raytracer.cs.glsl.
+// One stage is selected with a #define, see Denoiser.cpp
+
+// This define should match Denoiser::GROUP_SIZE
+#define DENOISE_GROUP_SIZE 16
+
+// frames of history counted, the blend weight stops shrinking long before
+#define MAX_HISTORY 32.0
+
+#define EPSILON 0.001
+#define LUMINANCE vec3(0.2126, 0.7152, 0.0722)
+
+// blend floor of the new frame, keeps about five frames of history in the mix
+#define HISTORY_MIN_BLEND 0.2
+// below this many frames the variance comes from the 3x3 neighborhood instead of the moments
+#define HISTORY_MIN_FRAMES 4.0
+// relative hit distance and normal mismatch tolerated when reusing the history
+#define HISTORY_DEPTH_TOLERANCE 0.02
+#define HISTORY_NORMAL_TOLERANCE 0.9
+
+// edge stopping: relative depth per step, normal cosine power, luminance in standard deviations
+#define SIGMA_DEPTH 0.02
+#define SIGMA_NORMAL 128.0
+#define SIGMA_LUMINANCE 4.0
+
+// G-buffer: x = primary hit distance, y = object key, z = 1 if valid, w = packed normal
+layout (binding = 2, rgba32f) readonly uniform image2D uGBuffer;
+
+#if defined(DENOISE_TEMPORAL)
+
+layout (binding = 0, rgba32f) readonly uniform image2D uFramebuffer;
+layout (binding = 1, rgba32f) readonly uniform image2D uPrevHistory;
+layout (binding = 3, rgba32f) readonly uniform image2D uPrevGBuffer;
+// moments: x = luminance, y = squared luminance, z = frames of history
+layout (binding = 4, rgba32f) readonly uniform image2D uPrevMoments;
+layout (binding = 5, rgba32f) writeonly uniform image2D uMoments;
+// color and its variance, the input of the first a-trous iteration
+layout (binding = 6, rgba32f) writeonly uniform image2D uFiltered;
+
+// 1 after the denoiser was off, the history belongs to some earlier frame
+uniform uint uReset = 0u;
+
+// primary ray through a pixel, the same mapping as getPrimaryRay in raytracer.cs.glsl
+vec3 getPrimaryDirection(ivec2 pixel, ivec2 size)
+{
+	vec2 pixelPos = vec2(pixel) / vec2(size.x - 1, size.y - 1);
+	return normalize(mix(mix(uCamera.ray00, uCamera.ray01, pixelPos.y), mix(uCamera.ray10, uCamera.ray11, pixelPos.y), pixelPos.x));
+}
+
+// previous pixel of the hit if the previous G-buffer saw the same surface there
+bool reprojectHistory(vec4 gBuffer, ivec2 pixel, ivec2 size, out ivec2 prevPixel)
+{
+	prevPixel = ivec2(-1);
+
+	vec3 hitPoint = uCamera.eye + getPrimaryDirection(pixel, size) * gBuffer.x;
+	vec4 prevClip = uPrevViewProj * vec4(hitPoint, 1.0);
+	if (prevClip.w <= EPSILON)
+		return false;
+
+	vec2 prevPos = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+	prevPixel = ivec2(round(prevPos * vec2(size - 1)));
+	if (any(lessThan(prevPixel, ivec2(0))) || any(greaterThanEqual(prevPixel, size)))
+		return false;
+
+	vec4 prevGBuffer = imageLoad(uPrevGBuffer, prevPixel);
+	if (prevGBuffer.z == 0.0 || prevGBuffer.y != gBuffer.y)
+		return false;
+
+	float prevDistance = distance(uPrevEye.xyz, hitPoint);
+	if (abs(prevGBuffer.x - prevDistance) > HISTORY_DEPTH_TOLERANCE * prevDistance)
+		return false;
+
+	return dot(unpackNormal(prevGBuffer.w), unpackNormal(gBuffer.w)) > HISTORY_NORMAL_TOLERANCE;
+}
+
+// luminance variance of the 3x3 neighborhood on the same object, for young history
+float getSpatialVariance(ivec2 pixel, ivec2 size, float objectKey)
+{
+	float sum = 0.0;
+	float sumSquared = 0.0;
+	float count = 0.0;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			ivec2 neighbor = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+			if (imageLoad(uGBuffer, neighbor).y != objectKey)
+				continue;
+
+			float luminance = dot(imageLoad(uFramebuffer, neighbor).rgb, LUMINANCE);
+			sum += luminance;
+			sumSquared += luminance * luminance;
+			count += 1.0;
+		}
+	}
+
+	float mean = sum / count;
+	return max(sumSquared / count - mean * mean, 0.0);
+}
+
+layout (local_size_x = DENOISE_GROUP_SIZE, local_size_y = DENOISE_GROUP_SIZE) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(uFramebuffer);
+
+	if (pixel.x >= size.x || pixel.y >= size.y)
+		return;
+
+	vec3 color = imageLoad(uFramebuffer, pixel).rgb;
+	vec4 gBuffer = imageLoad(uGBuffer, pixel);
+
+	// background and pixels without a primary hit this frame pass through unfiltered
+	if (gBuffer.z == 0.0)
+	{
+		imageStore(uMoments, pixel, vec4(0.0));
+		imageStore(uFiltered, pixel, vec4(color, 0.0));
+		return;
+	}
+
+	float luminance = dot(color, LUMINANCE);
+	vec2 moments = vec2(luminance, luminance * luminance);
+	float history = 1.0;
+
+	ivec2 prevPixel;
+	if (uReset == 0u && reprojectHistory(gBuffer, pixel, size, prevPixel))
+	{
+		vec4 prevMoments = imageLoad(uPrevMoments, prevPixel);
+		history = min(prevMoments.z + 1.0, MAX_HISTORY);
+
+		float blend = max(1.0 / history, HISTORY_MIN_BLEND);
+		color = mix(imageLoad(uPrevHistory, prevPixel).rgb, color, blend);
+		moments = mix(prevMoments.xy, moments, blend);
+	}
+
+	float variance = (history < HISTORY_MIN_FRAMES)
+		? getSpatialVariance(pixel, size, gBuffer.y)
+		: max(moments.y - moments.x * moments.x, 0.0);
+
+	imageStore(uMoments, pixel, vec4(moments, history, 0.0));
+	imageStore(uFiltered, pixel, vec4(color, variance));
+}
+
+#elif defined(DENOISE_ATROUS)
+
+// color and variance in, filtered color and variance out
+layout (binding = 0, rgba32f) readonly uniform image2D uFilteredIn;
+layout (binding = 1, rgba32f) writeonly uniform image2D uFilteredOut;
+// the first iteration's output is the next frame's history
+layout (binding = 3, rgba32f) writeonly uniform image2D uHistory;
+
+// pixel distance between the taps, doubles every iteration
+uniform int uStep = 1;
+uniform uint uFeedback = 0u;
+
+// B3 spline weights of the 5x5 kernel, the taps are uStep apart
+const float KERNEL[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+// 3x3 gaussian of the variance, steadies the luminance edge stopping
+float getFilteredVariance(ivec2 pixel, ivec2 size)
+{
+	const float gaussian[2] = float[2](1.0 / 2.0, 1.0 / 4.0);
+	float sum = 0.0;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			ivec2 neighbor = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+			sum += imageLoad(uFilteredIn, neighbor).a * gaussian[abs(x)] * gaussian[abs(y)];
+		}
+	}
+	return sum;
+}
+
+layout (local_size_x = DENOISE_GROUP_SIZE, local_size_y = DENOISE_GROUP_SIZE) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(uFilteredIn);
+
+	if (pixel.x >= size.x || pixel.y >= size.y)
+		return;
+
+	vec4 center = imageLoad(uFilteredIn, pixel);
+	vec4 gBuffer = imageLoad(uGBuffer, pixel);
+
+	if (gBuffer.z == 0.0)
+	{
+		imageStore(uFilteredOut, pixel, center);
+		if (uFeedback != 0u)
+			imageStore(uHistory, pixel, vec4(center.rgb, 1.0));
+		return;
+	}
+
+	vec3 normal = unpackNormal(gBuffer.w);
+	float luminance = dot(center.rgb, LUMINANCE);
+	float luminanceSigma = SIGMA_LUMINANCE * sqrt(getFilteredVariance(pixel, size)) + EPSILON;
+	float depthSigma = SIGMA_DEPTH * gBuffer.x * float(uStep) + EPSILON;
+
+	vec3 color = center.rgb * (KERNEL[0] * KERNEL[0]);
+	float variance = center.a * (KERNEL[0] * KERNEL[0]) * (KERNEL[0] * KERNEL[0]);
+	float weightSum = KERNEL[0] * KERNEL[0];
+
+	for (int y = -2; y <= 2; ++y)
+	{
+		for (int x = -2; x <= 2; ++x)
+		{
+			ivec2 tap = pixel + ivec2(x, y) * uStep;
+			if ((x == 0 && y == 0) || any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size)))
+				continue;
+
+			// other objects and the background never bleed in
+			vec4 tapGBuffer = imageLoad(uGBuffer, tap);
+			if (tapGBuffer.z == 0.0 || tapGBuffer.y != gBuffer.y)
+				continue;
+
+			vec4 tapColor = imageLoad(uFilteredIn, tap);
+			float depthWeight = abs(tapGBuffer.x - gBuffer.x) / depthSigma;
+			float luminanceWeight = abs(dot(tapColor.rgb, LUMINANCE) - luminance) / luminanceSigma;
+			float normalWeight = pow(max(dot(unpackNormal(tapGBuffer.w), normal), 0.0), SIGMA_NORMAL);
+
+			float weight = KERNEL[abs(x)] * KERNEL[abs(y)] * normalWeight * exp(-depthWeight - luminanceWeight);
+			color += tapColor.rgb * weight;
+			variance += tapColor.a * weight * weight;
+			weightSum += weight;
+		}
+	}
+
+	vec4 filtered = vec4(color / weightSum, variance / (weightSum * weightSum));
+	imageStore(uFilteredOut, pixel, filtered);
+	if (uFeedback != 0u)
+		imageStore(uHistory, pixel, vec4(filtered.rgb, 1.0));
+}
+
+#endif
@@ -0,0 +1,39 @@
+// Foveated ray budget, shared by raytracer.cs.glsl and reconstruct.cs.glsl.
+// Around the focus every pixel is traced, farther out one pixel of each 2x2 and then of each
+// 4x4 block, the traced pixel of a block cycles with the frame index. The strides nest inside
+// 4x4 blocks and each 4x4 block takes one stride, so a block's traced pixel always has its stride.
+// fovea is the uFovea uniform: x, y = focus pixel, z = inner radius, w = outer radius, in pixels
+
+#ifndef FOVEA_GLSL
+#define FOVEA_GLSL
+
+#define FOVEA_BLOCK 4
+
+// bounces traced from the middle ring and the periphery, the center keeps MAX_RAY_BOUNCES
+#define FOVEA_MIDDLE_BOUNCES 2
+#define FOVEA_OUTER_BOUNCES 1
+
+// 1, 2 or 4 pixels between traced pixels, from the distance of the pixel's 4x4 block to the focus
+int getFoveaStride(ivec2 pixel, vec4 fovea)
+{
+	vec2 blockCenter = vec2((pixel / FOVEA_BLOCK) * FOVEA_BLOCK) + 0.5 * float(FOVEA_BLOCK);
+	float dist = distance(blockCenter, fovea.xy);
+	if (dist <= fovea.z)
+		return 1;
+	return (dist <= fovea.w) ? 2 : FOVEA_BLOCK;
+}
+
+// offset of the traced pixel in every stride x stride block this frame
+ivec2 getFoveaOffset(int stride, uint frameIndex)
+{
+	int cell = int(frameIndex % uint(stride * stride));
+	return ivec2(cell % stride, cell / stride);
+}
+
+bool isFoveaTraced(ivec2 pixel, vec4 fovea, uint frameIndex)
+{
+	int stride = getFoveaStride(pixel, fovea);
+	return all(equal(pixel % stride, getFoveaOffset(stride, frameIndex)));
+}
+
+#endif // FOVEA_GLSL
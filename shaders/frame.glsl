@@ -0,0 +1,20 @@
+// The per-frame uniform block, shared by scene.glsl (both trace kernels) and denoise.cs.glsl.
+// Needs layout.glsl for the structs and MAX_LIGHTS.
+
+#ifndef FRAME_GLSL
+#define FRAME_GLSL
+
+// per-frame data, streamed through a persistently mapped ring buffer (see FrameData.hpp)
+layout (std140, binding = 2) uniform FrameBlock {
+	Camera uCamera;
+	Plane uPlane;
+	Light uLights[MAX_LIGHTS];
+	float uTime;
+	mat4 uPrevViewProj;
+	vec4 uPrevEye;
+	// x = render flags, y = frame index, z = temporal refresh period, w = frames accumulated
+	uvec4 uSettings;
+	Material uMeshMaterial;
+};
+
+#endif // FRAME_GLSL
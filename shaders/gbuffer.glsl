@@ -0,0 +1,27 @@
+// G-buffer normal encoding, written by raytracer.cs.glsl and read back by denoise.cs.glsl.
+
+#ifndef GBUFFER_GLSL
+#define GBUFFER_GLSL
+
+// octahedral normal, 12 bits per axis, exactly representable in a float channel like the object key in raytracer.cs.glsl
+float packNormal(vec3 normal)
+{
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+	vec2 oct = (normal.z >= 0.0) ? normal.xy
+		: (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	uvec2 quantized = uvec2(round(clamp(oct * 0.5 + 0.5, 0.0, 1.0) * 4095.0));
+	return float(quantized.x * 4096u + quantized.y);
+}
+
+// inverse of packNormal
+vec3 unpackNormal(float packedNormal)
+{
+	uint bits = uint(packedNormal);
+	vec2 oct = vec2(float(bits / 4096u), float(bits % 4096u)) / 4095.0 * 2.0 - 1.0;
+	vec3 normal = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	if (normal.z < 0.0)
+		normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(normal);
+}
+
+#endif // GBUFFER_GLSL
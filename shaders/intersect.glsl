@@ -0,0 +1,449 @@
+// Ray - scene intersection shared by raytracer.cs.glsl and wavefront.cs.glsl: the box,
+// triangle and sphere tests, the BLAS, wide BLAS and TLAS walks, the closest hit query and the
+// any-hit query of the shadow rays. Needs layout.glsl and scene.glsl.
+
+#ifndef INTERSECT_GLSL
+#define INTERSECT_GLSL
+
+// slab test, entry distance or tMax when the box is missed
+float intersectBounds(vec3 origin, vec3 invDir, vec3 boundsMin, vec3 boundsMax, float tMax)
+{
+	vec3 t0 = (boundsMin - origin) * invDir;
+	vec3 t1 = (boundsMax - origin) * invDir;
+	vec3 tNear = min(t0, t1);
+	vec3 tFar = max(t0, t1);
+	float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+	float tExit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+	return (tEnter <= tExit) ? tEnter : tMax;
+}
+
+// Moller-Trumbore in object space, both windings, negative on a miss
+float triangleIntersect(uint triangle, Ray theRay)
+{
+	vec3 v0 = bMeshVertices[bMeshIndices[triangle * 3u]].xyz;
+	vec3 edge1 = bMeshVertices[bMeshIndices[triangle * 3u + 1u]].xyz - v0;
+	vec3 edge2 = bMeshVertices[bMeshIndices[triangle * 3u + 2u]].xyz - v0;
+
+	vec3 p = cross(theRay.direction, edge2);
+	float det = dot(edge1, p);
+	if (abs(det) < 1e-8)
+		return -1.0;
+
+	float invDet = 1.0 / det;
+	vec3 s = theRay.origin - v0;
+	float u = dot(s, p) * invDet;
+	if (u < 0.0 || u > 1.0)
+		return -1.0;
+
+	vec3 q = cross(s, edge1);
+	float v = dot(theRay.direction, q) * invDet;
+	if (v < 0.0 || u + v > 1.0)
+		return -1.0;
+
+	return dot(edge2, q) * invDet;
+}
+
+// flat world space normal of instance << MESH_INSTANCE_SHIFT | triangle, flipped towards the ray by the caller
+vec3 getTriangleNormal(uint packedTriangle)
+{
+	uint triangle = packedTriangle & MESH_TRIANGLE_MASK;
+	Instance instance = bInstances[packedTriangle >> MESH_INSTANCE_SHIFT];
+	vec3 v0 = bMeshVertices[bMeshIndices[triangle * 3u]].xyz;
+	vec3 v1 = bMeshVertices[bMeshIndices[triangle * 3u + 1u]].xyz;
+	vec3 v2 = bMeshVertices[bMeshIndices[triangle * 3u + 2u]].xyz;
+	vec3 normal = cross(v1 - v0, v2 - v0);
+
+	// normals go through the inverse transpose, the transpose of worldToObject
+	return normalize(instance.worldToObject[0].xyz * normal.x + instance.worldToObject[1].xyz * normal.y + instance.worldToObject[2].xyz * normal.z);
+}
+
+// distance to a sphere, negative on a miss
+float sphereHit(Sphere sphere, Ray theRay)
+{
+	vec3 diff = theRay.origin - sphere.center;
+	float b = dot(theRay.direction, diff);
+	float c = dot(diff, diff) - sphere.radius * sphere.radius;
+	float discriminant = b * b - c;
+	if (discriminant < 0.0)
+		return -1.0;
+
+	// near root, or the far one when the origin is inside the sphere
+	float root = sqrt(discriminant);
+	return (-b - root > EPSILON) ? -b - root : -b + root;
+}
+
+// the direction is not renormalized, so t along the object space ray stays a world space distance
+Ray toObjectSpace(Instance instance, Ray theRay)
+{
+	vec4 origin = vec4(theRay.origin, 1.0);
+	return Ray(vec3(dot(instance.worldToObject[0], origin), dot(instance.worldToObject[1], origin), dot(instance.worldToObject[2], origin)),
+		vec3(dot(instance.worldToObject[0].xyz, theRay.direction), dot(instance.worldToObject[1].xyz, theRay.direction), dot(instance.worldToObject[2].xyz, theRay.direction)));
+}
+
+// the sphere tree shares the BLAS traversal, only the nodes and the leaf test differ
+BvhNode getBlasNode(uint index, bool sphereTree)
+{
+	return sphereTree ? bSphereTreeNodes[index] : bBvhNodes[index];
+}
+
+uint getBlasPrimitive(uint index, bool sphereTree)
+{
+	return sphereTree ? bSphereTreeRefs[index] : bBvhPrimitives[index];
+}
+
+float blasPrimitiveHit(uint primitive, Ray objectRay, bool sphereTree)
+{
+	return sphereTree ? sphereHit(bSpheres[primitive], objectRay) : triangleIntersect(primitive, objectRay);
+}
+
+// closest triangle (or sphere) of the BLAS at root, nearest child first
+void intersectBlas(Ray objectRay, uint root, bool sphereTree, inout float tClosest, inout int primitive)
+{
+	vec3 invDir = 1.0 / objectRay.direction;
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0u;
+	stack[stackSize++] = root;
+
+	while (stackSize != 0u)
+	{
+		BvhNode node = getBlasNode(stack[--stackSize], sphereTree);
+		if (intersectBounds(objectRay.origin, invDir, node.boundsMin, node.boundsMax, tClosest) >= tClosest)
+			continue;
+
+		uint count = node.count & ~BVH_SHADOW_RIGHT_FIRST;
+		if (count != 0u)
+		{
+			for (uint i = node.leftFirst; i != node.leftFirst + count; ++i)
+			{
+				uint candidate = getBlasPrimitive(i, sphereTree);
+				float t = blasPrimitiveHit(candidate, objectRay, sphereTree);
+				if (t > EPSILON && t < tClosest)
+				{
+					tClosest = t;
+					primitive = int(candidate);
+				}
+			}
+			continue;
+		}
+
+		uint nearChild = node.leftFirst;
+		uint farChild = node.leftFirst + 1u;
+		BvhNode nearNode = getBlasNode(nearChild, sphereTree);
+		BvhNode farNode = getBlasNode(farChild, sphereTree);
+		float tNear = intersectBounds(objectRay.origin, invDir, nearNode.boundsMin, nearNode.boundsMax, tClosest);
+		float tFar = intersectBounds(objectRay.origin, invDir, farNode.boundsMin, farNode.boundsMax, tClosest);
+		if (tFar < tNear)
+		{
+			nearChild = farChild;
+			farChild = node.leftFirst;
+			float swapT = tNear;
+			tNear = tFar;
+			tFar = swapT;
+		}
+
+		// the far child goes first so the near one is popped next
+		if (tFar < tClosest)
+			stack[stackSize++] = farChild;
+		if (tNear < tClosest)
+			stack[stackSize++] = nearChild;
+	}
+}
+
+// entry distance into child c of a wide node, tMax when it is missed
+float intersectWideChild(WideBvhNode node, uint child, vec3 origin, vec3 invDir, float tMax)
+{
+	uint shift = 8u * child;
+	uvec3 quantizedMin = (uvec3(node.quantizedMinX, node.quantizedMinY, node.quantizedMinZ) >> shift) & 0xFFu;
+	uvec3 quantizedMax = (uvec3(node.quantizedMaxX, node.quantizedMaxY, node.quantizedMaxZ) >> shift) & 0xFFu;
+	return intersectBounds(origin, invDir, node.origin + vec3(quantizedMin) * node.scale, node.origin + vec3(quantizedMax) * node.scale, tMax);
+}
+
+// closest triangle of the wide BLAS at root, hit interior children are pushed far to near
+void intersectWideBlas(Ray objectRay, uint root, inout float tClosest, inout int triangle)
+{
+	vec3 invDir = 1.0 / objectRay.direction;
+	uint stack[WIDE_BVH_STACK_SIZE];
+	uint stackSize = 0u;
+	stack[stackSize++] = root;
+
+	while (stackSize != 0u)
+	{
+		WideBvhNode node = bWideBvhNodes[stack[--stackSize]];
+		uint hitChildren[4];
+		float hitT[4];
+		uint hitCount = 0u;
+
+		for (uint child = 0u; child != 4u; ++child)
+		{
+			float tEnter = intersectWideChild(node, child, objectRay.origin, invDir, tClosest);
+			if (tEnter >= tClosest)
+				continue;
+
+			uint encoded = node.children[child];
+			if ((encoded & WIDE_BVH_LEAF) != 0u)
+			{
+				uint first = encoded & WIDE_BVH_LEAF_FIRST_MASK;
+				uint count = (encoded & ~WIDE_BVH_LEAF) >> WIDE_BVH_LEAF_COUNT_SHIFT;
+				for (uint i = first; i != first + count; ++i)
+				{
+					float t = triangleIntersect(bBvhPrimitives[i], objectRay);
+					if (t > EPSILON && t < tClosest)
+					{
+						tClosest = t;
+						triangle = int(bBvhPrimitives[i]);
+					}
+				}
+				continue;
+			}
+
+			// insertion sort, farthest first so the nearest is popped next
+			uint slot = hitCount++;
+			while (slot != 0u && hitT[slot - 1u] < tEnter)
+			{
+				hitT[slot] = hitT[slot - 1u];
+				hitChildren[slot] = hitChildren[slot - 1u];
+				--slot;
+			}
+			hitT[slot] = tEnter;
+			hitChildren[slot] = encoded;
+		}
+
+		for (uint i = 0u; i != hitCount; ++i)
+			stack[stackSize++] = hitChildren[i];
+	}
+}
+
+// any triangle of the wide BLAS at root between EPSILON and maxDist
+bool isWideBlasOccluded(Ray objectRay, uint root, float maxDist)
+{
+	vec3 invDir = 1.0 / objectRay.direction;
+	uint stack[WIDE_BVH_STACK_SIZE];
+	uint stackSize = 0u;
+	stack[stackSize++] = root;
+
+	while (stackSize != 0u)
+	{
+		WideBvhNode node = bWideBvhNodes[stack[--stackSize]];
+		for (uint child = 0u; child != 4u; ++child)
+		{
+			if (intersectWideChild(node, child, objectRay.origin, invDir, maxDist) >= maxDist)
+				continue;
+
+			uint encoded = node.children[child];
+			if ((encoded & WIDE_BVH_LEAF) == 0u)
+			{
+				stack[stackSize++] = encoded;
+				continue;
+			}
+
+			uint first = encoded & WIDE_BVH_LEAF_FIRST_MASK;
+			uint count = (encoded & ~WIDE_BVH_LEAF) >> WIDE_BVH_LEAF_COUNT_SHIFT;
+			for (uint i = first; i != first + count; ++i)
+			{
+				float t = triangleIntersect(bBvhPrimitives[i], objectRay);
+				if (t > EPSILON && t < maxDist)
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// any triangle (or sphere) of the BLAS at root between EPSILON and maxDist, larger child first
+bool isBlasOccluded(Ray objectRay, uint root, bool sphereTree, float maxDist)
+{
+	vec3 invDir = 1.0 / objectRay.direction;
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0u;
+	stack[stackSize++] = root;
+
+	while (stackSize != 0u)
+	{
+		BvhNode node = getBlasNode(stack[--stackSize], sphereTree);
+		if (intersectBounds(objectRay.origin, invDir, node.boundsMin, node.boundsMax, maxDist) >= maxDist)
+			continue;
+
+		uint count = node.count & ~BVH_SHADOW_RIGHT_FIRST;
+		if (count != 0u)
+		{
+			for (uint i = node.leftFirst; i != node.leftFirst + count; ++i)
+			{
+				float t = blasPrimitiveHit(getBlasPrimitive(i, sphereTree), objectRay, sphereTree);
+				if (t > EPSILON && t < maxDist)
+					return true;
+			}
+			continue;
+		}
+
+		bool rightFirst = (node.count & BVH_SHADOW_RIGHT_FIRST) != 0u;
+		stack[stackSize++] = rightFirst ? node.leftFirst : node.leftFirst + 1u;
+		stack[stackSize++] = rightFirst ? node.leftFirst + 1u : node.leftFirst;
+	}
+
+	return false;
+}
+
+/**
+*   Closest hit: walk the TLAS over the instances nearest child first, spheres are tested
+*   in place, mesh instances continue into their BLAS with the ray in object space and
+*   the sphere tree instance into the GPU built LBVH. Without spheres only the mesh
+*   instances are visited, primary rays have tested their tile's spheres already.
+*   The plane is infinite and tested last.
+*/
+float findObjectIntersection(Ray theRay, inout int intersectObjectID, inout int objArrayIndex, float farPlane, bool spheres)
+{
+	float tClosest = farPlane;
+	vec3 invDir = 1.0 / theRay.direction;
+
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0u;
+	if (intersectBounds(theRay.origin, invDir, bTlasNodes[0].boundsMin, bTlasNodes[0].boundsMax, tClosest) < tClosest)
+		stack[stackSize++] = 0u;
+
+	while (stackSize != 0u)
+	{
+		BvhNode node = bTlasNodes[stack[--stackSize]];
+		uint count = node.count & ~BVH_SHADOW_RIGHT_FIRST;
+		if (count != 0u)
+		{
+			for (uint i = node.leftFirst; i != node.leftFirst + count; ++i)
+			{
+				uint instanceIndex = bTlasInstances[i];
+				Instance instance = bInstances[instanceIndex];
+				if (!spheres && instance.info.x != INSTANCE_MESH)
+					continue;
+
+				if (instance.info.x == INSTANCE_SPHERE)
+				{
+					float t = sphereHit(bSpheres[instance.info.y], theRay);
+					if (t > EPSILON && t < tClosest)
+					{
+						tClosest = t;
+						intersectObjectID = SPHERE_ID;
+						objArrayIndex = int(instance.info.y);
+					}
+					continue;
+				}
+
+				// the sphere tree instance is in world space, its transform is the identity
+				int primitive = -1;
+				bool sphereTree = instance.info.x == INSTANCE_SPHERE_TREE;
+				if (!sphereTree && (uSettings.x & RENDER_WIDE_BVH) != 0u)
+					intersectWideBlas(toObjectSpace(instance, theRay), instance.info.y, tClosest, primitive);
+				else
+					intersectBlas(toObjectSpace(instance, theRay), instance.info.y, sphereTree, tClosest, primitive);
+				if (primitive != -1 && sphereTree)
+				{
+					intersectObjectID = SPHERE_ID;
+					objArrayIndex = primitive;
+				}
+				else if (primitive != -1)
+				{
+					intersectObjectID = TRIANGLE_ID;
+					objArrayIndex = int((instanceIndex << MESH_INSTANCE_SHIFT) | uint(primitive));
+				}
+			}
+			continue;
+		}
+
+		uint nearChild = node.leftFirst;
+		uint farChild = node.leftFirst + 1u;
+		float tNear = intersectBounds(theRay.origin, invDir, bTlasNodes[nearChild].boundsMin, bTlasNodes[nearChild].boundsMax, tClosest);
+		float tFar = intersectBounds(theRay.origin, invDir, bTlasNodes[farChild].boundsMin, bTlasNodes[farChild].boundsMax, tClosest);
+		if (tFar < tNear)
+		{
+			nearChild = farChild;
+			farChild = node.leftFirst;
+			float swapT = tNear;
+			tNear = tFar;
+			tFar = swapT;
+		}
+
+		// the far child goes first so the near one is popped next
+		if (tFar < tClosest)
+			stack[stackSize++] = farChild;
+		if (tNear < tClosest)
+			stack[stackSize++] = nearChild;
+	}
+
+	// t = [norm dot ( point - ray.origin )] / [norm dot ray.dir]
+	float a = dot(uPlane.normal, theRay.direction);
+	if (a != 0.0)
+	{
+		float tPlane = dot(uPlane.normal, uPlane.point - theRay.origin) / a;
+		if (tPlane > EPSILON && tPlane < tClosest)
+		{
+			tClosest = tPlane;
+			intersectObjectID = PLANE_ID;
+		}
+	}
+
+	return tClosest;
+}
+
+/**
+*   Any-hit occlusion query for shadow rays: true as soon as anything lies between
+*   EPSILON and maxDist along the ray. The plane costs one dot product so it goes first,
+*   then the TLAS and the BLAS of each mesh instance are walked larger child first
+*   (BVH_SHADOW_RIGHT_FIRST) so likely occluders exit early. Without spheres only the
+*   plane and the meshes are tested, the analytic shadows cover the spheres.
+*/
+bool isOccluded(Ray theRay, float maxDist, bool spheres)
+{
+	float a = dot(uPlane.normal, theRay.direction);
+	if (a != 0.0)
+	{
+		float tPlane = dot(uPlane.normal, uPlane.point - theRay.origin) / a;
+		if (tPlane > EPSILON && tPlane < maxDist)
+			return true;
+	}
+
+	vec3 invDir = 1.0 / theRay.direction;
+	uint stack[BVH_STACK_SIZE];
+	uint stackSize = 0u;
+	stack[stackSize++] = 0u;
+
+	while (stackSize != 0u)
+	{
+		BvhNode node = bTlasNodes[stack[--stackSize]];
+		if (intersectBounds(theRay.origin, invDir, node.boundsMin, node.boundsMax, maxDist) >= maxDist)
+			continue;
+
+		uint count = node.count & ~BVH_SHADOW_RIGHT_FIRST;
+		if (count != 0u)
+		{
+			for (uint i = node.leftFirst; i != node.leftFirst + count; ++i)
+			{
+				Instance instance = bInstances[bTlasInstances[i]];
+				if (!spheres && instance.info.x != INSTANCE_MESH)
+					continue;
+
+				if (instance.info.x == INSTANCE_SPHERE)
+				{
+					float t = sphereHit(bSpheres[instance.info.y], theRay);
+					if (t > EPSILON && t < maxDist)
+						return true;
+				}
+				else if (instance.info.x == INSTANCE_MESH && (uSettings.x & RENDER_WIDE_BVH) != 0u)
+				{
+					if (isWideBlasOccluded(toObjectSpace(instance, theRay), instance.info.y, maxDist))
+						return true;
+				}
+				else if (isBlasOccluded(toObjectSpace(instance, theRay), instance.info.y, instance.info.x == INSTANCE_SPHERE_TREE, maxDist))
+				{
+					return true;
+				}
+			}
+			continue;
+		}
+
+		bool rightFirst = (node.count & BVH_SHADOW_RIGHT_FIRST) != 0u;
+		stack[stackSize++] = rightFirst ? node.leftFirst : node.leftFirst + 1u;
+		stack[stackSize++] = rightFirst ? node.leftFirst + 1u : node.leftFirst;
+	}
+
+	return false;
+}
+
+#endif // INTERSECT_GLSL
@@ -0,0 +1,160 @@
+// Structs shared by the C++ host code and the compute shaders, the single definition of
+// their layout. C++ includes this file through FrameData.hpp and friends, the shaders
+// #include it right after the #version line (resolved by ShaderSource).
+//
+// Every member is laid out explicitly so std140 and std430 agree with the C++ layout:
+// a vec3 is always followed by a scalar (or padding) filling its 16 byte slot, and every
+// struct is padded to a multiple of 16 bytes. Padding arrays are avoided, std140 would
+// round each element up to 16 bytes. The static_asserts at the end check the result.
+
+#ifndef LAYOUT_GLSL
+#define LAYOUT_GLSL
+
+#define MAX_SPHERES 20
+#define MAX_LIGHTS 5
+// spheres and mesh instances together
+#define MAX_INSTANCES 64
+// traversal stacks, Bvh::MAX_DEPTH and WideBvh::MAX_DEPTH keep the trees within them
+#define BVH_STACK_SIZE 32
+#define WIDE_BVH_STACK_SIZE 64
+
+#ifdef __cplusplus
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// std140 / std430 base alignment of a struct holding a vec3 or vec4
+#define GPU_STRUCT(name) struct alignas(16) name
+
+namespace GpuLayout
+{
+typedef GLuint uint;
+typedef glm::vec3 vec3;
+typedef glm::vec4 vec4;
+typedef glm::uvec4 uvec4;
+#else
+#define GPU_STRUCT(name) struct name
+#endif
+
+// https://github.com/LWJGL/lwjgl3-wiki/wiki/2.6.1.-Ray-tracing-with-OpenGL-Compute-Shaders-%28Part-I%29
+GPU_STRUCT(Camera) {
+	vec3 eye;
+	float far;
+	vec3 ray00;
+	float padding0;
+	vec3 ray01;
+	float padding1;
+	vec3 ray10;
+	float padding2;
+	vec3 ray11;
+	float padding3;
+};
+
+GPU_STRUCT(Material) {
+	vec3 ambient;
+	float padding0;
+	vec3 diffuse;
+	float padding1;
+	vec3 specular;
+	float shininess;
+	float reflective;
+	// layer in the TextureArray scaling ambient and diffuse, negative for none
+	float textureLayer;
+	float padding3;
+	float padding4;
+};
+
+GPU_STRUCT(Plane) {
+	Material material;
+	vec3 point;
+	float padding0;
+	vec3 normal;
+	float padding1;
+};
+
+// w = 0 means directional, w = 1 means point light
+GPU_STRUCT(Light) {
+	vec4 position;
+	vec3 ambient;
+	float padding0;
+	vec3 diffuse;
+	float padding1;
+	vec3 specular;
+	float padding2;
+};
+
+// all an intersection reads, the material is looked up through MaterialBuffer on the closest hit
+GPU_STRUCT(Sphere) {
+	vec3 center;
+	float radius;
+};
+
+// static point lights, xyz = position, w = radius beyond which the light contributes nothing
+GPU_STRUCT(PointLight) {
+	vec4 position;
+	vec4 color;
+};
+
+// interior: children at leftFirst and leftFirst + 1, leaf: count primitive references from leftFirst,
+// the high bit of count is Bvh::SHADOW_RIGHT_FIRST (see Bvh.hpp)
+GPU_STRUCT(BvhNode) {
+	vec3 boundsMin;
+	uint leftFirst;
+	vec3 boundsMax;
+	uint count;
+};
+
+// the 4x3 affine world to object transform as three rows
+GPU_STRUCT(Instance) {
+	vec4 worldToObject[3];
+	// x = Tlas::INSTANCE_SPHERE / INSTANCE_MESH / INSTANCE_SPHERE_TREE, y = sphere index or BLAS root node
+	uvec4 info;
+};
+
+// the mesh BLAS collapsed to four children per node, child c is origin + q * scale with its
+// 8 bit q in byte c of the quantized words (see WideBvh.hpp)
+GPU_STRUCT(WideBvhNode) {
+	vec3 origin;
+	uint quantizedMinX;
+	vec3 scale;
+	uint quantizedMinY;
+	uint quantizedMinZ;
+	uint quantizedMaxX;
+	uint quantizedMaxY;
+	uint quantizedMaxZ;
+	// interior: node index, leaf: WideBvh::LEAF_BIT | count << LEAF_COUNT_SHIFT | first reference
+	uvec4 children;
+};
+
+#ifdef __cplusplus
+} // namespace GpuLayout
+
+// std140 and std430 give the same offsets for all of the above
+static_assert(sizeof(GpuLayout::Camera) == 80 && alignof(GpuLayout::Camera) == 16, "Camera layout");
+static_assert(offsetof(GpuLayout::Camera, ray00) == 16 && offsetof(GpuLayout::Camera, ray11) == 64, "Camera layout");
+static_assert(sizeof(GpuLayout::Material) == 64 && alignof(GpuLayout::Material) == 16, "Material layout");
+static_assert(offsetof(GpuLayout::Material, diffuse) == 16 && offsetof(GpuLayout::Material, specular) == 32
+    && offsetof(GpuLayout::Material, shininess) == 44 && offsetof(GpuLayout::Material, reflective) == 48
+    && offsetof(GpuLayout::Material, textureLayer) == 52, "Material layout");
+static_assert(sizeof(GpuLayout::Plane) == 96 && alignof(GpuLayout::Plane) == 16, "Plane layout");
+static_assert(offsetof(GpuLayout::Plane, point) == 64 && offsetof(GpuLayout::Plane, normal) == 80, "Plane layout");
+static_assert(sizeof(GpuLayout::Light) == 64 && alignof(GpuLayout::Light) == 16, "Light layout");
+static_assert(offsetof(GpuLayout::Light, ambient) == 16 && offsetof(GpuLayout::Light, diffuse) == 32
+    && offsetof(GpuLayout::Light, specular) == 48, "Light layout");
+static_assert(sizeof(GpuLayout::Sphere) == 16 && alignof(GpuLayout::Sphere) == 16, "Sphere layout");
+static_assert(offsetof(GpuLayout::Sphere, radius) == 12, "Sphere layout");
+static_assert(sizeof(GpuLayout::PointLight) == 32 && alignof(GpuLayout::PointLight) == 16, "PointLight layout");
+static_assert(sizeof(GpuLayout::BvhNode) == 32 && alignof(GpuLayout::BvhNode) == 16, "BvhNode layout");
+static_assert(offsetof(GpuLayout::BvhNode, leftFirst) == 12 && offsetof(GpuLayout::BvhNode, boundsMax) == 16
+    && offsetof(GpuLayout::BvhNode, count) == 28, "BvhNode layout");
+static_assert(sizeof(GpuLayout::Instance) == 64 && alignof(GpuLayout::Instance) == 16, "Instance layout");
+static_assert(offsetof(GpuLayout::Instance, info) == 48, "Instance layout");
+static_assert(sizeof(GpuLayout::WideBvhNode) == 64 && alignof(GpuLayout::WideBvhNode) == 16, "WideBvhNode layout");
+static_assert(offsetof(GpuLayout::WideBvhNode, scale) == 16 && offsetof(GpuLayout::WideBvhNode, quantizedMinY) == 28
+    && offsetof(GpuLayout::WideBvhNode, quantizedMaxZ) == 44 && offsetof(GpuLayout::WideBvhNode, children) == 48, "WideBvhNode layout");
+#endif
+
+#undef GPU_STRUCT
+
+#endif // LAYOUT_GLSL
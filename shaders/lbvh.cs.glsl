@@ -0,0 +1,367 @@
+#version 450 core
+
+#include "layout.glsl"
+
+// Linear BVH over the animated spheres, rebuilt on the GPU every frame (Karras 2012).
+// Every pass is one kernel selected with a define (see Lbvh.cpp):
+//   LBVH_SCENE_BOUNDS   - bounds of the sphere centers, one atomic per work group
+//   LBVH_MORTON         - 30 bit Morton code of each center inside those bounds
+//   LBVH_SORT_HISTOGRAM - per work group counts of the current radix digit
+//   LBVH_SORT_SCAN      - exclusive scan of the digit major counts, a single work group
+//   LBVH_SORT_SCATTER   - stable scatter of the (code, sphere) pairs to their sorted slots
+//   LBVH_HIERARCHY      - one internal node per invocation from the sorted codes
+//   LBVH_BOUNDS         - leaves to root, the second child to arrive at a node fits it
+
+// These defines should match Lbvh::GROUP_SIZE and Lbvh::RADIX_BITS
+#define LBVH_GROUP_SIZE 256u
+#define RADIX_BITS 4u
+#define RADIX_DIGITS 16u
+
+// This define should match Bvh::SHADOW_RIGHT_FIRST
+#define BVH_SHADOW_RIGHT_FIRST 0x80000000u
+#define NO_PARENT 0xFFFFFFFFu
+
+uniform uint uCount;
+uniform uint uShift;
+
+layout (std430, binding = 1) readonly buffer SphereBuffer {
+	Sphere bSpheres[];
+};
+
+// Output, same layout as Bvh. Internal node i keeps its children in slots 2i + 1 and 2i + 2
+// so both are adjacent without a global allocator, leaves hold a single sorted sphere.
+layout (std430, binding = 19) coherent buffer SphereTreeNodes {
+	BvhNode bSphereTreeNodes[];
+};
+
+layout (std430, binding = 20) writeonly buffer SphereTreeRefs {
+	uint bSphereTreeRefs[];
+};
+
+// (Morton code, sphere index) pairs, ping-ponged by the sort passes
+layout (std430, binding = 21) readonly buffer LbvhPairsIn {
+	uvec2 bPairsIn[];
+};
+
+layout (std430, binding = 22) writeonly buffer LbvhPairsOut {
+	uvec2 bPairsOut[];
+};
+
+layout (std430, binding = 23) coherent buffer LbvhScratch {
+	// order preserving bits of the center bounds, min xyz then max xyz
+	uint bSceneBounds[8];
+	// children arrived at each internal node during the bounds pass
+	uint bVisits[];
+};
+
+// x = parent internal node, y = output slot; internal nodes first, then the leaves
+layout (std430, binding = 24) buffer LbvhLinks {
+	uvec2 bLinks[];
+};
+
+// digit major: all work groups of digit 0, then digit 1, ...
+layout (std430, binding = 25) buffer LbvhDigitCounts {
+	uint bDigitCounts[];
+};
+
+// float bits that compare like the floats they encode
+uint floatToOrdered(float value)
+{
+	uint bits = floatBitsToUint(value);
+	return ((bits & 0x80000000u) != 0u) ? ~bits : bits | 0x80000000u;
+}
+
+float orderedToFloat(uint bits)
+{
+	return uintBitsToFloat(((bits & 0x80000000u) != 0u) ? bits & 0x7FFFFFFFu : ~bits);
+}
+
+// 10 bits spread out to every third bit
+uint expandBits(uint v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+layout (local_size_x = LBVH_GROUP_SIZE) in;
+
+#if defined(LBVH_SCENE_BOUNDS)
+
+shared vec3 sMin[LBVH_GROUP_SIZE];
+shared vec3 sMax[LBVH_GROUP_SIZE];
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationIndex;
+
+	// out of range invocations repeat the first sphere, which changes nothing
+	vec3 center = bSpheres[(index < uCount) ? index : 0u].center;
+	sMin[local] = center;
+	sMax[local] = center;
+	barrier();
+
+	for (uint stride = LBVH_GROUP_SIZE / 2u; stride > 0u; stride >>= 1u)
+	{
+		if (local < stride)
+		{
+			sMin[local] = min(sMin[local], sMin[local + stride]);
+			sMax[local] = max(sMax[local], sMax[local + stride]);
+		}
+		barrier();
+	}
+
+	if (local == 0u)
+	{
+		atomicMin(bSceneBounds[0], floatToOrdered(sMin[0].x));
+		atomicMin(bSceneBounds[1], floatToOrdered(sMin[0].y));
+		atomicMin(bSceneBounds[2], floatToOrdered(sMin[0].z));
+		atomicMax(bSceneBounds[3], floatToOrdered(sMax[0].x));
+		atomicMax(bSceneBounds[4], floatToOrdered(sMax[0].y));
+		atomicMax(bSceneBounds[5], floatToOrdered(sMax[0].z));
+	}
+}
+
+#elif defined(LBVH_MORTON)
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= uCount)
+		return;
+
+	vec3 sceneMin = vec3(orderedToFloat(bSceneBounds[0]), orderedToFloat(bSceneBounds[1]), orderedToFloat(bSceneBounds[2]));
+	vec3 sceneMax = vec3(orderedToFloat(bSceneBounds[3]), orderedToFloat(bSceneBounds[4]), orderedToFloat(bSceneBounds[5]));
+	vec3 cell = clamp((bSpheres[index].center - sceneMin) / max(sceneMax - sceneMin, vec3(1e-6)), 0.0, 1.0) * 1023.0;
+
+	uint code = (expandBits(uint(cell.x)) << 2u) | (expandBits(uint(cell.y)) << 1u) | expandBits(uint(cell.z));
+	bPairsOut[index] = uvec2(code, index);
+}
+
+#elif defined(LBVH_SORT_HISTOGRAM)
+
+shared uint sCounts[RADIX_DIGITS];
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationIndex;
+
+	if (local < RADIX_DIGITS)
+		sCounts[local] = 0u;
+	barrier();
+
+	if (index < uCount)
+		atomicAdd(sCounts[(bPairsIn[index].x >> uShift) & (RADIX_DIGITS - 1u)], 1u);
+	barrier();
+
+	if (local < RADIX_DIGITS)
+		bDigitCounts[local * gl_NumWorkGroups.x + gl_WorkGroupID.x] = sCounts[local];
+}
+
+#elif defined(LBVH_SORT_SCAN)
+
+shared uint sSums[LBVH_GROUP_SIZE];
+
+void main()
+{
+	uint local = gl_LocalInvocationIndex;
+	uint total = RADIX_DIGITS * ((uCount + LBVH_GROUP_SIZE - 1u) / LBVH_GROUP_SIZE);
+	uint perInvocation = (total + LBVH_GROUP_SIZE - 1u) / LBVH_GROUP_SIZE;
+	uint first = min(local * perInvocation, total);
+	uint last = min(first + perInvocation, total);
+
+	// each invocation owns a contiguous run of counts
+	uint sum = 0u;
+	for (uint i = first; i != last; ++i)
+		sum += bDigitCounts[i];
+
+	sSums[local] = sum;
+	barrier();
+
+	// inclusive Hillis-Steele scan over the run totals
+	for (uint offset = 1u; offset < LBVH_GROUP_SIZE; offset <<= 1u)
+	{
+		uint add = (local >= offset) ? sSums[local - offset] : 0u;
+		barrier();
+		sSums[local] += add;
+		barrier();
+	}
+
+	uint running = sSums[local] - sum;
+	for (uint i = first; i != last; ++i)
+	{
+		uint count = bDigitCounts[i];
+		bDigitCounts[i] = running;
+		running += count;
+	}
+}
+
+#elif defined(LBVH_SORT_SCATTER)
+
+shared uint sDigits[LBVH_GROUP_SIZE];
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationIndex;
+
+	uvec2 pair = uvec2(0u);
+	uint digit = RADIX_DIGITS;
+	if (index < uCount)
+	{
+		pair = bPairsIn[index];
+		digit = (pair.x >> uShift) & (RADIX_DIGITS - 1u);
+	}
+	sDigits[local] = digit;
+	barrier();
+
+	if (index >= uCount)
+		return;
+
+	// stable: same digit pairs earlier in the group keep their order
+	uint rank = 0u;
+	for (uint i = 0u; i != local; ++i)
+		rank += (sDigits[i] == digit) ? 1u : 0u;
+
+	bPairsOut[bDigitCounts[digit * gl_NumWorkGroups.x + gl_WorkGroupID.x] + rank] = pair;
+}
+
+#elif defined(LBVH_HIERARCHY)
+
+// length of the common prefix of the sorted codes at i and j, -1 out of range,
+// equal codes fall back to their indices so every key is unique. The prefix grows strictly
+// from a node to its children, which bounds the depth (see getMaxDepth in Lbvh.cpp)
+int commonPrefix(int i, int j)
+{
+	if (j < 0 || j >= int(uCount))
+		return -1;
+
+	uint codeI = bPairsIn[i].x;
+	uint codeJ = bPairsIn[j].x;
+	if (codeI != codeJ)
+		return 31 - findMSB(codeI ^ codeJ);
+	return 32 + 31 - findMSB(uint(i ^ j));
+}
+
+// writes the link and the leftFirst / count of child (leaf or internal) into its slot
+void emitChild(uint parent, uint child, bool leaf, uint slot)
+{
+	if (leaf)
+	{
+		bLinks[uCount - 1u + child] = uvec2(parent, slot);
+		bSphereTreeNodes[slot].leftFirst = child;
+		bSphereTreeNodes[slot].count = 1u;
+	}
+	else
+	{
+		bLinks[child] = uvec2(parent, slot);
+		bVisits[child] = 0u;
+		bSphereTreeNodes[slot].leftFirst = 2u * child + 1u;
+		bSphereTreeNodes[slot].count = 0u;
+	}
+}
+
+void main()
+{
+	int i = int(gl_GlobalInvocationID.x);
+
+	// a single sphere is a lone leaf at the root
+	if (uCount == 1u)
+	{
+		if (i == 0)
+			emitChild(NO_PARENT, 0u, true, 0u);
+		return;
+	}
+
+	if (i >= int(uCount) - 1)
+		return;
+
+	// direction of the range, towards the neighbor sharing the longer prefix
+	int direction = (commonPrefix(i, i + 1) - commonPrefix(i, i - 1) >= 0) ? 1 : -1;
+	int minPrefix = commonPrefix(i, i - direction);
+
+	// upper bound of the range length, then binary search for its end
+	int maxLength = 2;
+	while (commonPrefix(i, i + maxLength * direction) > minPrefix)
+		maxLength *= 2;
+
+	int length = 0;
+	for (int step = maxLength / 2; step >= 1; step /= 2)
+	{
+		if (commonPrefix(i, i + (length + step) * direction) > minPrefix)
+			length += step;
+	}
+	int j = i + length * direction;
+
+	// split where the prefix of the whole range ends
+	int nodePrefix = commonPrefix(i, j);
+	int split = 0;
+	int step = length;
+	do
+	{
+		step = (step + 1) / 2;
+		if (split + step < length && commonPrefix(i, i + (split + step) * direction) > nodePrefix)
+			split += step;
+	} while (step > 1);
+	uint gamma = uint(i + split * direction + min(direction, 0));
+
+	uint node = uint(i);
+	if (node == 0u)
+	{
+		bLinks[0] = uvec2(NO_PARENT, 0u);
+		bVisits[0] = 0u;
+		bSphereTreeNodes[0].leftFirst = 1u;
+		bSphereTreeNodes[0].count = 0u;
+	}
+	emitChild(node, gamma, uint(min(i, j)) == gamma, 2u * node + 1u);
+	emitChild(node, gamma + 1u, uint(max(i, j)) == gamma + 1u, 2u * node + 2u);
+}
+
+#elif defined(LBVH_BOUNDS)
+
+float surfaceArea(BvhNode node)
+{
+	vec3 extent = node.boundsMax - node.boundsMin;
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+void main()
+{
+	uint leaf = gl_GlobalInvocationID.x;
+	if (leaf >= uCount)
+		return;
+
+	uint sphere = bPairsIn[leaf].y;
+	bSphereTreeRefs[leaf] = sphere;
+
+	uvec2 link = bLinks[uCount - 1u + leaf];
+	vec3 center = bSpheres[sphere].center;
+	float radius = bSpheres[sphere].radius;
+	bSphereTreeNodes[link.y].boundsMin = center - vec3(radius);
+	bSphereTreeNodes[link.y].boundsMax = center + vec3(radius);
+
+	// the first child to arrive stops, the second sees both boxes and climbs on
+	uint parent = link.x;
+	while (parent != NO_PARENT)
+	{
+		memoryBarrierBuffer();
+		if (atomicAdd(bVisits[parent], 1u) == 0u)
+			return;
+		memoryBarrierBuffer();
+
+		BvhNode left = bSphereTreeNodes[2u * parent + 1u];
+		BvhNode right = bSphereTreeNodes[2u * parent + 2u];
+		uvec2 parentLink = bLinks[parent];
+		bSphereTreeNodes[parentLink.y].boundsMin = min(left.boundsMin, right.boundsMin);
+		bSphereTreeNodes[parentLink.y].boundsMax = max(left.boundsMax, right.boundsMax);
+		bSphereTreeNodes[parentLink.y].count = (surfaceArea(right) > surfaceArea(left)) ? BVH_SHADOW_RIGHT_FIRST : 0u;
+
+		parent = parentLink.x;
+	}
+}
+
+#endif
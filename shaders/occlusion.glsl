@@ -0,0 +1,96 @@
+// Analytic visibility terms for sphere occluders, shared by raytracer.cs.glsl and wavefront.cs.glsl.
+// A light is seen as a cap of directions around the direction to it, an occluding sphere as
+// another cap, the visible part of the light is what the sphere's cap leaves uncovered. Closed
+// form, so the penumbra is smooth without extra shadow rays. Needs layout.glsl for Sphere.
+
+#ifndef OCCLUSION_GLSL
+#define OCCLUSION_GLSL
+
+#define OCCLUSION_TWO_PI 6.28318531
+
+// half angle of the directional lights' cap, in radians
+#define DIRECTIONAL_LIGHT_ANGLE 0.06
+// radius of the point lights' emitting sphere, their influence radius is separate
+#define POINT_LIGHT_SOURCE_RADIUS 1.5
+// spheres covering less than this angle (radius / distance) can't darken a light noticeably
+#define MIN_OCCLUDER_SIZE 0.002
+
+// cosine of the light's cap as seen from lightDist away
+float getLightCapCosine(bool directional, float lightDist)
+{
+	if (directional)
+		return cos(DIRECTIONAL_LIGHT_ANGLE);
+
+	float sinCap = min(POINT_LIGHT_SOURCE_RADIUS / lightDist, 1.0);
+	return sqrt(1.0 - sinCap * sinCap);
+}
+
+/**
+*   Solid angle shared by two caps from their cosines and the cosine between their axes,
+*   the lens area is fitted with a smoothstep (Oat and Sander 2007, "Ambient Aperture Lighting").
+*/
+float getCapIntersection(float cosCap1, float cosCap2, float cosDistance)
+{
+	float r1 = acos(cosCap1);
+	float r2 = acos(cosCap2);
+	float d = acos(clamp(cosDistance, -1.0, 1.0));
+	float smallerCap = OCCLUSION_TWO_PI * (1.0 - max(cosCap1, cosCap2));
+
+	// one cap inside the other
+	if (min(r1, r2) <= max(r1, r2) - d)
+		return smallerCap;
+	// disjoint
+	if (r1 + r2 <= d)
+		return 0.0;
+
+	float delta = abs(r1 - r2);
+	float x = 1.0 - clamp((d - delta) / max(r1 + r2 - delta, 0.0001), 0.0, 1.0);
+	return smallerCap * smoothstep(0.0, 1.0, x);
+}
+
+// whether sphere may shadow or occlude anything above the tangent plane at point
+bool isOccluderCandidate(Sphere sphere, vec3 point, vec3 normal)
+{
+	vec3 toSphere = sphere.center - point;
+	return dot(toSphere, normal) > -sphere.radius && sphere.radius > MIN_OCCLUDER_SIZE * length(toSphere);
+}
+
+// fraction of the light's cap (around lightDir, lightDist away) the sphere leaves visible from point
+float getSphereLightVisibility(Sphere sphere, vec3 point, vec3 lightDir, float lightDist, float cosLight)
+{
+	vec3 toSphere = sphere.center - point;
+	float dist = length(toSphere);
+	// behind the light, or the point is inside
+	if (dist - sphere.radius >= lightDist || dist <= sphere.radius)
+		return 1.0;
+
+	float sinSphere = sphere.radius / dist;
+	float cosSphere = sqrt(1.0 - sinSphere * sinSphere);
+	float lightCap = OCCLUSION_TWO_PI * (1.0 - cosLight);
+	return 1.0 - getCapIntersection(cosLight, cosSphere, dot(toSphere / dist, lightDir)) / lightCap;
+}
+
+/**
+*   Cosine weighted part of the hemisphere above (point, normal) the sphere covers, exact while
+*   the sphere is above the horizon and approximated while it crosses it
+*   (Quilez, "sphere ambient occlusion").
+*/
+float getSphereOcclusion(Sphere sphere, vec3 point, vec3 normal)
+{
+	vec3 toSphere = sphere.center - point;
+	float dist = length(toSphere);
+	if (dist <= sphere.radius)
+		return 1.0;
+
+	float cosNormal = dot(normal, toSphere / dist);
+	float h = dist / sphere.radius;
+	float h2 = h * h;
+	if (1.0 - h2 * cosNormal * cosNormal > 0.001)
+	{
+		float crossing = (cosNormal * h + 1.0) / h2;
+		return clamp(0.33 * crossing * crossing, 0.0, 1.0);
+	}
+	return clamp(cosNormal / h2, 0.0, 1.0);
+}
+
+#endif // OCCLUSION_GLSL
@@ -1,210 +1,198 @@
 #version 450 core
 
-// These defines should match the Compute.cpp source
-#define MAX_SPHERES 20
-#define MAX_LIGHTS 5
-#define SPHERE_ID 0
-#define PLANE_ID 1
-#define EPSILON 0.001
-#define CHECKER_SQUARE_SIZE 0.05
-#define MAX_RAY_BOUNCES 5
+#include "layout.glsl"
+#include "scene.glsl"
+#include "intersect.glsl"
+#include "occlusion.glsl"
+#include "shading.glsl"
+#include "fovea.glsl"
+#include "texture.glsl"
+#include "gbuffer.glsl"
+
 #define BACKGROUND_COLOR vec3(0.25, 0.05, 0.45)
 
-layout (binding = 0, rgba32f) uniform image2D uFramebuffer;
+// These defines should match Compute::TRACE_PASS_* and Compute::LOCAL_GROUP_SIZE
+#define TRACE_PASS_PRIMARY 0u
+#define TRACE_PASS_ADAPTIVE 1u
+#define TRACE_PASS_PERSISTENT 2u
+#define TILE_SIZE 20
 
-struct Light {
-	vec4 position;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
+// This define should match spherebin.cs.glsl
+#define TILE_SPHERE_STRIDE (MAX_SPHERES + 1)
 
-struct Material {
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float shininess;
-	float reflective;
-};
+// jittered samples added to each pixel of a high variance tile
+#define ADAPTIVE_SAMPLES 4
 
-// FIXED: Sphere struct now matches C++ Sphere.hpp layout exactly
-struct Sphere {
-	vec4 center;
-	vec4 ambient;
-	vec4 diffuse;
-	vec4 specular;
-	float radius;
-	float radius2;
-	float shininess;
-	float reflectivity;
-};
+#define LUMINANCE vec3(0.2126, 0.7152, 0.0722)
 
-struct Plane {
-	Material material;
-	vec3 point;
-	vec3 normal;
-};
+// relative hit distance mismatch tolerated when reusing the previous frame
+#define TEMPORAL_DEPTH_TOLERANCE 0.02
 
-// https://github.com/LWJGL/lwjgl3-wiki/wiki/2.6.1.-Ray-tracing-with-OpenGL-Compute-Shaders-%28Part-I%29
-struct Camera {
-	vec3 eye;
-	float far;
-	vec3 ray00;
-	vec3 ray01;
-	vec3 ray10;
-	vec3 ray11;
+layout (binding = 0, rgba32f) uniform image2D uFramebuffer;
+layout (binding = 1, rgba32f) readonly uniform image2D uPrevFramebuffer;
+// G-buffer: x = primary hit distance, y = object key, z = 1 if valid, w = packed normal (see packNormal)
+layout (binding = 2, rgba32f) writeonly uniform image2D uGBuffer;
+layout (binding = 3, rgba32f) readonly uniform image2D uPrevGBuffer;
+
+uniform uint uPass = TRACE_PASS_PRIMARY;
+// focus pixel and ring radii of the foveated mode, see fovea.glsl
+uniform vec4 uFovea = vec4(0.0);
+
+// filled by variance.cs.glsl, the header doubles as the glDispatchComputeIndirect arguments
+layout (std430, binding = 4) readonly buffer TileWorkList {
+	uint bNumTiles;
+	uint bNumGroupsY;
+	uint bNumGroupsZ;
+	uint bPadding;
+	uint bTiles[];
 };
 
-struct Ray {
-	vec3 origin;
-	vec3 direction;
+// persistent threads: next tile to trace, reset to 0 before each dispatch
+layout (std430, binding = 9) buffer TileCounter {
+	uint bNextTile;
 };
 
-// the uniforms
-uniform float uTime = 1.0f;
-uniform Camera uCamera;
-uniform Plane uPlane;
-uniform Sphere uSpheres[MAX_SPHERES];
-uniform Light uLights[MAX_LIGHTS];
+shared uint sTile;
 
-// this is an SSBO - CRITICAL: Now uses bSpheres for all sphere data
-layout (std430, binding = 1) buffer SphereBuffer {
-	Sphere bSpheres[MAX_SPHERES];
+// per screen tile sphere count and indices, binned by spherebin.cs.glsl before the primary trace
+layout (std430, binding = 27) readonly buffer TileSphereLists {
+	uint bTileSpheres[];
 };
 
-bool sphereIntersect(in Sphere sphere, in Ray theRay, inout float t0, inout float t1)
-{
-	vec3 dir = theRay.direction;
-	vec3 diff = theRay.origin - sphere.center.xyz;
+// candidates of the work group's screen tiles for the primary rays, as in SphereBuffer,
+// a checkerboard work group covers two tiles so there is room for both lists
+shared Sphere sTileSpheres[2 * MAX_SPHERES];
+shared int sTileSphereIndices[2 * MAX_SPHERES];
+shared uint sTileSphereCount;
 
-	// quadratic formula
-	//float a = dot(dir, dir);
-	float b = 2.0 * dot(dir, diff);
-	float c = dot(diff, diff) - sphere.radius2;
+// pixel this invocation shades, differs from gl_GlobalInvocationID in checkerboard mode
+ivec2 gPixel;
+// bounces traceRay may follow, lowered away from the focus in foveated mode
+int gBounceBudget = MAX_RAY_BOUNCES;
 
-	float discriminant = (b * b) - (4.0 * c);
-
-	if (discriminant < 0)
-		return false;
-	else
-	{
-		if (discriminant == 0)
-			t0 = (-1 * b - sqrt(discriminant)) / 2.0;
-		else
-			t0 = min((-1 * b - sqrt(discriminant)) / 2.0, (-1 * b + sqrt(discriminant)) / 2.0);
-		return true;
-	}
+float rand(vec2 co)
+{
+	return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 47236.4343);
 }
 
-// t = [norm dot ( point - ray.dir )] / [norm dot ray.dir]
-bool planeIntersect(in Plane plane, in Ray theRay, inout float t0, inout float t1)
+// w=0 means directional, w=1 means point light
+vec3 getLightDir(Light light, vec3 intPoint)
 {
-	float a = dot(plane.normal, theRay.direction);
-	if (a == 0)
-	{
-		// ray is parallel to plane
-		return false;
-	}
+	if (light.position.w == 0.0)
+		return normalize(vec3(light.position.xyz));
 	else
-	{
-		float b = dot(plane.normal, plane.point - theRay.origin);
-		float tHit = b / a;
-
-		t0 = tHit;
-		return true;
-	}
+		return normalize(vec3(light.position.xyz - intPoint));
 }
 
-Material checkerboardPlaneMaterial(in vec3 intersectPoint)
+// directional lights are infinitely far, anything up to the far plane occludes them
+float getLightDistance(Light light, vec3 intPoint)
 {
-	const int square = int(floor(intersectPoint.x * CHECKER_SQUARE_SIZE) + floor(intersectPoint.z * CHECKER_SQUARE_SIZE));
+	return (light.position.w == 0.0) ? uCamera.far : length(light.position.xyz - intPoint);
+}
 
-	Material planeMaterial = uPlane.material;
+// shadowed diffuse + specular of one directional light, the ambient term is added by the caller
+vec3 shadeDirectionalLight(Light light, vec3 intPoint, vec3 intNormal, vec3 viewDir, Material material)
+{
+	Ray lightRay = Ray(intPoint + (intNormal * EPSILON), getLightDir(light, intPoint));
+	float visibility = getLightVisibility(intPoint, intNormal, lightRay.direction, getLightDistance(light, intPoint), light.position.w == 0.0);
+	float shadow = getShadowFactor(visibility);
 
-	if(square % 2 == 0) {
-		return planeMaterial;
-	}
-	else {
-		// black square
-		planeMaterial.ambient = vec3(0.01f, 0.01f, 0.01f);
-		planeMaterial.diffuse = vec3(0.01f, 0.01f, 0.01f);
-		planeMaterial.specular = vec3(0.01f, 0.01f, 0.01f);
-		return planeMaterial;
-	}
+	light.ambient = vec3(0.0);
+	return phongShading(light, material, viewDir, lightRay.direction, intNormal, reflect(lightRay.direction, intNormal), shadow);
 }
 
 /**
-*   Calculate the rendering equation using Phong shading algorithm.
-*   color = ambient + (shadow * (diffuse + specular));
+*   Pick a single light, directional or from the point light grid cell, with probability
+*   proportional to its unshadowed luminance * cosine (* falloff), and cast one shadow ray.
+*   Dividing by the selection probability keeps the estimate unbiased.
 */
-vec3 phongShading(Light light, Material material, vec3 viewDir, vec3 lightDir, vec3 intNormal, vec3 reflectDir, float shadow)
+vec3 sampleOneLight(vec3 intPoint, vec3 intNormal, vec3 viewDir, Material material, float u, float occlusion)
 {
-	vec3 diffuse, specular, ambient;
-	ambient = light.ambient * 0.01f;//material.ambient;
-	diffuse = light.diffuse * material.diffuse * max(dot(lightDir, intNormal), 0);
-	specular = light.specular * material.specular * max(pow(dot(viewDir, reflectDir), material.shininess), 0);
-	return (shadow * (diffuse + specular)) + ambient;
-}
+	vec3 ambient = vec3(0.0);
+	float totalWeight = 0.0;
+	for (int i = 0; i != MAX_LIGHTS; ++i)
+	{
+		ambient += uLights[i].ambient * 0.01f * occlusion;
+		totalWeight += dot(uLights[i].diffuse + uLights[i].specular, LUMINANCE) * max(dot(getLightDir(uLights[i], intPoint), intNormal), 0.0);
+	}
 
-float findObjectIntersection(Ray theRay, inout int intersectObjectID, inout int objArrayIndex, float farPlane, bool endEarly)
-{
-	float t0, t1, tClosest = farPlane;
+	uvec2 cell = uvec2(0u);
+	if ((uSettings.x & RENDER_POINT_LIGHTS) == 0u || !getLightCell(intPoint, cell))
+		cell = uvec2(0u);
 
-	for (int i = 0; i != MAX_SPHERES; ++i)
+	for (uint i = cell.x; i != cell.x + cell.y; ++i)
 	{
-		t0 = t1 = uCamera.far;
-		if (sphereIntersect(bSpheres[i], theRay, t0, t1) && (t0 > EPSILON))
-		{
-			if (endEarly)
-			{
-				intersectObjectID = SPHERE_ID;
-				objArrayIndex = i;
-				return tClosest;
-			}
-			else if (!endEarly && t0 < tClosest)
-			{
-				intersectObjectID = SPHERE_ID;
-				objArrayIndex = i;
-				tClosest = t0;
-			}
-		}
+		PointLight light = bPointLights[bLightIndices[i]];
+		vec3 toLight = light.position.xyz - intPoint;
+		float falloff = max(1.0 - length(toLight) / light.position.w, 0.0);
+		totalWeight += dot(light.color.rgb, LUMINANCE) * max(dot(normalize(toLight), intNormal), 0.0) * falloff * falloff;
 	}
 
-	t0 = t1 = tClosest;
-	if (planeIntersect(uPlane, theRay, t0, t1) && (t0 > EPSILON) && (t0 < tClosest))
+	if (totalWeight <= 0.0)
+		return ambient;
+
+	// walk the same candidates again until the sampled weight is used up
+	float target = u * totalWeight;
+	for (int i = 0; i != MAX_LIGHTS; ++i)
 	{
-		tClosest = t0;
-		intersectObjectID = PLANE_ID;
-		if (endEarly)
-			return tClosest;
+		float weight = dot(uLights[i].diffuse + uLights[i].specular, LUMINANCE) * max(dot(getLightDir(uLights[i], intPoint), intNormal), 0.0);
+		if (weight > 0.0 && target < weight)
+			return ambient + shadeDirectionalLight(uLights[i], intPoint, intNormal, viewDir, material) * (totalWeight / weight);
+		target -= weight;
 	}
 
-	return tClosest;
-}
+	for (uint i = cell.x; i != cell.x + cell.y; ++i)
+	{
+		PointLight light = bPointLights[bLightIndices[i]];
+		vec3 toLight = light.position.xyz - intPoint;
+		float dist = length(toLight);
+		float falloff = max(1.0 - dist / light.position.w, 0.0);
+		float weight = dot(light.color.rgb, LUMINANCE) * max(dot(toLight / dist, intNormal), 0.0) * falloff * falloff;
+		if (weight > 0.0 && target < weight)
+		{
+			float visibility = getLightVisibility(intPoint, intNormal, toLight / dist, dist, false);
+			if (visibility <= 0.0)
+				return ambient;
+
+			vec3 reflectDir = reflect(toLight / dist, intNormal);
+			vec3 shaded = material.diffuse * dot(toLight / dist, intNormal)
+				+ material.specular * pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+			return ambient + light.color.rgb * shaded * falloff * falloff * visibility * (totalWeight / weight);
+		}
+		target -= weight;
+	}
 
-float rand(vec2 co)
-{
-	return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 47236.4343);
+	return ambient;
 }
 
 // the bread and butter of the raytracer, compute a pixel color for this ray
-vec3 traceRay(inout Ray theRay)
+// the primary hit is found by the caller and passed in to avoid intersecting twice
+vec3 traceRay(inout Ray theRay, float primaryT, int primaryObjectID, int primaryIndex)
 {
 	vec3 finalColor = vec3(0.0f);
 	float colorFrac = 0.999f;
 
-	for (int i = 0; i != MAX_RAY_BOUNCES; ++i)
+	// angle covered by a pixel and the distance travelled, their product sizes the texture footprint
+	float pixelAngle = length(uCamera.ray10 - uCamera.ray00) / (length(uCamera.ray00) * float(imageSize(uFramebuffer).x));
+	float pathLength = 0.0;
+
+	for (int i = 0; i != gBounceBudget; ++i)
 	{
 		// find the closest ray-object intersection
-		bool endEarly = false;
-		int objArrayIndex = -1;
-		int intersectObjectID = -1;
-		float tClosest = findObjectIntersection(theRay, intersectObjectID, objArrayIndex, uCamera.far, endEarly);
+		int objArrayIndex = primaryIndex;
+		int intersectObjectID = primaryObjectID;
+		float tClosest = primaryT;
+		if (i != 0)
+		{
+			objArrayIndex = -1;
+			intersectObjectID = -1;
+			tClosest = findObjectIntersection(theRay, intersectObjectID, objArrayIndex, uCamera.far, true);
+		}
 
 		if (intersectObjectID == -1)
 		{
 			// No intersection - render gradient background
-			vec2 coords = vec2(gl_GlobalInvocationID.xy);
+			vec2 coords = vec2(gPixel);
 			vec2 size = vec2(imageSize(uFramebuffer));
 
 			float r = float(coords.x) / float(size.x);
@@ -219,24 +207,32 @@ vec3 traceRay(inout Ray theRay)
 		vec3 intPoint = vec3(theRay.origin + (theRay.direction * tClosest));
 		vec3 intNormal;
 		float reflValue;
+		pathLength += tClosest;
 
 		Material activeMaterial;
 		if (intersectObjectID == SPHERE_ID)
 		{
-			// Create material from sphere's direct fields (no nested Material struct)
-			activeMaterial = Material(bSpheres[objArrayIndex].ambient.xyz,
-								bSpheres[objArrayIndex].diffuse.xyz,
-								bSpheres[objArrayIndex].specular.xyz,
-								bSpheres[objArrayIndex].shininess,
-								bSpheres[objArrayIndex].reflectivity);
-			intNormal = normalize(vec3(intPoint - bSpheres[objArrayIndex].center.xyz));
-			reflValue = bSpheres[objArrayIndex].reflectivity;
+			activeMaterial = bMaterials[bSphereMaterials[objArrayIndex]];
+			intNormal = normalize(vec3(intPoint - bSpheres[objArrayIndex].center));
+			reflValue = activeMaterial.reflective;
+			activeMaterial = applyTexture(activeMaterial, getSphereUV(intNormal), pathLength * pixelAngle,
+				1.0 / (TEXTURE_TWO_PI * bSpheres[objArrayIndex].radius));
+		}
+		else if (intersectObjectID == TRIANGLE_ID)
+		{
+			activeMaterial = uMeshMaterial;
+			intNormal = getTriangleNormal(uint(objArrayIndex));
+			reflValue = uMeshMaterial.reflective;
 		}
 		else if (intersectObjectID == PLANE_ID)
 		{
 			intNormal = uPlane.normal;
 			reflValue = uPlane.material.reflective;
-			activeMaterial = checkerboardPlaneMaterial(intPoint);
+			// a textured plane replaces the checkerboard
+			if (uPlane.material.textureLayer < 0.0)
+				activeMaterial = checkerboardPlaneMaterial(intPoint);
+			else
+				activeMaterial = applyTexture(uPlane.material, getPlaneUV(intPoint), pathLength * pixelAngle, PLANE_TEXTURE_SCALE);
 		}
 
 		// make sure we didn't intersect from inside the active obj
@@ -245,38 +241,29 @@ vec3 traceRay(inout Ray theRay)
 
 		vec3 localColor = vec3(0.0);
 
-		// now iterate through the lights and look for shadows
-		for (int i = 0; i != MAX_LIGHTS; ++i)
+		// the spheres shadowing this hit, shared by all of its lights
+		float occlusion = 1.0;
+		if ((uSettings.x & RENDER_ANALYTIC_SHADOWS) != 0u)
 		{
-			float shadow = 1.0f;
-			Light activeLight = uLights[i];
-
-			vec3 lightDir;
-			// FIXED: w=0 means directional, w=1 means point light
-			if (activeLight.position.w == 0.0)
-				lightDir = normalize(vec3(activeLight.position.xyz));
-			else
-				lightDir = normalize(vec3(activeLight.position.xyz - intPoint));
-
-			Ray lightRay = Ray(intPoint + (intNormal * EPSILON), lightDir);
-
-			// Shadow ray testing
-			endEarly = true;
-			intersectObjectID = -1;
-			objArrayIndex = -1;
-			tClosest = findObjectIntersection(lightRay, intersectObjectID, objArrayIndex, length(lightDir), endEarly);
-
-			// FIXED: Removed duplicate sphereIntersect check
-			if (intersectObjectID != -1)
-			{
-				shadow = 0.100f;
-			}
+			cullOccluders(intPoint, intNormal, (intersectObjectID == SPHERE_ID) ? objArrayIndex : -1);
+			occlusion = getAmbientOcclusion(intPoint, intNormal);
+		}
 
-			// compute lighting
-			vec3 reflectDir = reflect(lightRay.direction, intNormal);
+		if ((uSettings.x & RENDER_STOCHASTIC_LIGHTS) != 0u)
+		{
+			// one shadow ray per hit, seeded per pixel, frame, bounce and ray
+			float u = rand(vec2(gPixel) + vec2(float(uSettings.y % 1024u), float(i) * 7.31) + theRay.direction.xy);
+			localColor = sampleOneLight(intPoint, intNormal, theRay.direction, activeMaterial, u, occlusion);
+		}
+		else
+		{
+			// now iterate through the lights and look for shadows
+			for (int l = 0; l != MAX_LIGHTS; ++l)
+				localColor += shadeDirectionalLight(uLights[l], intPoint, intNormal, theRay.direction, activeMaterial) + uLights[l].ambient * 0.01f * occlusion;
 
-			localColor += phongShading(activeLight, activeMaterial, theRay.direction, lightRay.direction, intNormal, reflectDir, shadow);
-		} // end lights
+			if ((uSettings.x & RENDER_POINT_LIGHTS) != 0u)
+				localColor += shadePointLights(intPoint, intNormal, theRay.direction, activeMaterial);
+		}
 
 		finalColor += localColor * (1.0f - reflValue) * colorFrac;
 
@@ -298,24 +285,244 @@ vec3 traceRay(inout Ray theRay)
 	return finalColor;
 } // end traceRay
 
-layout (local_size_x = 20, local_size_y = 20) in;
-void main()
+// unique per object, exactly representable in a float channel
+// mesh hits are keyed per instance, reuse is not broken by triangle edges
+float getObjectKey(int objectID, int objArrayIndex)
 {
-	// calculate the viewing frustum (camera)
-	ivec2 invocID = ivec2(gl_GlobalInvocationID.xy);
-	ivec2 size = imageSize(uFramebuffer);
+	if (objectID == TRIANGLE_ID)
+		objArrayIndex = int(uint(objArrayIndex) >> MESH_INSTANCE_SHIFT);
+	return float(objectID * 65536 + objArrayIndex + 1);
+}
+
+// normal of a primary hit facing the camera, for the denoiser's edge stopping
+vec3 getPrimaryNormal(Ray theRay, float tClosest, int intersectObjectID, int objArrayIndex)
+{
+	vec3 normal = uPlane.normal;
+	if (intersectObjectID == SPHERE_ID)
+		normal = normalize(theRay.origin + theRay.direction * tClosest - bSpheres[objArrayIndex].center);
+	else if (intersectObjectID == TRIANGLE_ID)
+		normal = getTriangleNormal(uint(objArrayIndex));
+	return (dot(theRay.direction, normal) > 0.0) ? -normal : normal;
+}
+
+/**
+*   Reproject the primary hit into the previous frame, reuse its color when the
+*   previous G-buffer saw the same object at the same distance there.
+*/
+bool reprojectPrevious(vec3 hitPoint, float objectKey, ivec2 size, out vec3 prevColor)
+{
+	prevColor = vec3(0.0);
+
+	vec4 prevClip = uPrevViewProj * vec4(hitPoint, 1.0);
+	if (prevClip.w <= EPSILON)
+		return false;
+
+	// inverse of the pixelPos -> frustum ray mapping in main()
+	vec2 prevPos = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+	ivec2 prevPixel = ivec2(round(prevPos * vec2(size - 1)));
+	if (any(lessThan(prevPixel, ivec2(0))) || any(greaterThanEqual(prevPixel, size)))
+		return false;
+
+	vec4 prevGBuffer = imageLoad(uPrevGBuffer, prevPixel);
+	if (prevGBuffer.z == 0.0 || prevGBuffer.y != objectKey)
+		return false;
+
+	float prevDistance = distance(uPrevEye.xyz, hitPoint);
+	if (abs(prevGBuffer.x - prevDistance) > TEMPORAL_DEPTH_TOLERANCE * prevDistance)
+		return false;
+
+	prevColor = imageLoad(uPrevFramebuffer, prevPixel).rgb;
+	return true;
+}
+
+/**
+*   The whole work group loads the sphere lists of screen tiles [firstTile, firstTile + tileCount)
+*   of one tile row into shared memory, so every invocation must call it. Spheres near a tile
+*   border are in both lists of a checkerboard pair and end up tested twice, which is harmless.
+*/
+void loadTileSpheres(uvec2 firstTile, uint tileCount, ivec2 size)
+{
+	uint tilesX = uint((size.x + TILE_SIZE - 1) / TILE_SIZE);
+	uint tilesY = uint((size.y + TILE_SIZE - 1) / TILE_SIZE);
+	if (firstTile.y >= tilesY || firstTile.x >= tilesX)
+		tileCount = 0u;
+	tileCount = min(tileCount, tilesX - min(firstTile.x, tilesX));
+
+	// the previous tile's candidates may still be in use (persistent work groups)
+	barrier();
+	if (gl_LocalInvocationIndex == 0u)
+		sTileSphereCount = 0u;
+	barrier();
+
+	for (uint t = 0u; t != tileCount; ++t)
+	{
+		uint list = (firstTile.y * tilesX + firstTile.x + t) * TILE_SPHERE_STRIDE;
+		if (gl_LocalInvocationIndex < bTileSpheres[list])
+		{
+			uint sphere = bTileSpheres[list + 1u + gl_LocalInvocationIndex];
+			uint slot = atomicAdd(sTileSphereCount, 1u);
+			sTileSpheres[slot] = bSpheres[sphere];
+			sTileSphereIndices[slot] = int(sphere);
+		}
+	}
+	barrier();
+}
+
+// closest hit of a primary ray: the tile's sphere candidates from shared memory, then the
+// TLAS walk for the meshes and the plane
+float findPrimaryIntersection(Ray theRay, inout int intersectObjectID, inout int objArrayIndex)
+{
+	float tClosest = uCamera.far;
+	for (uint i = 0u; i != sTileSphereCount; ++i)
+	{
+		float t = sphereHit(sTileSpheres[i], theRay);
+		if (t > EPSILON && t < tClosest)
+		{
+			tClosest = t;
+			intersectObjectID = SPHERE_ID;
+			objArrayIndex = sTileSphereIndices[i];
+		}
+	}
+
+	return findObjectIntersection(theRay, intersectObjectID, objArrayIndex, tClosest, false);
+}
+
+// primary ray through a (possibly fractional) pixel position
+Ray getPrimaryRay(vec2 pixel, ivec2 size)
+{
+	vec2 pixelPos = pixel / vec2(size.x - 1, size.y - 1);
+
+	vec3 cameraDir = mix(mix(uCamera.ray00, uCamera.ray01, pixelPos.y), mix(uCamera.ray10, uCamera.ray11, pixelPos.y), pixelPos.x);
+
+	return Ray(uCamera.eye, normalize(cameraDir));
+}
+
+// one sample per pixel, optionally reusing the previous frame or skipping half the pixels
+void tracePrimary(ivec2 invocID, ivec2 size)
+{
+	// a checkerboard work group spans two screen tiles of the full-width image
+	bool checkerboard = (uSettings.x & RENDER_CHECKERBOARD) != 0u;
+	uvec2 groupTile = uvec2(invocID - ivec2(gl_LocalInvocationID.xy)) / uint(TILE_SIZE);
+	if (checkerboard)
+		loadTileSpheres(uvec2(groupTile.x * 2u, groupTile.y), 2u, size);
+	else
+		loadTileSpheres(groupTile, 1u, size);
+
+	// half-width dispatch, alternate which pixel of each horizontal pair is traced per frame
+	if (checkerboard)
+		invocID.x = invocID.x * 2 + int((uint(invocID.y) + uSettings.y) & 1u);
+	gPixel = invocID;
 
 	if (invocID.x >= size.x || invocID.y >= size.y)
 		return;
 
-	vec2 pixelPos = vec2(invocID) / vec2(size.x - 1, size.y - 1);
+	// away from the focus only one pixel per block is traced this frame, reconstruct.cs.glsl fills the rest
+	if ((uSettings.x & RENDER_FOVEATED) != 0u && !checkerboard)
+	{
+		int stride = getFoveaStride(invocID, uFovea);
+		if (any(notEqual(invocID % stride, getFoveaOffset(stride, uSettings.y))))
+			return;
+		gBounceBudget = (stride == 1) ? MAX_RAY_BOUNCES : ((stride == 2) ? FOVEA_MIDDLE_BOUNCES : FOVEA_OUTER_BOUNCES);
+	}
 
-	vec3 cameraDir = mix(mix(uCamera.ray00, uCamera.ray01, pixelPos.y), mix(uCamera.ray10, uCamera.ray11, pixelPos.y), pixelPos.x);
+	Ray theRay = getPrimaryRay(vec2(invocID), size);
+
+	int objArrayIndex = -1;
+	int intersectObjectID = -1;
+	float tClosest = findPrimaryIntersection(theRay, intersectObjectID, objArrayIndex);
+
+	float objectKey = getObjectKey(intersectObjectID, objArrayIndex);
+	bool validHit = intersectObjectID != -1;
+	float packedNormal = validHit ? packNormal(getPrimaryNormal(theRay, tClosest, intersectObjectID, objArrayIndex)) : 0.0;
+	imageStore(uGBuffer, invocID, vec4(tClosest, objectKey, validHit ? 1.0 : 0.0, packedNormal));
+
+	vec3 finalColor;
+	bool reused = false;
+	if ((uSettings.x & RENDER_TEMPORAL) != 0u && validHit)
+	{
+		// a rotating subset is always retraced so view dependent shading can't go stale
+		uint refresh = (uint(invocID.x) * 7u + uint(invocID.y) * 3u + uSettings.y) % max(uSettings.z, 1u);
+		if (refresh != 0u)
+			reused = reprojectPrevious(theRay.origin + theRay.direction * tClosest, objectKey, size, finalColor);
+	}
 
-	Ray theRay = Ray(uCamera.eye, normalize(cameraDir));
+	if (!reused)
+		finalColor = traceRay(theRay, tClosest, intersectObjectID, objArrayIndex);
 
-	vec3 finalColor = traceRay(theRay);
+	// progressive accumulation of the single light samples while the camera holds still,
+	// the host pauses the scene animation meanwhile so the running mean converges
+	if ((uSettings.x & RENDER_STOCHASTIC_LIGHTS) != 0u && uSettings.w != 0u)
+		finalColor = mix(imageLoad(uPrevFramebuffer, invocID).rgb, finalColor, 1.0 / float(uSettings.w + 1u));
 
 	imageStore(uFramebuffer, invocID, vec4(finalColor, 1.0));
 }
 
+// extra jittered samples for one high variance tile from the work list, averaged with the existing sample.
+// Not dispatched while the stochastic lighting accumulates, the result would replace the running mean
+void supersampleTile(ivec2 size)
+{
+	uint tile = bTiles[gl_WorkGroupID.x];
+	loadTileSpheres(uvec2(tile & 0xFFFFu, tile >> 16u), 1u, size);
+
+	ivec2 pixel = ivec2(tile & 0xFFFFu, tile >> 16u) * TILE_SIZE + ivec2(gl_LocalInvocationID.xy);
+	gPixel = pixel;
+
+	if (pixel.x >= size.x || pixel.y >= size.y)
+		return;
+
+	vec3 sum = imageLoad(uFramebuffer, pixel).rgb;
+	float seed = float(uSettings.y % 1024u);
+
+	for (int i = 0; i != ADAPTIVE_SAMPLES; ++i)
+	{
+		vec2 jitter = vec2(rand(vec2(pixel) + vec2(float(i), seed)), rand(vec2(pixel.yx) + vec2(seed, float(i)))) - 0.5;
+		Ray theRay = getPrimaryRay(vec2(pixel) + jitter, size);
+
+		int objArrayIndex = -1;
+		int intersectObjectID = -1;
+		float tClosest = findPrimaryIntersection(theRay, intersectObjectID, objArrayIndex);
+
+		sum += traceRay(theRay, tClosest, intersectObjectID, objArrayIndex);
+	}
+
+	imageStore(uFramebuffer, pixel, vec4(sum / float(ADAPTIVE_SAMPLES + 1), 1.0));
+}
+
+// a device filling number of work groups pulls row-major tiles until the frame is done,
+// so groups stuck on reflective tiles don't leave the rest of the GPU idle
+void tracePersistent(ivec2 size)
+{
+	ivec2 traced = ivec2(((uSettings.x & RENDER_CHECKERBOARD) != 0u) ? (size.x + 1) / 2 : size.x, size.y);
+	uint tilesX = uint((traced.x + TILE_SIZE - 1) / TILE_SIZE);
+	uint totalTiles = tilesX * uint((traced.y + TILE_SIZE - 1) / TILE_SIZE);
+
+	for (;;)
+	{
+		if (gl_LocalInvocationIndex == 0u)
+			sTile = atomicAdd(bNextTile, 1u);
+		barrier();
+
+		uint tile = sTile;
+		// everyone has read sTile before it is overwritten by the next fetch
+		barrier();
+
+		if (tile >= totalTiles)
+			break;
+
+		ivec2 tileOrigin = ivec2(tile % tilesX, tile / tilesX) * TILE_SIZE;
+		tracePrimary(tileOrigin + ivec2(gl_LocalInvocationID.xy), size);
+	}
+}
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+void main()
+{
+	ivec2 size = imageSize(uFramebuffer);
+
+	if (uPass == TRACE_PASS_ADAPTIVE)
+		supersampleTile(size);
+	else if (uPass == TRACE_PASS_PERSISTENT)
+		tracePersistent(size);
+	else
+		tracePrimary(ivec2(gl_GlobalInvocationID.xy), size);
+}
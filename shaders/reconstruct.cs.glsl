@@ -0,0 +1,110 @@
+#version 450 core
+
+#include "fovea.glsl"
+
+// Fills the pixels the checkerboard trace skipped this frame,
+// traced pixels satisfy ((x + y + frame) & 1) == 0, see raytracer.cs.glsl.
+// Built with RECONSTRUCT_FOVEATED it upsamples the foveated trace instead,
+// the traced pixels are picked by isFoveaTraced
+
+// weight of the spatial average versus the clamped previous frame
+#define SPATIAL_WEIGHT 0.25
+// the foveated neighbors are farther apart, their average is trusted more than history
+#define FOVEA_SPATIAL_WEIGHT 0.5
+
+layout (binding = 0, rgba32f) uniform image2D uFramebuffer;
+layout (binding = 1, rgba32f) readonly uniform image2D uPrevFramebuffer;
+layout (binding = 2, rgba32f) writeonly uniform image2D uGBuffer;
+
+uniform uint uFrameIndex = 0u;
+uniform vec4 uFovea = vec4(0.0);
+
+vec3 loadTraced(ivec2 pixel, ivec2 size)
+{
+	return imageLoad(uFramebuffer, clamp(pixel, ivec2(0), size - 1)).rgb;
+}
+
+#if defined(RECONSTRUCT_FOVEATED)
+
+layout (local_size_x = 20, local_size_y = 20) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(uFramebuffer);
+
+	if (pixel.x >= size.x || pixel.y >= size.y || isFoveaTraced(pixel, uFovea, uFrameIndex))
+		return;
+
+	// bilinear between the four traced pixels of the stride grid around this one,
+	// taps across a ring border that were not traced this frame are skipped
+	int stride = getFoveaStride(pixel, uFovea);
+	ivec2 offset = getFoveaOffset(stride, uFrameIndex);
+	vec2 grid = vec2(pixel - offset) / float(stride);
+	ivec2 base = ivec2(floor(grid));
+	vec2 fraction = grid - vec2(base);
+
+	vec3 spatial = vec3(0.0);
+	vec3 neighborMin = vec3(1e30);
+	vec3 neighborMax = vec3(-1e30);
+	float weightSum = 0.0;
+	for (int corner = 0; corner != 4; ++corner)
+	{
+		ivec2 cell = ivec2(corner & 1, corner >> 1);
+		ivec2 tap = (base + cell) * stride + offset;
+		if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size)) || !isFoveaTraced(tap, uFovea, uFrameIndex))
+			continue;
+
+		vec2 bilinear = mix(1.0 - fraction, fraction, vec2(cell));
+		float weight = bilinear.x * bilinear.y + 0.0001;
+		vec3 traced = imageLoad(uFramebuffer, tap).rgb;
+		spatial += traced * weight;
+		weightSum += weight;
+		neighborMin = min(neighborMin, traced);
+		neighborMax = max(neighborMax, traced);
+	}
+
+	vec3 history = imageLoad(uPrevFramebuffer, pixel).rgb;
+	if (weightSum > 0.0)
+		history = mix(clamp(history, neighborMin, neighborMax), spatial / weightSum, FOVEA_SPATIAL_WEIGHT);
+
+	imageStore(uFramebuffer, pixel, vec4(history, 1.0));
+
+	// no primary hit this frame, temporal reprojection must not reuse it
+	imageStore(uGBuffer, pixel, vec4(0.0));
+}
+
+#else
+
+layout (local_size_x = 20, local_size_y = 20) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(uFramebuffer);
+
+	if (pixel.x >= size.x || pixel.y >= size.y)
+		return;
+
+	if (((uint(pixel.x + pixel.y) + uFrameIndex) & 1u) == 0u)
+		return;
+
+	// the 4-neighbors all have the opposite parity, so they were traced this frame
+	// (at the image border the clamped neighbor may be this pixel's stale value, which is acceptable)
+	vec3 left = loadTraced(pixel + ivec2(-1, 0), size);
+	vec3 right = loadTraced(pixel + ivec2(1, 0), size);
+	vec3 down = loadTraced(pixel + ivec2(0, -1), size);
+	vec3 up = loadTraced(pixel + ivec2(0, 1), size);
+
+	vec3 spatial = (left + right + down + up) * 0.25;
+	vec3 neighborMin = min(min(left, right), min(down, up));
+	vec3 neighborMax = max(max(left, right), max(down, up));
+
+	// this pixel was traced last frame, clamping to the neighborhood rejects stale history on motion
+	vec3 history = clamp(imageLoad(uPrevFramebuffer, pixel).rgb, neighborMin, neighborMax);
+
+	imageStore(uFramebuffer, pixel, vec4(mix(history, spatial, SPATIAL_WEIGHT), 1.0));
+
+	// no primary hit this frame, temporal reprojection must not reuse it
+	imageStore(uGBuffer, pixel, vec4(0.0));
+}
+
+#endif
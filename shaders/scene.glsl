@@ -0,0 +1,118 @@
+// Scene declarations shared by raytracer.cs.glsl and wavefront.cs.glsl: object ids, render
+// flags, the per-frame FrameBlock (frame.glsl) and the read-only scene buffers. Images,
+// uniforms and the buffers of a single kernel stay in that kernel. Needs layout.glsl.
+
+#ifndef SCENE_GLSL
+#define SCENE_GLSL
+
+#include "frame.glsl"
+
+// These defines should match FrameData.hpp
+#define SPHERE_ID 0
+#define PLANE_ID 1
+#define TRIANGLE_ID 2
+#define EPSILON 0.001
+#define CHECKER_SQUARE_SIZE 0.05
+#define MAX_RAY_BOUNCES 5
+
+// This define should match Bvh::SHADOW_RIGHT_FIRST
+#define BVH_SHADOW_RIGHT_FIRST 0x80000000u
+// These defines should match WideBvh::LEAF_BIT, LEAF_COUNT_SHIFT and LEAF_FIRST_MASK
+#define WIDE_BVH_LEAF 0x80000000u
+#define WIDE_BVH_LEAF_COUNT_SHIFT 23u
+#define WIDE_BVH_LEAF_FIRST_MASK 0x7FFFFFu
+
+// These defines should match RenderFlags in FrameData.hpp
+#define RENDER_TEMPORAL 1u
+#define RENDER_CHECKERBOARD 2u
+#define RENDER_ADAPTIVE 4u
+#define RENDER_WAVEFRONT 8u
+#define RENDER_PERSISTENT 16u
+#define RENDER_POINT_LIGHTS 128u
+#define RENDER_STOCHASTIC_LIGHTS 256u
+#define RENDER_WIDE_BVH 1024u
+#define RENDER_ANALYTIC_SHADOWS 2048u
+#define RENDER_FOVEATED 8192u
+
+// Camera, Material, Plane, Light and the buffer element structs are defined in layout.glsl
+struct Ray {
+	vec3 origin;
+	vec3 direction;
+};
+
+// this is an SSBO - CRITICAL: Now uses bSpheres for all sphere data
+// the animated spheres are rewritten each frame in the same ring buffer slot as FrameBlock
+layout (std430, binding = 1) readonly buffer SphereBuffer {
+	Sphere bSpheres[MAX_SPHERES];
+};
+
+// the sphere materials, static and deduplicated, only read on the closest hit (see MaterialTable.hpp)
+layout (std430, binding = 28) readonly buffer MaterialBuffer {
+	uint bSphereMaterials[MAX_SPHERES];
+	Material bMaterials[];
+};
+
+// mesh triangles in object space, shared by every instance of the mesh (see Mesh.cpp)
+layout (std430, binding = 14) readonly buffer MeshVertices {
+	vec4 bMeshVertices[];
+};
+
+layout (std430, binding = 15) readonly buffer MeshIndices {
+	uint bMeshIndices[];
+};
+
+// bottom level trees over the mesh triangles, built once
+layout (std430, binding = 16) readonly buffer BvhNodes {
+	BvhNode bBvhNodes[];
+};
+
+// triangle indices referenced by the BLAS leaves
+layout (std430, binding = 17) readonly buffer BvhPrimitives {
+	uint bBvhPrimitives[];
+};
+
+layout (std430, binding = 26) readonly buffer WideBvhNodes {
+	WideBvhNode bWideBvhNodes[];
+};
+
+// sphere tree rebuilt on the GPU every frame, same node layout with one sphere per leaf (see lbvh.cs.glsl)
+layout (std430, binding = 19) readonly buffer SphereTreeNodes {
+	BvhNode bSphereTreeNodes[];
+};
+
+layout (std430, binding = 20) readonly buffer SphereTreeRefs {
+	uint bSphereTreeRefs[];
+};
+
+// These defines should match Tlas::INSTANCE_*
+#define INSTANCE_SPHERE 0u
+#define INSTANCE_MESH 1u
+#define INSTANCE_SPHERE_TREE 2u
+// triangle hits carry their instance in the upper bits of objArrayIndex
+#define MESH_INSTANCE_SHIFT 22u
+#define MESH_TRIANGLE_MASK 0x3FFFFFu
+
+// top level tree over the instances, rebuilt every frame in the FrameBlock ring buffer slot (see Tlas.cpp)
+layout (std430, binding = 18) readonly buffer TlasBuffer {
+	BvhNode bTlasNodes[2 * MAX_INSTANCES];
+	Instance bInstances[MAX_INSTANCES];
+	uint bTlasInstances[MAX_INSTANCES];
+};
+
+layout (std430, binding = 11) readonly buffer PointLightBuffer {
+	PointLight bPointLights[];
+};
+
+// uniform grid over the lights' influence spheres, one (first index, count) pair per cell (see LightGrid.hpp)
+layout (std430, binding = 12) readonly buffer LightGrid {
+	vec4 bGridMin;
+	vec4 bGridCellSize;
+	uvec4 bGridDims;
+	uvec2 bGridCells[];
+};
+
+layout (std430, binding = 13) readonly buffer LightIndexBuffer {
+	uint bLightIndices[];
+};
+
+#endif // SCENE_GLSL
@@ -0,0 +1,150 @@
+// Shading shared by raytracer.cs.glsl and wavefront.cs.glsl: the plane material, Phong
+// shading, light visibility with hard or analytic shadows, and the point lights of the
+// light grid. Needs layout.glsl, scene.glsl, intersect.glsl and occlusion.glsl.
+
+#ifndef SHADING_GLSL
+#define SHADING_GLSL
+
+// share of a directional light's diffuse + specular left in its hard shadow, as in the original
+// tracer, should match SHADOW_FACTOR in CpuTracer.cpp
+#define SHADOW_FACTOR 0.100
+
+Material checkerboardPlaneMaterial(in vec3 intersectPoint)
+{
+	const int square = int(floor(intersectPoint.x * CHECKER_SQUARE_SIZE) + floor(intersectPoint.z * CHECKER_SQUARE_SIZE));
+
+	Material planeMaterial = uPlane.material;
+
+	if(square % 2 == 0) {
+		return planeMaterial;
+	}
+	else {
+		// black square
+		planeMaterial.ambient = vec3(0.01f, 0.01f, 0.01f);
+		planeMaterial.diffuse = vec3(0.01f, 0.01f, 0.01f);
+		planeMaterial.specular = vec3(0.01f, 0.01f, 0.01f);
+		return planeMaterial;
+	}
+}
+
+/**
+*   Calculate the rendering equation using Phong shading algorithm.
+*   color = ambient + (shadow * (diffuse + specular));
+*/
+vec3 phongShading(Light light, Material material, vec3 viewDir, vec3 lightDir, vec3 intNormal, vec3 reflectDir, float shadow)
+{
+	vec3 diffuse, specular, ambient;
+	ambient = light.ambient * 0.01f;//material.ambient;
+	diffuse = light.diffuse * material.diffuse * max(dot(lightDir, intNormal), 0);
+	specular = light.specular * material.specular * max(pow(dot(viewDir, reflectDir), material.shininess), 0);
+	return (shadow * (diffuse + specular)) + ambient;
+}
+
+// spheres that may shadow the current hit, gathered once per hit for every light (see cullOccluders)
+uint gOccluders[MAX_SPHERES];
+uint gOccluderCount;
+
+// keep the spheres above the hit's tangent plane, self is the sphere that was hit or -1
+void cullOccluders(vec3 intPoint, vec3 intNormal, int self)
+{
+	gOccluderCount = 0u;
+	for (int i = 0; i != MAX_SPHERES; ++i)
+	{
+		if (i != self && isOccluderCandidate(bSpheres[i], intPoint, intNormal))
+			gOccluders[gOccluderCount++] = uint(i);
+	}
+}
+
+/**
+*   Fraction of a light reaching intPoint. Hard shadows cast one ray against everything,
+*   analytic shadows cast it against the plane and meshes only and cover the culled
+*   spheres with the cone - sphere overlap instead, which gives them a penumbra.
+*   0 is fully shadowed, directional lights keep SHADOW_FACTOR there (see getShadowFactor)
+*   and point lights drop out, both as before the analytic mode.
+*/
+float getLightVisibility(vec3 intPoint, vec3 intNormal, vec3 lightDir, float lightDist, bool directional)
+{
+	Ray lightRay = Ray(intPoint + (intNormal * EPSILON), lightDir);
+	if ((uSettings.x & RENDER_ANALYTIC_SHADOWS) == 0u)
+		return isOccluded(lightRay, lightDist, true) ? 0.0 : 1.0;
+
+	if (isOccluded(lightRay, lightDist, false))
+		return 0.0;
+
+	float cosLight = getLightCapCosine(directional, lightDist);
+	float visibility = 1.0;
+	for (uint i = 0u; i != gOccluderCount; ++i)
+		visibility *= getSphereLightVisibility(bSpheres[gOccluders[i]], intPoint, lightDir, lightDist, cosLight);
+	return visibility;
+}
+
+// shadow term of a directional light for phongShading, SHADOW_FACTOR in full shadow
+float getShadowFactor(float visibility)
+{
+	return mix(SHADOW_FACTOR, 1.0, visibility);
+}
+
+// ambient light left over by the culled spheres, 1 without analytic shadows
+float getAmbientOcclusion(vec3 intPoint, vec3 intNormal)
+{
+	if ((uSettings.x & RENDER_ANALYTIC_SHADOWS) == 0u)
+		return 1.0;
+
+	float ambient = 1.0;
+	for (uint i = 0u; i != gOccluderCount; ++i)
+		ambient *= 1.0 - getSphereOcclusion(bSpheres[gOccluders[i]], intPoint, intNormal);
+	return ambient;
+}
+
+// (first index, count) of the lights reaching point, false outside the grid
+bool getLightCell(vec3 point, out uvec2 cell)
+{
+	vec3 local = (point - bGridMin.xyz) / bGridCellSize.xyz;
+	if (any(lessThan(local, vec3(0.0))) || any(greaterThanEqual(uvec3(local), bGridDims.xyz)))
+		return false;
+
+	uvec3 coords = uvec3(local);
+	cell = bGridCells[(coords.z * bGridDims.y + coords.y) * bGridDims.x + coords.x];
+	return true;
+}
+
+/**
+*   Phong shading for the point lights of the grid cell containing intPoint,
+*   the attenuation reaches zero at the light radius so skipping other cells is exact.
+*/
+vec3 shadePointLights(vec3 intPoint, vec3 intNormal, vec3 viewDir, Material material)
+{
+	uvec2 cell;
+	if (!getLightCell(intPoint, cell))
+		return vec3(0.0);
+
+	vec3 color = vec3(0.0);
+	for (uint i = cell.x; i != cell.x + cell.y; ++i)
+	{
+		PointLight light = bPointLights[bLightIndices[i]];
+
+		vec3 toLight = light.position.xyz - intPoint;
+		float dist = length(toLight);
+		if (dist >= light.position.w)
+			continue;
+
+		vec3 lightDir = toLight / dist;
+		float cosTheta = dot(lightDir, intNormal);
+		if (cosTheta <= 0.0)
+			continue;
+
+		float visibility = getLightVisibility(intPoint, intNormal, lightDir, dist, false);
+		if (visibility <= 0.0)
+			continue;
+
+		float falloff = 1.0 - dist / light.position.w;
+		vec3 reflectDir = reflect(lightDir, intNormal);
+		vec3 diffuse = material.diffuse * cosTheta;
+		vec3 specular = material.specular * pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+		color += light.color.rgb * (diffuse + specular) * falloff * falloff * visibility;
+	}
+
+	return color;
+}
+
+#endif // SHADING_GLSL
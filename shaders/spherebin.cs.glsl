@@ -0,0 +1,86 @@
+#version 450 core
+
+#include "layout.glsl"
+
+// Bins the spheres into screen tiles before the primary trace, one work group per
+// TILE_SIZE x TILE_SIZE tile. A sphere is kept when it reaches into the pyramid of
+// primary rays through the tile, the tile grows by a pixel on each side to cover the
+// adaptive pass jitter. raytracer.cs.glsl loads the lists into shared memory.
+
+// These defines should match raytracer.cs.glsl, MAX_SPHERES comes from layout.glsl
+#define TILE_SIZE 20
+// sphere count followed by up to MAX_SPHERES sphere indices per tile
+#define TILE_SPHERE_STRIDE (MAX_SPHERES + 1)
+
+// only the size is read, the trace pass writes it afterwards
+layout (binding = 0, rgba32f) readonly uniform image2D uFramebuffer;
+
+// the camera leads FrameBlock, the members after it are not needed here
+layout (std140, binding = 2) uniform FrameBlock {
+	Camera uCamera;
+};
+
+layout (std430, binding = 1) readonly buffer SphereBuffer {
+	Sphere bSpheres[MAX_SPHERES];
+};
+
+layout (std430, binding = 27) writeonly buffer TileSphereLists {
+	uint bTileSpheres[];
+};
+
+shared uint sCount;
+
+// unnormalized direction through a pixel position, the same bilinear mapping as getPrimaryRay
+vec3 getCornerDirection(vec2 pixel, ivec2 size)
+{
+	vec2 pixelPos = pixel / vec2(size.x - 1, size.y - 1);
+	return mix(mix(uCamera.ray00, uCamera.ray01, pixelPos.y), mix(uCamera.ray10, uCamera.ray11, pixelPos.y), pixelPos.x);
+}
+
+// side plane through the eye and two adjacent corner rays, facing into the tile
+vec3 getSidePlane(vec3 first, vec3 second, vec3 center)
+{
+	vec3 normal = normalize(cross(first, second));
+	return (dot(normal, center) < 0.0) ? -normal : normal;
+}
+
+layout (local_size_x = 32) in;
+void main()
+{
+	ivec2 size = imageSize(uFramebuffer);
+	vec2 tileMin = vec2(gl_WorkGroupID.xy * TILE_SIZE) - 1.0;
+	vec2 tileMax = vec2(gl_WorkGroupID.xy * TILE_SIZE + TILE_SIZE - 1) + 1.0;
+
+	vec3 corner00 = getCornerDirection(tileMin, size);
+	vec3 corner10 = getCornerDirection(vec2(tileMax.x, tileMin.y), size);
+	vec3 corner11 = getCornerDirection(tileMax, size);
+	vec3 corner01 = getCornerDirection(vec2(tileMin.x, tileMax.y), size);
+	vec3 center = corner00 + corner10 + corner11 + corner01;
+
+	vec3 planes[4];
+	planes[0] = getSidePlane(corner00, corner10, center);
+	planes[1] = getSidePlane(corner10, corner11, center);
+	planes[2] = getSidePlane(corner11, corner01, center);
+	planes[3] = getSidePlane(corner01, corner00, center);
+
+	if (gl_LocalInvocationIndex == 0u)
+		sCount = 0u;
+	barrier();
+
+	uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+	for (uint i = gl_LocalInvocationIndex; i < MAX_SPHERES; i += gl_WorkGroupSize.x)
+	{
+		// conservative: a sphere outside every side plane by less than its radius is kept
+		vec3 toCenter = bSpheres[i].center - uCamera.eye;
+		float radius = bSpheres[i].radius;
+		if (dot(planes[0], toCenter) >= -radius && dot(planes[1], toCenter) >= -radius
+			&& dot(planes[2], toCenter) >= -radius && dot(planes[3], toCenter) >= -radius)
+		{
+			bTileSpheres[tile * TILE_SPHERE_STRIDE + 1u + atomicAdd(sCount, 1u)] = i;
+		}
+	}
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0u)
+		bTileSpheres[tile * TILE_SPHERE_STRIDE] = sCount;
+}
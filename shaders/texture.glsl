@@ -0,0 +1,45 @@
+// Textured materials, shared by raytracer.cs.glsl and wavefront.cs.glsl. A material with a
+// textureLayer scales its ambient and diffuse color by a texel of that layer of uTextures
+// (see TextureArray.hpp). Compute shaders have no derivatives, the mip level comes from the
+// world size of the pixel footprint instead. Needs layout.glsl for Material.
+
+#ifndef TEXTURE_GLSL
+#define TEXTURE_GLSL
+
+#define TEXTURE_TWO_PI 6.28318531
+#define TEXTURE_PI 3.14159265
+
+// the plane repeats its texture every 1 / PLANE_TEXTURE_SCALE world units
+#define PLANE_TEXTURE_SCALE 0.02
+
+// This binding should match TextureArray::TEXTURE_UNIT
+layout (binding = 1) uniform sampler2DArray uTextures;
+
+// longitude and latitude of the outward normal
+vec2 getSphereUV(vec3 normal)
+{
+	return vec2(0.5 + atan(normal.z, normal.x) / TEXTURE_TWO_PI, 0.5 + asin(clamp(normal.y, -1.0, 1.0)) / TEXTURE_PI);
+}
+
+vec2 getPlaneUV(vec3 point)
+{
+	return point.xz * PLANE_TEXTURE_SCALE;
+}
+
+/**
+*   footprint: world size of one pixel at the hit, uvPerUnit: how fast uv changes per world
+*   unit there. Level 0 while a texel covers at least a pixel, one level coarser per halving.
+*/
+Material applyTexture(Material material, vec2 uv, float footprint, float uvPerUnit)
+{
+	if (material.textureLayer < 0.0)
+		return material;
+
+	float texels = footprint * uvPerUnit * float(textureSize(uTextures, 0).x);
+	vec3 texel = textureLod(uTextures, vec3(uv, material.textureLayer), log2(max(texels, 1.0))).rgb;
+	material.ambient *= texel;
+	material.diffuse *= texel;
+	return material;
+}
+
+#endif // TEXTURE_GLSL
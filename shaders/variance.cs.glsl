@@ -0,0 +1,62 @@
+#version 450 core
+
+// One work group per tile: estimate the luminance variance of the traced frame
+// and append tiles above the threshold to the adaptive sampling work list
+
+// These defines should match raytracer.cs.glsl
+#define TILE_SIZE 20
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+#define VARIANCE_THRESHOLD 0.004
+
+layout (binding = 0, rgba32f) readonly uniform image2D uFramebuffer;
+
+// the header doubles as the glDispatchComputeIndirect arguments, reset to (0, 1, 1) each frame
+layout (std430, binding = 4) buffer TileWorkList {
+	uint bNumTiles;
+	uint bNumGroupsY;
+	uint bNumGroupsZ;
+	uint bPadding;
+	uint bTiles[];
+};
+
+shared float sSum[TILE_PIXELS];
+shared float sSumSquared[TILE_PIXELS];
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(uFramebuffer);
+	uint index = gl_LocalInvocationIndex;
+
+	float luminance = 0.0;
+	if (pixel.x < size.x && pixel.y < size.y)
+		luminance = dot(imageLoad(uFramebuffer, pixel).rgb, vec3(0.2126, 0.7152, 0.0722));
+
+	sSum[index] = luminance;
+	sSumSquared[index] = luminance * luminance;
+	barrier();
+
+	// tree reduction, the first step folds the 400 entries into 256
+	for (uint stride = 256u; stride > 0u; stride >>= 1u)
+	{
+		if (index < stride && index + stride < TILE_PIXELS)
+		{
+			sSum[index] += sSum[index + stride];
+			sSumSquared[index] += sSumSquared[index + stride];
+		}
+		barrier();
+	}
+
+	if (index == 0u)
+	{
+		float mean = sSum[0] / float(TILE_PIXELS);
+		float variance = sSumSquared[0] / float(TILE_PIXELS) - mean * mean;
+
+		if (variance > VARIANCE_THRESHOLD)
+		{
+			uint slot = atomicAdd(bNumTiles, 1u);
+			bTiles[slot] = gl_WorkGroupID.x | (gl_WorkGroupID.y << 16u);
+		}
+	}
+}
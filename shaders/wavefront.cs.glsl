@@ -0,0 +1,424 @@
+#version 450 core
+
+#include "layout.glsl"
+#include "scene.glsl"
+#include "intersect.glsl"
+#include "occlusion.glsl"
+#include "shading.glsl"
+#include "texture.glsl"
+
+// Wavefront path tracing: the bounce loop of raytracer.cs.glsl split into stages that
+// communicate through SSBO queues, compiled once per stage (see Wavefront.cpp)
+//   WAVEFRONT_GENERATE    - one primary ray per pixel
+//   WAVEFRONT_CLOSEST_HIT - intersect queued rays, record hits and reserve shadow rays
+//   WAVEFRONT_SHADOW      - one occlusion test per (hit, light)
+//   WAVEFRONT_SHADE       - Phong shading and the reflection ray for the next bounce
+// and optionally, to make secondary rays coherent before intersection
+//   WAVEFRONT_SORT_HISTOGRAM - count queued rays per (direction octant, origin Morton cell) bin
+//   WAVEFRONT_SORT_SCAN      - exclusive prefix sum of the bins, single work group
+//   WAVEFRONT_SORT_SCATTER   - copy every ray to its bin in the output queue
+
+// These defines should match Wavefront::GROUP_SIZE, Wavefront::MAX_GROUPS_X and Wavefront::SORT_BINS
+#define WAVEFRONT_GROUP_SIZE 64u
+// GL only guarantees 65535 work groups per dimension, longer queues continue in y
+#define WAVEFRONT_MAX_GROUPS_X 65535u
+// 3 octant bits followed by a 3 bit per axis Morton code of the ray origin
+#define SORT_CELLS_PER_AXIS 8.0
+#define SORT_BINS 4096u
+
+layout (binding = 0, rgba32f) uniform image2D uFramebuffer;
+layout (binding = 2, rgba32f) writeonly uniform image2D uGBuffer;
+
+// bounce being shaded, the last one does not queue reflection rays
+uniform uint uBounce = 0u;
+
+// xyz = origin, w = path weight / xyz = direction, w = bit-cast packed pixel
+struct QueuedRay {
+	vec4 origin;
+	vec4 direction;
+};
+
+// xyz = hit point, w = path weight / xyz = normal, w = packed pixel / xyz = ray direction, w = packed object
+struct QueuedHit {
+	vec4 point;
+	vec4 normal;
+	vec4 direction;
+};
+
+// every queue header doubles as glDispatchComputeIndirect arguments (groups x, groups y, 1) plus the element count
+layout (std430, binding = 5) readonly buffer RayQueueIn {
+	uint bRaysInGroups;
+	uint bRaysInGroupsY;
+	uint bRaysInGroupsZ;
+	uint bRaysInCount;
+	QueuedRay bRaysIn[];
+};
+
+layout (std430, binding = 6) buffer RayQueueOut {
+	uint bRaysOutGroups;
+	uint bRaysOutGroupsY;
+	uint bRaysOutGroupsZ;
+	uint bRaysOutCount;
+	QueuedRay bRaysOut[];
+};
+
+layout (std430, binding = 7) buffer HitQueue {
+	uint bHitGroups;
+	uint bHitGroupsY;
+	uint bHitGroupsZ;
+	uint bHitCount;
+	QueuedHit bHits[];
+};
+
+// visibility of the shadow ray from hit (index / MAX_LIGHTS) towards light (index % MAX_LIGHTS)
+layout (std430, binding = 8) buffer ShadowQueue {
+	uint bShadowGroups;
+	uint bShadowGroupsY;
+	uint bShadowGroupsZ;
+	uint bShadowCount;
+	float bShadowVisibility[];
+};
+
+// ray counts per sort key, turned into output offsets by the scan
+layout (std430, binding = 10) buffer SortBins {
+	uint bSortBins[SORT_BINS];
+};
+
+uint packPixel(ivec2 pixel)
+{
+	return uint(pixel.x) | (uint(pixel.y) << 16u);
+}
+
+ivec2 unpackPixel(uint packedPixel)
+{
+	return ivec2(packedPixel & 0xFFFFu, packedPixel >> 16u);
+}
+
+// 2 bit object id, the index keeps 30 bits for large meshes
+uint packObject(int objectID, int objArrayIndex)
+{
+	return (uint(objectID) << 30u) | uint(objArrayIndex + 1);
+}
+
+void unpackObject(uint packedObject, out int objectID, out int objArrayIndex)
+{
+	objectID = int(packedObject >> 30u);
+	objArrayIndex = int(packedObject & 0x3FFFFFFFu) - 1;
+}
+
+// element of a queue this invocation handles, the groups of a 2D dispatch are numbered row by row
+uint getQueueIndex()
+{
+	return (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * WAVEFRONT_GROUP_SIZE + gl_LocalInvocationIndex;
+}
+
+// dispatch size for count elements, both components only grow with count so atomicMax keeps them consistent
+uvec2 getQueueGroups(uint count)
+{
+	uint groups = (count + WAVEFRONT_GROUP_SIZE - 1u) / WAVEFRONT_GROUP_SIZE;
+	return uvec2(min(groups, WAVEFRONT_MAX_GROUPS_X), (groups + WAVEFRONT_MAX_GROUPS_X - 1u) / WAVEFRONT_MAX_GROUPS_X);
+}
+
+void pushRay(vec3 origin, vec3 direction, float weight, uint packedPixel)
+{
+	uint slot = atomicAdd(bRaysOutCount, 1u);
+	uvec2 groups = getQueueGroups(slot + 1u);
+	atomicMax(bRaysOutGroups, groups.x);
+	atomicMax(bRaysOutGroupsY, groups.y);
+	bRaysOut[slot] = QueuedRay(vec4(origin, weight), vec4(direction, uintBitsToFloat(packedPixel)));
+}
+
+// same light ray as the megakernel: w=0 means directional, w=1 means point light
+Ray getLightRay(Light light, vec3 intPoint, vec3 intNormal)
+{
+	vec3 lightDir;
+	if (light.position.w == 0.0)
+		lightDir = normalize(vec3(light.position.xyz));
+	else
+		lightDir = normalize(vec3(light.position.xyz - intPoint));
+
+	return Ray(intPoint + (intNormal * EPSILON), lightDir);
+}
+
+// spread the low 3 bits of v so they occupy every third bit
+uint spreadBits3(uint v)
+{
+	return (v & 1u) | ((v & 2u) << 2u) | ((v & 4u) << 4u);
+}
+
+// octant of the direction in the high bits, so the sort groups directions first and origins second.
+// The cells split the TLAS root box, the host fits it to every sphere and mesh instance once per frame
+uint getSortKey(QueuedRay ray)
+{
+	vec3 sceneMin = bTlasNodes[0].boundsMin;
+	vec3 sceneMax = bTlasNodes[0].boundsMax;
+
+	// plane hits outside the instance bounds fall into the border cells
+	vec3 cellPos = clamp((ray.origin.xyz - sceneMin) / max(sceneMax - sceneMin, vec3(EPSILON)), 0.0, 0.999) * SORT_CELLS_PER_AXIS;
+	uvec3 cell = uvec3(cellPos);
+	uint morton = spreadBits3(cell.x) | (spreadBits3(cell.y) << 1u) | (spreadBits3(cell.z) << 2u);
+
+	vec3 dir = ray.direction.xyz;
+	uint octant = (dir.x < 0.0 ? 1u : 0u) | (dir.y < 0.0 ? 2u : 0u) | (dir.z < 0.0 ? 4u : 0u);
+
+	return (octant << 9u) | morton;
+}
+
+void addColor(ivec2 pixel, vec3 color)
+{
+	vec4 accumulated = imageLoad(uFramebuffer, pixel);
+	imageStore(uFramebuffer, pixel, vec4(accumulated.rgb + color, 1.0));
+}
+
+layout (local_size_x = WAVEFRONT_GROUP_SIZE) in;
+
+#if defined(WAVEFRONT_GENERATE)
+
+void main()
+{
+	ivec2 size = imageSize(uFramebuffer);
+	uint pixelIndex = getQueueIndex();
+
+	if (pixelIndex >= uint(size.x * size.y))
+		return;
+
+	ivec2 pixel = ivec2(int(pixelIndex % uint(size.x)), int(pixelIndex / uint(size.x)));
+
+	imageStore(uFramebuffer, pixel, vec4(0.0, 0.0, 0.0, 1.0));
+	// no G-buffer from this pipeline, keep temporal reprojection from reusing stale entries
+	imageStore(uGBuffer, pixel, vec4(0.0));
+
+	vec2 pixelPos = vec2(pixel) / vec2(size.x - 1, size.y - 1);
+	vec3 cameraDir = mix(mix(uCamera.ray00, uCamera.ray01, pixelPos.y), mix(uCamera.ray10, uCamera.ray11, pixelPos.y), pixelPos.x);
+
+	pushRay(uCamera.eye, normalize(cameraDir), 0.999, packPixel(pixel));
+}
+
+#elif defined(WAVEFRONT_CLOSEST_HIT)
+
+void main()
+{
+	uint index = getQueueIndex();
+	if (index >= bRaysInCount)
+		return;
+
+	QueuedRay queued = bRaysIn[index];
+	Ray theRay = Ray(queued.origin.xyz, queued.direction.xyz);
+	uint packedPixel = floatBitsToUint(queued.direction.w);
+
+	int objArrayIndex = -1;
+	int intersectObjectID = -1;
+	float tClosest = findObjectIntersection(theRay, intersectObjectID, objArrayIndex, uCamera.far, true);
+
+	if (intersectObjectID == -1)
+	{
+		// No intersection - render gradient background
+		ivec2 pixel = unpackPixel(packedPixel);
+		vec2 size = vec2(imageSize(uFramebuffer));
+		addColor(pixel, vec3(float(pixel.x) / size.x, float(pixel.y) / size.y, fract(uTime)));
+		return;
+	}
+
+	vec3 intPoint = theRay.origin + (theRay.direction * tClosest);
+	vec3 intNormal;
+	if (intersectObjectID == SPHERE_ID)
+		intNormal = normalize(vec3(intPoint - bSpheres[objArrayIndex].center));
+	else if (intersectObjectID == TRIANGLE_ID)
+		intNormal = getTriangleNormal(uint(objArrayIndex));
+	else
+		intNormal = uPlane.normal;
+
+	// make sure we didn't intersect from inside the active obj
+	if (dot(theRay.direction, intNormal) > 0.0)
+		intNormal = -1.0 * intNormal;
+
+	uint slot = atomicAdd(bHitCount, 1u);
+	uvec2 hitGroups = getQueueGroups(slot + 1u);
+	atomicMax(bHitGroups, hitGroups.x);
+	atomicMax(bHitGroupsY, hitGroups.y);
+	bHits[slot] = QueuedHit(vec4(intPoint, queued.origin.w),
+		vec4(intNormal, uintBitsToFloat(packedPixel)),
+		vec4(theRay.direction, uintBitsToFloat(packObject(intersectObjectID, objArrayIndex))));
+
+	// the shadow rays of this hit live at slot * MAX_LIGHTS + light
+	uint shadowEnd = (slot + 1u) * uint(MAX_LIGHTS);
+	uvec2 shadowGroups = getQueueGroups(shadowEnd);
+	atomicMax(bShadowCount, shadowEnd);
+	atomicMax(bShadowGroups, shadowGroups.x);
+	atomicMax(bShadowGroupsY, shadowGroups.y);
+}
+
+#elif defined(WAVEFRONT_SHADOW)
+
+void main()
+{
+	uint index = getQueueIndex();
+	if (index >= bShadowCount)
+		return;
+
+	QueuedHit hit = bHits[index / uint(MAX_LIGHTS)];
+	Ray lightRay = getLightRay(uLights[index % uint(MAX_LIGHTS)], hit.point.xyz, hit.normal.xyz);
+
+	Light light = uLights[index % uint(MAX_LIGHTS)];
+	float maxDist = (light.position.w == 0.0) ? uCamera.far : length(light.position.xyz - hit.point.xyz);
+
+	if ((uSettings.x & RENDER_ANALYTIC_SHADOWS) != 0u)
+	{
+		int objArrayIndex;
+		int intersectObjectID;
+		unpackObject(floatBitsToUint(hit.direction.w), intersectObjectID, objArrayIndex);
+		cullOccluders(hit.point.xyz, hit.normal.xyz, (intersectObjectID == SPHERE_ID) ? objArrayIndex : -1);
+	}
+
+	float visibility = getLightVisibility(hit.point.xyz, hit.normal.xyz, lightRay.direction, maxDist, light.position.w == 0.0);
+	bShadowVisibility[index] = getShadowFactor(visibility);
+}
+
+#elif defined(WAVEFRONT_SHADE)
+
+void main()
+{
+	uint index = getQueueIndex();
+	if (index >= bHitCount)
+		return;
+
+	QueuedHit hit = bHits[index];
+	vec3 intPoint = hit.point.xyz;
+	vec3 intNormal = hit.normal.xyz;
+	uint packedPixel = floatBitsToUint(hit.normal.w);
+
+	int objArrayIndex;
+	int intersectObjectID;
+	unpackObject(floatBitsToUint(hit.direction.w), intersectObjectID, objArrayIndex);
+
+	// the queue drops the path length, the eye distance sizes the footprint of primary hits exactly
+	float pixelAngle = length(uCamera.ray10 - uCamera.ray00) / (length(uCamera.ray00) * float(imageSize(uFramebuffer).x));
+	float footprint = distance(uCamera.eye, intPoint) * pixelAngle;
+
+	Material activeMaterial;
+	float reflValue;
+	if (intersectObjectID == SPHERE_ID)
+	{
+		Sphere sphere = bSpheres[objArrayIndex];
+		activeMaterial = bMaterials[bSphereMaterials[objArrayIndex]];
+		reflValue = activeMaterial.reflective;
+		activeMaterial = applyTexture(activeMaterial, getSphereUV(normalize(intPoint - sphere.center)), footprint,
+			1.0 / (TEXTURE_TWO_PI * sphere.radius));
+	}
+	else if (intersectObjectID == TRIANGLE_ID)
+	{
+		activeMaterial = uMeshMaterial;
+		reflValue = uMeshMaterial.reflective;
+	}
+	else
+	{
+		if (uPlane.material.textureLayer < 0.0)
+			activeMaterial = checkerboardPlaneMaterial(intPoint);
+		else
+			activeMaterial = applyTexture(uPlane.material, getPlaneUV(intPoint), footprint, PLANE_TEXTURE_SCALE);
+		reflValue = uPlane.material.reflective;
+	}
+
+	// the spheres shadowing this hit, for its occlusion and point lights
+	float occlusion = 1.0;
+	if ((uSettings.x & RENDER_ANALYTIC_SHADOWS) != 0u)
+	{
+		cullOccluders(intPoint, intNormal, (intersectObjectID == SPHERE_ID) ? objArrayIndex : -1);
+		occlusion = getAmbientOcclusion(intPoint, intNormal);
+	}
+
+	vec3 localColor = vec3(0.0);
+	for (int i = 0; i != MAX_LIGHTS; ++i)
+	{
+		Light light = uLights[i];
+		light.ambient *= occlusion;
+		Ray lightRay = getLightRay(light, intPoint, intNormal);
+		vec3 reflectDir = reflect(lightRay.direction, intNormal);
+		float shadow = bShadowVisibility[index * uint(MAX_LIGHTS) + uint(i)];
+
+		localColor += phongShading(light, activeMaterial, hit.direction.xyz, lightRay.direction, intNormal, reflectDir, shadow);
+	}
+
+	if ((uSettings.x & RENDER_POINT_LIGHTS) != 0u)
+		localColor += shadePointLights(intPoint, intNormal, hit.direction.xyz, activeMaterial);
+
+	float colorFrac = hit.point.w;
+	addColor(unpackPixel(packedPixel), localColor * (1.0f - reflValue) * colorFrac);
+
+	colorFrac *= reflValue;
+
+	if (reflValue > 0.0 && colorFrac >= 0.01f && uBounce + 1u < uint(MAX_RAY_BOUNCES))
+	{
+		vec3 reflectDir = normalize(reflect(hit.direction.xyz, intNormal));
+		pushRay(intPoint + (intNormal * EPSILON), reflectDir, colorFrac, packedPixel);
+	}
+}
+
+#elif defined(WAVEFRONT_SORT_HISTOGRAM)
+
+void main()
+{
+	uint index = getQueueIndex();
+	if (index >= bRaysInCount)
+		return;
+
+	atomicAdd(bSortBins[getSortKey(bRaysIn[index])], 1u);
+}
+
+#elif defined(WAVEFRONT_SORT_SCAN)
+
+#define BINS_PER_INVOCATION (SORT_BINS / WAVEFRONT_GROUP_SIZE)
+
+shared uint sPartialSums[WAVEFRONT_GROUP_SIZE];
+
+void main()
+{
+	uint first = gl_LocalInvocationIndex * BINS_PER_INVOCATION;
+
+	uint sum = 0u;
+	for (uint i = 0u; i != BINS_PER_INVOCATION; ++i)
+		sum += bSortBins[first + i];
+	sPartialSums[gl_LocalInvocationIndex] = sum;
+	barrier();
+
+	// inclusive Hillis-Steele scan over the per invocation sums
+	for (uint offset = 1u; offset < WAVEFRONT_GROUP_SIZE; offset <<= 1u)
+	{
+		uint add = (gl_LocalInvocationIndex >= offset) ? sPartialSums[gl_LocalInvocationIndex - offset] : 0u;
+		barrier();
+		sPartialSums[gl_LocalInvocationIndex] += add;
+		barrier();
+	}
+
+	uint running = sPartialSums[gl_LocalInvocationIndex] - sum;
+	for (uint i = 0u; i != BINS_PER_INVOCATION; ++i)
+	{
+		uint count = bSortBins[first + i];
+		bSortBins[first + i] = running;
+		running += count;
+	}
+
+	// the sorted queue dispatches exactly like the unsorted one
+	if (gl_LocalInvocationIndex == 0u)
+	{
+		bRaysOutGroups = bRaysInGroups;
+		bRaysOutGroupsY = bRaysInGroupsY;
+		bRaysOutGroupsZ = 1u;
+		bRaysOutCount = bRaysInCount;
+	}
+}
+
+#elif defined(WAVEFRONT_SORT_SCATTER)
+
+void main()
+{
+	uint index = getQueueIndex();
+	if (index >= bRaysInCount)
+		return;
+
+	QueuedRay ray = bRaysIn[index];
+	uint slot = atomicAdd(bSortBins[getSortKey(ray)], 1u);
+	bRaysOut[slot] = ray;
+}
+
+#endif